@@ -0,0 +1,38 @@
+#include "bm/crc.h"
+
+uint16_t crc16_ccitt(uint16_t crc, const void *data, uint16_t size)
+{
+    const uint8_t *bytes = data;
+
+    while (size--)
+    {
+        crc ^= (uint16_t)(*bytes++) << 8;
+        for (uint8_t i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+
+    return crc;
+}
+
+//! CRC-32 of each nibble value, table is processed 4 bits at a time.
+static const uint32_t crc32_nibble_table[16] =
+{
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+uint32_t crc32(uint32_t crc, const void *data, uint32_t size)
+{
+    const uint8_t *bytes = data;
+
+    crc = ~crc;
+
+    while (size--)
+    {
+        crc ^= *bytes++;
+        crc = (crc >> 4) ^ crc32_nibble_table[crc & 0x0F];
+        crc = (crc >> 4) ^ crc32_nibble_table[crc & 0x0F];
+    }
+
+    return ~crc;
+}
@@ -72,70 +72,79 @@ int bmp085_measure_temperature(struct bmp085 *bmp085, uint16_t *temperature)
 
 int bmp085_read_coefficients(struct bmp085 *bmp085)
 {
+    struct bmp085_coefficients *c = &bmp085->coefficients;
+    uint8_t data[BMP085_EE_SIZE];
     int32_t result;
 
-    if ((result = i2c_read_word_data(&bmp085->client, BMP085_EE_AC1_ADDRESS)) < 0)
+    // Calibration words are stored MSB first from AC1 to MD.
+    if ((result = i2c_read_block_data(&bmp085->client, BMP085_EE_AC1_ADDRESS, BMP085_EE_SIZE, data)) < 0)
         return result;
-    bmp085->coefficients.ac1 = (int16_t)result;
-    if ((result = i2c_read_word_data(&bmp085->client, BMP085_EE_AC2_ADDRESS)) < 0)
-        return result;
-    bmp085->coefficients.ac2 = (int16_t)result;
-    if ((result = i2c_read_word_data(&bmp085->client, BMP085_EE_AC3_ADDRESS)) < 0)
-        return result;
-    bmp085->coefficients.ac3 = (int16_t)result;
-    if ((result = i2c_read_word_data(&bmp085->client, BMP085_EE_AC4_ADDRESS)) < 0)
-        return result;
-    bmp085->coefficients.ac4 = (uint16_t)result;
-    if ((result = i2c_read_word_data(&bmp085->client, BMP085_EE_AC5_ADDRESS)) < 0)
-        return result;
-    bmp085->coefficients.ac5 = (uint16_t)result;
-    if ((result = i2c_read_word_data(&bmp085->client, BMP085_EE_AC6_ADDRESS)) < 0)
-        return result;
-    bmp085->coefficients.ac6 = (uint16_t)result;
-    if ((result = i2c_read_word_data(&bmp085->client, BMP085_EE_B1_ADDRESS)) < 0)
-        return result;
-    bmp085->coefficients.b1 = (int16_t)result;
-    if ((result = i2c_read_word_data(&bmp085->client, BMP085_EE_B2_ADDRESS)) < 0)
-        return result;
-    bmp085->coefficients.b2 = (int16_t)result;
-    if ((result = i2c_read_word_data(&bmp085->client, BMP085_EE_MB_ADDRESS)) < 0)
-        return result;
-    bmp085->coefficients.mb = (int16_t)result;
-    if ((result = i2c_read_word_data(&bmp085->client, BMP085_EE_MC_ADDRESS)) < 0)
-        return result;
-    bmp085->coefficients.mc = (int16_t)result;
-    if ((result = i2c_read_word_data(&bmp085->client, BMP085_EE_MD_ADDRESS)) < 0)
-        return result;
-    bmp085->coefficients.md = (int16_t)result;
+
+    c->ac1 = (int16_t)((data[0] << 8) | data[1]);
+    c->ac2 = (int16_t)((data[2] << 8) | data[3]);
+    c->ac3 = (int16_t)((data[4] << 8) | data[5]);
+    c->ac4 = (uint16_t)((data[6] << 8) | data[7]);
+    c->ac5 = (uint16_t)((data[8] << 8) | data[9]);
+    c->ac6 = (uint16_t)((data[10] << 8) | data[11]);
+    c->b1 = (int16_t)((data[12] << 8) | data[13]);
+    c->b2 = (int16_t)((data[14] << 8) | data[15]);
+    c->mb = (int16_t)((data[16] << 8) | data[17]);
+    c->mc = (int16_t)((data[18] << 8) | data[19]);
+    c->md = (int16_t)((data[20] << 8) | data[21]);
 
     return 0;
 }
 
-void bmp085_calc(struct bmp085_coefficients * c, uint32_t up, uint16_t ut, uint32_t *pressure, int16_t *temperature, uint8_t oss)
+void bmp085_prepare_coefficients(const struct bmp085_coefficients *c, struct bmp085_prepared *prepared)
 {
-    int32_t x1, x2, x3, b3, b5, b6, p;
-    uint32_t  b4, b7;
+    prepared->ac1_4 = (int32_t) c->ac1 * 4;
+    prepared->mc_11 = (int32_t) c->mc << 11;
+}
+
+void bmp085_calc_terms(const struct bmp085_coefficients *c, const struct bmp085_prepared *prepared, uint16_t ut,
+                       uint8_t oss, struct bmp085_terms *terms)
+{
+    int32_t x1, x2, x3, b5, b6, b6_2;
 
     x1 = (ut - c->ac6) * c->ac5 >> 15;
-    x2 = ((int32_t) c->mc << 11) / (x1 + c->md);
+    x2 = prepared->mc_11 / (x1 + c->md);
     b5 = x1 + x2;
-    *temperature = (b5 + 8) >> 4;
+    terms->temperature = (b5 + 8) >> 4;
 
     b6 = b5 - 4000;
-    x1 = (c->b2 * (b6 * b6 >> 12)) >> 11;
+    b6_2 = b6 * b6 >> 12;
+    x1 = (c->b2 * b6_2) >> 11;
     x2 = c->ac2 * b6 >> 11;
     x3 = x1 + x2;
-    b3 = ((((int32_t) c->ac1 * 4 + x3) << oss) + 2) >> 2;
+    terms->b3 = (((prepared->ac1_4 + x3) << oss) + 2) >> 2;
     x1 = c->ac3 * b6 >> 13;
-    x2 = (c->b1 * (b6 * b6 >> 12)) >> 16;
+    x2 = (c->b1 * b6_2) >> 16;
     x3 = ((x1 + x2) + 2) >> 2;
-    b4 = (c->ac4 * (uint32_t)(x3 + 32768)) >> 15;
-    b7 = ((uint32_t) up - b3) * (50000 >> oss);
-    p = b7 < 0x80000000 ? (b7 * 2) / b4 : (b7 / b4) * 2;
+    terms->b4 = (c->ac4 * (uint32_t)(x3 + 32768)) >> 15;
+    terms->b7_scale = 50000 >> oss;
+}
+
+uint32_t bmp085_calc_pressure(const struct bmp085_terms *terms, uint32_t up)
+{
+    int32_t x1, x2, p;
+    uint32_t b7;
+
+    b7 = ((uint32_t) up - terms->b3) * terms->b7_scale;
+    p = b7 < 0x80000000 ? (b7 * 2) / terms->b4 : (b7 / terms->b4) * 2;
 
     x1 = (p >> 8) * (p >> 8);
     x1 = (x1 * 3038) >> 16;
     x2 = (-7357 * p) >> 16;
-    *pressure = p + ((x1 + x2 + 3791) >> 4);
+    return p + ((x1 + x2 + 3791) >> 4);
 }
 
+void bmp085_calc(struct bmp085_coefficients * c, uint32_t up, uint16_t ut, uint32_t *pressure, int16_t *temperature, uint8_t oss)
+{
+    struct bmp085_prepared prepared;
+    struct bmp085_terms terms;
+
+    bmp085_prepare_coefficients(c, &prepared);
+    bmp085_calc_terms(c, &prepared, ut, oss, &terms);
+    *temperature = terms.temperature;
+    *pressure = bmp085_calc_pressure(&terms, up);
+}
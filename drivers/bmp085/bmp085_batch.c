@@ -0,0 +1,280 @@
+#include "bm/bmp085_batch.h"
+#include "bm/bmp085.h"
+
+#if defined __AVX2__
+#include <immintrin.h>
+#elif defined __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Pressure ratio of first entry, Q22.
+#define BMP085_ALTITUDE_MIN (1UL << 20)
+// Step is 1/128, Q22.
+#define BMP085_ALTITUDE_SHIFT 15
+#define BMP085_ALTITUDE_SIZE 113
+
+//! Altitude in decimeters for pressure ratio from 0.25 to 1.125 by 1/128.
+static const int32_t bmp085_altitude_table[BMP085_ALTITUDE_SIZE] =
+{
+    102791, 100791, 98840, 96934, 95073, 93252, 91471, 89728,
+    88020, 86347, 84706, 83097, 81518, 79967, 78445, 76948,
+    75478, 74032, 72609, 71210, 69832, 68476, 67140, 65825,
+    64528, 63250, 61990, 60748, 59522, 58313, 57120, 55943,
+    54780, 53632, 52498, 51378, 50272, 49179, 48098, 47030,
+    45974, 44929, 43897, 42875, 41865, 40865, 39875, 38896,
+    37927, 36968, 36018, 35077, 34146, 33223, 32310, 31405,
+    30508, 29619, 28739, 27866, 27001, 26144, 25294, 24451,
+    23616, 22787, 21966, 21151, 20343, 19541, 18746, 17957,
+    17174, 16398, 15627, 14862, 14103, 13350, 12602, 11859,
+    11122, 10391, 9664, 8943, 8227, 7516, 6809, 6108,
+    5411, 4719, 4032, 3349, 2670, 1996, 1327, 661,
+    0, -657, -1310, -1959, -2603, -3244, -3881, -4514,
+    -5144, -5769, -6391, -7010, -7624, -8235, -8843, -9447,
+    -10048,
+};
+
+#if defined __AVX2__
+
+/*
+ * Double quotient of 32-bit integers truncates to exact integer quotient, so division
+ * is done in double precision.
+ */
+static inline __m256i bmp085_div_s32(__m256i a, __m256i b)
+{
+    __m128i lo = _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(a)),
+                                                   _mm256_cvtepi32_pd(_mm256_castsi256_si128(b))));
+    __m128i hi = _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(a, 1)),
+                                                   _mm256_cvtepi32_pd(_mm256_extracti128_si256(b, 1))));
+
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+static inline __m256d bmp085_cvt_u32(__m128i a)
+{
+    // Biased value is converted as signed one.
+    return _mm256_add_pd(_mm256_cvtepi32_pd(_mm_xor_si128(a, _mm_set1_epi32(0x80000000))),
+                         _mm256_set1_pd(2147483648.0));
+}
+
+static inline __m256i bmp085_div_u32(__m256i a, __m256i b)
+{
+    __m128i lo = _mm256_cvttpd_epi32(_mm256_div_pd(bmp085_cvt_u32(_mm256_castsi256_si128(a)),
+                                                   bmp085_cvt_u32(_mm256_castsi256_si128(b))));
+    __m128i hi = _mm256_cvttpd_epi32(_mm256_div_pd(bmp085_cvt_u32(_mm256_extracti128_si256(a, 1)),
+                                                   bmp085_cvt_u32(_mm256_extracti128_si256(b, 1))));
+
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+//! Same steps as bmp085_calc_terms() and bmp085_calc_pressure(), 8 samples at once.
+static uint32_t bmp085_calc_vector(const struct bmp085_coefficients *c, const struct bmp085_prepared *prepared,
+                                   const uint32_t *up, const uint16_t *ut, uint32_t *pressure, int16_t *temperature,
+                                   uint32_t count, uint8_t oss)
+{
+    const __m128i shift = _mm_cvtsi32_si128(oss);
+    uint32_t i;
+
+    for (i = 0; i + 8 <= count; i += 8)
+    {
+        __m256i x1, x2, x3, b3, b4, b5, b6, b6_2, b7, p, mask, t;
+
+        x1 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(ut + i)));
+        x1 = _mm256_mullo_epi32(_mm256_sub_epi32(x1, _mm256_set1_epi32(c->ac6)), _mm256_set1_epi32(c->ac5));
+        x1 = _mm256_srai_epi32(x1, 15);
+        x2 = bmp085_div_s32(_mm256_set1_epi32(prepared->mc_11), _mm256_add_epi32(x1, _mm256_set1_epi32(c->md)));
+        b5 = _mm256_add_epi32(x1, x2);
+
+        // Temperature is truncated to 16 bits, like by assignment.
+        t = _mm256_srai_epi32(_mm256_add_epi32(b5, _mm256_set1_epi32(8)), 4);
+        t = _mm256_srai_epi32(_mm256_slli_epi32(t, 16), 16);
+        _mm_storeu_si128((__m128i *)(temperature + i),
+                         _mm_packs_epi32(_mm256_castsi256_si128(t), _mm256_extracti128_si256(t, 1)));
+
+        b6 = _mm256_sub_epi32(b5, _mm256_set1_epi32(4000));
+        b6_2 = _mm256_srai_epi32(_mm256_mullo_epi32(b6, b6), 12);
+        x1 = _mm256_srai_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(c->b2), b6_2), 11);
+        x2 = _mm256_srai_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(c->ac2), b6), 11);
+        x3 = _mm256_add_epi32(x1, x2);
+        b3 = _mm256_sll_epi32(_mm256_add_epi32(_mm256_set1_epi32(prepared->ac1_4), x3), shift);
+        b3 = _mm256_srai_epi32(_mm256_add_epi32(b3, _mm256_set1_epi32(2)), 2);
+        x1 = _mm256_srai_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(c->ac3), b6), 13);
+        x2 = _mm256_srai_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(c->b1), b6_2), 16);
+        x3 = _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(x1, x2), _mm256_set1_epi32(2)), 2);
+        b4 = _mm256_mullo_epi32(_mm256_set1_epi32(c->ac4), _mm256_add_epi32(x3, _mm256_set1_epi32(32768)));
+        b4 = _mm256_srli_epi32(b4, 15);
+
+        b7 = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(up + i)), b3);
+        b7 = _mm256_mullo_epi32(b7, _mm256_set1_epi32(50000 >> oss));
+        mask = _mm256_srai_epi32(b7, 31);
+        p = _mm256_blendv_epi8(bmp085_div_u32(_mm256_slli_epi32(b7, 1), b4),
+                               _mm256_slli_epi32(bmp085_div_u32(b7, b4), 1), mask);
+
+        x1 = _mm256_srai_epi32(p, 8);
+        x1 = _mm256_mullo_epi32(x1, x1);
+        x1 = _mm256_srai_epi32(_mm256_mullo_epi32(x1, _mm256_set1_epi32(3038)), 16);
+        x2 = _mm256_srai_epi32(_mm256_mullo_epi32(p, _mm256_set1_epi32(-7357)), 16);
+        x3 = _mm256_add_epi32(_mm256_add_epi32(x1, x2), _mm256_set1_epi32(3791));
+        p = _mm256_add_epi32(p, _mm256_srai_epi32(x3, 4));
+        _mm256_storeu_si256((__m256i *)(pressure + i), p);
+    }
+
+    return i;
+}
+
+#elif defined __SSE2__
+
+static inline __m128i bmp085_mullo(__m128i a, __m128i b)
+{
+    // Low halves of unsigned products are the same as of signed ones.
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+/*
+ * Double quotient of 32-bit integers truncates to exact integer quotient, so division
+ * is done in double precision.
+ */
+static inline __m128i bmp085_div_s32(__m128i a, __m128i b)
+{
+    __m128i lo = _mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(a), _mm_cvtepi32_pd(b)));
+    __m128i hi = _mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(a, _MM_SHUFFLE(1, 0, 3, 2))),
+                                             _mm_cvtepi32_pd(_mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2)))));
+
+    return _mm_unpacklo_epi64(lo, hi);
+}
+
+static inline __m128d bmp085_cvt_u32(__m128i a)
+{
+    // Biased value is converted as signed one.
+    return _mm_add_pd(_mm_cvtepi32_pd(_mm_xor_si128(a, _mm_set1_epi32(0x80000000))), _mm_set1_pd(2147483648.0));
+}
+
+static inline __m128i bmp085_div_u32(__m128i a, __m128i b)
+{
+    __m128i lo = _mm_cvttpd_epi32(_mm_div_pd(bmp085_cvt_u32(a), bmp085_cvt_u32(b)));
+    __m128i hi = _mm_cvttpd_epi32(_mm_div_pd(bmp085_cvt_u32(_mm_shuffle_epi32(a, _MM_SHUFFLE(1, 0, 3, 2))),
+                                             bmp085_cvt_u32(_mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2)))));
+
+    return _mm_unpacklo_epi64(lo, hi);
+}
+
+//! Same steps as bmp085_calc_terms() and bmp085_calc_pressure(), 4 samples at once.
+static uint32_t bmp085_calc_vector(const struct bmp085_coefficients *c, const struct bmp085_prepared *prepared,
+                                   const uint32_t *up, const uint16_t *ut, uint32_t *pressure, int16_t *temperature,
+                                   uint32_t count, uint8_t oss)
+{
+    const __m128i shift = _mm_cvtsi32_si128(oss);
+    uint32_t i;
+
+    for (i = 0; i + 4 <= count; i += 4)
+    {
+        __m128i x1, x2, x3, b3, b4, b5, b6, b6_2, b7, p, mask, t;
+
+        x1 = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)(ut + i)), _mm_setzero_si128());
+        x1 = bmp085_mullo(_mm_sub_epi32(x1, _mm_set1_epi32(c->ac6)), _mm_set1_epi32(c->ac5));
+        x1 = _mm_srai_epi32(x1, 15);
+        x2 = bmp085_div_s32(_mm_set1_epi32(prepared->mc_11), _mm_add_epi32(x1, _mm_set1_epi32(c->md)));
+        b5 = _mm_add_epi32(x1, x2);
+
+        // Temperature is truncated to 16 bits, like by assignment.
+        t = _mm_srai_epi32(_mm_add_epi32(b5, _mm_set1_epi32(8)), 4);
+        t = _mm_srai_epi32(_mm_slli_epi32(t, 16), 16);
+        _mm_storel_epi64((__m128i *)(temperature + i), _mm_packs_epi32(t, t));
+
+        b6 = _mm_sub_epi32(b5, _mm_set1_epi32(4000));
+        b6_2 = _mm_srai_epi32(bmp085_mullo(b6, b6), 12);
+        x1 = _mm_srai_epi32(bmp085_mullo(_mm_set1_epi32(c->b2), b6_2), 11);
+        x2 = _mm_srai_epi32(bmp085_mullo(_mm_set1_epi32(c->ac2), b6), 11);
+        x3 = _mm_add_epi32(x1, x2);
+        b3 = _mm_sll_epi32(_mm_add_epi32(_mm_set1_epi32(prepared->ac1_4), x3), shift);
+        b3 = _mm_srai_epi32(_mm_add_epi32(b3, _mm_set1_epi32(2)), 2);
+        x1 = _mm_srai_epi32(bmp085_mullo(_mm_set1_epi32(c->ac3), b6), 13);
+        x2 = _mm_srai_epi32(bmp085_mullo(_mm_set1_epi32(c->b1), b6_2), 16);
+        x3 = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(x1, x2), _mm_set1_epi32(2)), 2);
+        b4 = bmp085_mullo(_mm_set1_epi32(c->ac4), _mm_add_epi32(x3, _mm_set1_epi32(32768)));
+        b4 = _mm_srli_epi32(b4, 15);
+
+        b7 = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(up + i)), b3);
+        b7 = bmp085_mullo(b7, _mm_set1_epi32(50000 >> oss));
+        mask = _mm_srai_epi32(b7, 31);
+        p = _mm_or_si128(_mm_andnot_si128(mask, bmp085_div_u32(_mm_slli_epi32(b7, 1), b4)),
+                         _mm_and_si128(mask, _mm_slli_epi32(bmp085_div_u32(b7, b4), 1)));
+
+        x1 = _mm_srai_epi32(p, 8);
+        x1 = bmp085_mullo(x1, x1);
+        x1 = _mm_srai_epi32(bmp085_mullo(x1, _mm_set1_epi32(3038)), 16);
+        x2 = _mm_srai_epi32(bmp085_mullo(p, _mm_set1_epi32(-7357)), 16);
+        x3 = _mm_add_epi32(_mm_add_epi32(x1, x2), _mm_set1_epi32(3791));
+        p = _mm_add_epi32(p, _mm_srai_epi32(x3, 4));
+        _mm_storeu_si128((__m128i *)(pressure + i), p);
+    }
+
+    return i;
+}
+
+#else
+
+static uint32_t bmp085_calc_vector(const struct bmp085_coefficients *c, const struct bmp085_prepared *prepared,
+                                   const uint32_t *up, const uint16_t *ut, uint32_t *pressure, int16_t *temperature,
+                                   uint32_t count, uint8_t oss)
+{
+    (void)c;
+    (void)prepared;
+    (void)up;
+    (void)ut;
+    (void)pressure;
+    (void)temperature;
+    (void)count;
+    (void)oss;
+
+    return 0;
+}
+
+#endif
+
+void bmp085_calc_batch(const struct bmp085_coefficients *c, const uint32_t *up, const uint16_t *ut,
+                       uint32_t *pressure, int16_t *temperature, uint32_t count, uint8_t oss)
+{
+    struct bmp085_prepared prepared;
+    struct bmp085_terms terms;
+    uint32_t first, i;
+
+    bmp085_prepare_coefficients(c, &prepared);
+    first = bmp085_calc_vector(c, &prepared, up, ut, pressure, temperature, count, oss);
+
+    for (i = first; i < count; i++)
+    {
+        // Temperature is usually converted less often than pressure, so terms are reused.
+        if ((i == first) || (ut[i] != ut[i - 1]))
+            bmp085_calc_terms(c, &prepared, ut[i], oss, &terms);
+
+        temperature[i] = terms.temperature;
+        pressure[i] = bmp085_calc_pressure(&terms, up[i]);
+    }
+}
+
+int32_t bmp085_altitude(uint32_t pressure, uint32_t sea_level)
+{
+    uint32_t ratio, index, fraction;
+    int32_t a, b;
+
+    // Ratio in Q22, done in two steps to avoid 64-bit division.
+    ratio = (pressure << 14) / sea_level;
+    ratio = (ratio << 8) | ((((pressure << 14) % sea_level) << 8) / sea_level);
+
+    if (ratio <= BMP085_ALTITUDE_MIN)
+        return bmp085_altitude_table[0];
+
+    index = (ratio - BMP085_ALTITUDE_MIN) >> BMP085_ALTITUDE_SHIFT;
+    if (index >= BMP085_ALTITUDE_SIZE - 1)
+        return bmp085_altitude_table[BMP085_ALTITUDE_SIZE - 1];
+
+    fraction = (ratio - BMP085_ALTITUDE_MIN) & ((1UL << BMP085_ALTITUDE_SHIFT) - 1);
+    a = bmp085_altitude_table[index];
+    b = bmp085_altitude_table[index + 1];
+
+    return a + (((b - a) * (int32_t)fraction) >> BMP085_ALTITUDE_SHIFT);
+}
@@ -0,0 +1,129 @@
+#include "bm/bmp085_sampler.h"
+#include "bm/bmp085.h"
+#include <bm/delay.h>
+#include <errno.h>
+
+uint8_t bmp085_conversion_time(uint8_t measure, uint8_t oss)
+{
+    // 4.5 ms for temperature, 4.5, 7.5, 13.5 and 25.5 ms for pressure.
+    if (measure == BMP085_TEMPERATURE_MEASURE)
+        return 5;
+
+    return (3 << oss) + 2;
+}
+
+int bmp085_sampler_init(struct bmp085_sampler *sampler, struct bmp085 *bmp085, uint8_t oss, uint8_t interval)
+{
+    if ((oss > 3) || (interval == 0))
+        return -EINVAL;
+
+    sampler->bmp085 = bmp085;
+    sampler->oss = oss;
+    sampler->interval = interval;
+    sampler->continuous = 0;
+    sampler->state = BMP085_SAMPLER_IDLE;
+    sampler->count = 0;
+    sampler->eoc = 0;
+    sampler->ut = 0;
+    sampler->up = 0;
+    sampler->pressure = 0;
+    sampler->temperature = 0;
+    bmp085_prepare_coefficients(&bmp085->coefficients, &sampler->prepared);
+
+    return 0;
+}
+
+static int bmp085_sampler_convert(struct bmp085_sampler *sampler, uint8_t state)
+{
+    uint8_t measure = (state == BMP085_SAMPLER_TEMPERATURE) ? BMP085_TEMPERATURE_MEASURE
+                      : BMP085_PRESSURE_MEASURE + (sampler->oss << 6);
+    int status;
+
+    sampler->eoc = 0;
+
+    status = bmp085_start_measure(sampler->bmp085, measure);
+    if (status)
+    {
+        sampler->state = BMP085_SAMPLER_IDLE;
+        return status;
+    }
+
+    // Conversion may start just before tick, so one more tick is waited.
+    sampler->deadline = get_tick_count() + bmp085_conversion_time(measure, sampler->oss) + 1;
+    sampler->state = state;
+
+    return 0;
+}
+
+int bmp085_sampler_start(struct bmp085_sampler *sampler, uint8_t continuous)
+{
+    sampler->continuous = continuous;
+    sampler->count = 0;
+
+    return bmp085_sampler_convert(sampler, BMP085_SAMPLER_TEMPERATURE);
+}
+
+void bmp085_sampler_stop(struct bmp085_sampler *sampler)
+{
+    sampler->continuous = 0;
+    sampler->state = BMP085_SAMPLER_IDLE;
+}
+
+void bmp085_sampler_eoc(struct bmp085_sampler *sampler)
+{
+    sampler->eoc = 1;
+}
+
+int bmp085_sampler_poll(struct bmp085_sampler *sampler)
+{
+    uint8_t data[3];
+    int status;
+
+    if (sampler->state == BMP085_SAMPLER_IDLE)
+        return 0;
+
+    if (!sampler->eoc && (get_tick_count() < sampler->deadline))
+        return 0;
+
+    if (sampler->state == BMP085_SAMPLER_TEMPERATURE)
+    {
+        status = i2c_read_block_data(&sampler->bmp085->client, BMP085_MEASURE_ADDRESS, 2, data);
+        if (status < 0)
+        {
+            sampler->state = BMP085_SAMPLER_IDLE;
+            return status;
+        }
+
+        sampler->ut = (data[0] << 8) | data[1];
+        sampler->count = 0;
+        bmp085_calc_terms(&sampler->bmp085->coefficients, &sampler->prepared, sampler->ut, sampler->oss, &sampler->terms);
+        sampler->temperature = sampler->terms.temperature;
+
+        // Pressure conversion follows at once, reading is complete after it.
+        status = bmp085_sampler_convert(sampler, BMP085_SAMPLER_PRESSURE);
+        return status;
+    }
+
+    // XLSB holds extra bits of oversampled pressure.
+    status = i2c_read_block_data(&sampler->bmp085->client, BMP085_MEASURE_ADDRESS, 3, data);
+    if (status < 0)
+    {
+        sampler->state = BMP085_SAMPLER_IDLE;
+        return status;
+    }
+
+    sampler->up = (((uint32_t)data[0] << 16) | (data[1] << 8) | data[2]) >> (8 - sampler->oss);
+    sampler->count++;
+
+    sampler->pressure = bmp085_calc_pressure(&sampler->terms, sampler->up);
+
+    if (!sampler->continuous)
+    {
+        sampler->state = BMP085_SAMPLER_IDLE;
+        return 1;
+    }
+
+    status = bmp085_sampler_convert(sampler, (sampler->count >= sampler->interval) ? BMP085_SAMPLER_TEMPERATURE
+                                    : BMP085_SAMPLER_PRESSURE);
+    return status ? status : 1;
+}
@@ -2,6 +2,7 @@
 #include "bm/spi.h"
 #include "bm/delay.h"
 #include "bm/gpio.h"
+#include <string.h>
 #include <errno.h>
 
 int nrf24l01_init_struct(struct spi_master* master, uint16_t cs_gpio, uint16_t ce_gpio, uint16_t irq_gpio, struct nrf24l01 *device)
@@ -11,6 +12,11 @@ int nrf24l01_init_struct(struct spi_master* master, uint16_t cs_gpio, uint16_t c
     device->spi.flags = 0;
     device->ce_gpio = ce_gpio;
     device->irq_gpio = irq_gpio;
+    device->rx_ring = 0;
+    device->tx_done = 0;
+    device->tx_failed = 0;
+    device->status = 0;
+    device->saved_transactions = 0;
     return 0;
 }
 
@@ -49,7 +55,7 @@ int nrf24l01_read_register(struct nrf24l01 *device, uint8_t reg, uint8_t *data)
     {
         {
             .tx_buf = &op,
-            .rx_buf = 0,
+            .rx_buf = &device->status,
             .len = 1,
             .cs_change = 0,
             .delay_usecs = 0
@@ -72,7 +78,7 @@ int nrf24l01_write_register(struct nrf24l01 *device, uint8_t reg, uint8_t data)
     {
         {
             .tx_buf = &op,
-            .rx_buf = 0,
+            .rx_buf = &device->status,
             .len = 1,
             .cs_change = 0,
             .delay_usecs = 0
@@ -95,7 +101,7 @@ int nrf24l01_read_address_register(struct nrf24l01 *device, uint8_t reg, uint8_t
     {
         {
             .tx_buf = &op,
-            .rx_buf = 0,
+            .rx_buf = &device->status,
             .len = 1,
             .cs_change = 0,
             .delay_usecs = 0
@@ -118,7 +124,7 @@ int nrf24l01_write_address_register(struct nrf24l01 *device, uint8_t reg, uint8_
     {
         {
             .tx_buf = &op,
-            .rx_buf = 0,
+            .rx_buf = &device->status,
             .len = 1,
             .cs_change = 0,
             .delay_usecs = 0
@@ -155,6 +161,81 @@ int nrf24l01_set_channel(struct nrf24l01 *device, uint8_t channel)
     return nrf24l01_write_register(device, NRF24L01_REG_RF_CH, reg);
 }
 
+/*!
+ * \arg rate - NRF24L01_DATA_RATE_250K, NRF24L01_DATA_RATE_1M or NRF24L01_DATA_RATE_2M.
+ */
+int nrf24l01_set_data_rate(struct nrf24l01 *device, uint8_t rate)
+{
+    uint8_t reg;
+    int status;
+
+    if (rate > NRF24L01_DATA_RATE_2M)
+        return -EINVAL;
+
+    status = nrf24l01_read_register(device, NRF24L01_REG_RF_SETUP, &reg);
+    if (status)
+        return status;
+
+    reg &= ~(NRF24L01_RF_DR_LOW | NRF24L01_RF_DR);
+
+    if (rate == NRF24L01_DATA_RATE_250K)
+        reg |= NRF24L01_RF_DR_LOW;
+    else if (rate == NRF24L01_DATA_RATE_2M)
+        reg |= NRF24L01_RF_DR;
+
+    return nrf24l01_write_register(device, NRF24L01_REG_RF_SETUP, reg);
+}
+
+/*!
+ * \arg level - PA level, from NRF24L01_POWER_M18DBM (0) to NRF24L01_POWER_0DBM (3).
+ */
+int nrf24l01_set_power(struct nrf24l01 *device, uint8_t level)
+{
+    uint8_t reg;
+    int status;
+
+    if (level > NRF24L01_POWER_0DBM)
+        return -EINVAL;
+
+    status = nrf24l01_read_register(device, NRF24L01_REG_RF_SETUP, &reg);
+    if (status)
+        return status;
+
+    reg = (reg & ~NRF24L01_RF_PWR) | (level << 1);
+
+    return nrf24l01_write_register(device, NRF24L01_REG_RF_SETUP, reg);
+}
+
+int nrf24l01_get_observe_tx(struct nrf24l01 *device, uint8_t *lost, uint8_t *retransmits)
+{
+    uint8_t reg;
+    int status;
+
+    status = nrf24l01_read_register(device, NRF24L01_REG_OBSERVE_TX, &reg);
+    if (status)
+        return status;
+
+    if (lost)
+        *lost = (reg & NRF24L01_PLOS_CNT) >> 4;
+    if (retransmits)
+        *retransmits = reg & NRF24L01_ARC_CNT;
+
+    return 0;
+}
+
+int nrf24l01_get_carrier(struct nrf24l01 *device, uint8_t *detected)
+{
+    uint8_t reg;
+    int status;
+
+    status = nrf24l01_read_register(device, NRF24L01_REG_CD, &reg);
+    if (status)
+        return status;
+
+    *detected = reg & NRF24L01_CD;
+    return 0;
+}
+
 int nrf24l01_get_status(struct nrf24l01 *device, uint8_t *status)
 {
     uint8_t op = NRF24L01_CMD_NOP;
@@ -162,13 +243,17 @@ int nrf24l01_get_status(struct nrf24l01 *device, uint8_t *status)
     {
         {
             .tx_buf = &op,
-            .rx_buf = status,
+            .rx_buf = &device->status,
             .len = 1,
             .cs_change = 0,
             .delay_usecs = 0
         }
     };
-    return spi_sync(&device->spi, messages, 1);
+    int result = spi_sync(&device->spi, messages, 1);
+
+    *status = device->status;
+
+    return result;
 }
 
 /*!
@@ -187,7 +272,7 @@ int nrf24l01_set_rx_address(struct nrf24l01 *device, uint8_t pipe, uint8_t *addr
 {
     if ((pipe == 0) || (pipe == 1))
         return nrf24l01_write_address_register(device, NRF24L01_REG_RX_ADDR_P0 + pipe, addr);
-    else if ((pipe > 2) && (pipe < 6))
+    else if ((pipe >= 2) && (pipe < 6))
         return nrf24l01_write_register(device, NRF24L01_REG_RX_ADDR_P0 + pipe, *addr);
 
     return -EINVAL;
@@ -252,6 +337,74 @@ int nrf24l01_enable_dynamic_pipe_size(struct nrf24l01 *device, uint8_t pipes)
     return status;
 }
 
+int nrf24l01_enable_ack_payload(struct nrf24l01 *device)
+{
+    uint8_t reg;
+    int status;
+
+    status = nrf24l01_read_register(device, NRF24L01_REG_FEATURE, &reg);
+
+    if (status)
+        return status;
+
+    reg |= NRF24L01_EN_ACK_PAY;
+
+    status = nrf24l01_write_register(device, NRF24L01_REG_FEATURE, reg);
+
+    return status;
+}
+
+int nrf24l01_disable_ack_payload(struct nrf24l01 *device)
+{
+    uint8_t reg;
+    int status;
+
+    status = nrf24l01_read_register(device, NRF24L01_REG_FEATURE, &reg);
+
+    if (status)
+        return status;
+
+    reg &= ~NRF24L01_EN_ACK_PAY;
+
+    status = nrf24l01_write_register(device, NRF24L01_REG_FEATURE, reg);
+
+    return status;
+}
+
+int nrf24l01_enable_dynamic_ack(struct nrf24l01 *device)
+{
+    uint8_t reg;
+    int status;
+
+    status = nrf24l01_read_register(device, NRF24L01_REG_FEATURE, &reg);
+
+    if (status)
+        return status;
+
+    reg |= NRF24L01_EN_DYN_ACK;
+
+    status = nrf24l01_write_register(device, NRF24L01_REG_FEATURE, reg);
+
+    return status;
+}
+
+int nrf24l01_disable_dynamic_ack(struct nrf24l01 *device)
+{
+    uint8_t reg;
+    int status;
+
+    status = nrf24l01_read_register(device, NRF24L01_REG_FEATURE, &reg);
+
+    if (status)
+        return status;
+
+    reg &= ~NRF24L01_EN_DYN_ACK;
+
+    status = nrf24l01_write_register(device, NRF24L01_REG_FEATURE, reg);
+
+    return status;
+}
+
 int nrf24l01_disable_dynamic_size(struct nrf24l01 *device)
 {
     uint8_t reg;
@@ -300,12 +453,11 @@ int nrf24l01_read_payload(struct nrf24l01 *device, uint8_t size, uint8_t *data,
         return -EINVAL;
 
     uint8_t op = NRF24L01_CMD_R_RX_PAYLOAD;
-    uint8_t status;
     struct spi_message messages[2] =
     {
         {
             .tx_buf = &op,
-            .rx_buf = &status,
+            .rx_buf = &device->status,
             .len = 1,
             .cs_change = 0,
             .delay_usecs = 0
@@ -321,7 +473,7 @@ int nrf24l01_read_payload(struct nrf24l01 *device, uint8_t size, uint8_t *data,
 
     int result = spi_sync(&device->spi, messages, 2);
 
-    *pipe = (status >> 1) & 0x7;
+    *pipe = (device->status >> 1) & 0x7;
 
     return result;
 }
@@ -336,7 +488,64 @@ int nrf24l01_write_payload(struct nrf24l01 *device, uint8_t size, uint8_t *data)
     {
         {
             .tx_buf = &op,
+            .rx_buf = &device->status,
+            .len = 1,
+            .cs_change = 0,
+            .delay_usecs = 0
+        },
+        {
+            .tx_buf = data,
+            .rx_buf = 0,
+            .len = size,
+            .cs_change = 0,
+            .delay_usecs = 0
+        }
+    };
+
+    return spi_sync(&device->spi, messages, 2);
+}
+
+int nrf24l01_write_payload_no_ack(struct nrf24l01 *device, uint8_t size, uint8_t *data)
+{
+    if (size > 32)
+        return -EINVAL;
+
+    uint8_t op = NRF24L01_CMD_W_TX_PAYLOAD_NO_ACK;
+    struct spi_message messages[2] =
+    {
+        {
+            .tx_buf = &op,
+            .rx_buf = &device->status,
+            .len = 1,
+            .cs_change = 0,
+            .delay_usecs = 0
+        },
+        {
+            .tx_buf = data,
             .rx_buf = 0,
+            .len = size,
+            .cs_change = 0,
+            .delay_usecs = 0
+        }
+    };
+
+    return spi_sync(&device->spi, messages, 2);
+}
+
+/*!
+ * \arg pipe - pipe, to which ACK payload is sent, from 0 to 5.
+ */
+int nrf24l01_write_ack_payload(struct nrf24l01 *device, uint8_t pipe, uint8_t size, uint8_t *data)
+{
+    if ((pipe > 5) || (size > 32))
+        return -EINVAL;
+
+    uint8_t op = NRF24L01_CMD_W_ACK_PAYLOAD | pipe;
+    struct spi_message messages[2] =
+    {
+        {
+            .tx_buf = &op,
+            .rx_buf = &device->status,
             .len = 1,
             .cs_change = 0,
             .delay_usecs = 0
@@ -361,7 +570,7 @@ int nrf24l01_toggle_features(struct nrf24l01 *device)
     {
         {
             .tx_buf = &op,
-            .rx_buf = 0,
+            .rx_buf = &device->status,
             .len = 1,
             .cs_change = 0,
             .delay_usecs = 0
@@ -386,7 +595,7 @@ int nrf24l01_flush_rx(struct nrf24l01 *device)
     {
         {
             .tx_buf = &op,
-            .rx_buf = 0,
+            .rx_buf = &device->status,
             .len = 1,
             .cs_change = 0,
             .delay_usecs = 0
@@ -403,7 +612,7 @@ int nrf24l01_flush_tx(struct nrf24l01 *device)
     {
         {
             .tx_buf = &op,
-            .rx_buf = 0,
+            .rx_buf = &device->status,
             .len = 1,
             .cs_change = 0,
             .delay_usecs = 0
@@ -420,7 +629,7 @@ int nrf24l01_get_size(struct nrf24l01 *device, uint8_t *size)
     {
         {
             .tx_buf = &op,
-            .rx_buf = 0,
+            .rx_buf = &device->status,
             .len = 1,
             .cs_change = 0,
             .delay_usecs = 0
@@ -490,6 +699,10 @@ int nrf24l01_send(struct nrf24l01 *device, uint8_t *data, uint16_t size)
     uint8_t status_reg;
     int status;
 
+    // IRQ handler would steal TX flags.
+    if (device->rx_ring)
+        return -EBUSY;
+
     status = nrf24l01_get_status(device, &status_reg);
     if (status)
         return status;
@@ -509,7 +722,8 @@ int nrf24l01_send(struct nrf24l01 *device, uint8_t *data, uint16_t size)
         if (status)
             return status;
 
-        //TODO: Timeout?
+        uint64_t tickStop = get_tick_count() + NRF24L01_TX_TIMEOUT;
+
         for (;;)
         {
             status = nrf24l01_get_status(device, &status_reg);
@@ -518,9 +732,10 @@ int nrf24l01_send(struct nrf24l01 *device, uint8_t *data, uint16_t size)
 
             if (status_reg & NRF24L01_MAX_RT)
             {
-                nrf24l01_clear_irq(device, NRF24L01_MAX_RT);
-                nrf24l01_flush_tx(device);
+                // Payload is retransmitted again if flag is cleared while it is in FIFO.
                 nrf24l01_enter_standby(device);
+                nrf24l01_flush_tx(device);
+                nrf24l01_clear_irq(device, NRF24L01_MAX_RT);
                 return -ETIMEDOUT;
             }
             if (status_reg & NRF24L01_TX_DS)
@@ -529,6 +744,13 @@ int nrf24l01_send(struct nrf24l01 *device, uint8_t *data, uint16_t size)
                 break;
             }
 
+            if (get_tick_count() >= tickStop)
+            {
+                nrf24l01_enter_standby(device);
+                nrf24l01_flush_tx(device);
+                return -ETIMEDOUT;
+            }
+
             system_nop();
         }
 
@@ -538,95 +760,242 @@ int nrf24l01_send(struct nrf24l01 *device, uint8_t *data, uint16_t size)
     return nrf24l01_enter_standby(device);
 }
 
-/*!
- * \arg pipe - pipe on which data has been received.
- * \arg data - output data, the size of this array must be at least 32 bytes.
- * \arg size - received data size.
- * \arg timeout - receive timeout. 0 - means wait forever
- */
-int nrf24l01_receive_packet(struct nrf24l01 *device, uint8_t* pipe, uint8_t *data, uint8_t *size, uint16_t timeout)
+int nrf24l01_transfer(struct nrf24l01 *device, uint8_t *data, uint8_t size, uint8_t *ack, uint8_t *ack_size)
 {
-    uint64_t tickStop = get_tick_count() + timeout;
+    uint64_t tickStop;
     uint8_t status_reg;
     int status;
 
-    status = nrf24l01_enter_rx(device);
+    *ack_size = 0;
+
+    if (size > 32)
+        return -EINVAL;
+
+    // IRQ handler would steal TX flags and ACK payload.
+    if (device->rx_ring)
+        return -EBUSY;
+
+    status = nrf24l01_clear_irq(device, NRF24L01_RX_DR | NRF24L01_TX_DS | NRF24L01_MAX_RT);
     if (status)
         return status;
 
+    if (device->status & NRF24L01_TX_FULL)
+        return -EBUSY;
 
-    while ((timeout == 0) || (get_tick_count() < tickStop))
-    {
-        status = nrf24l01_get_fifo_status(device, &status_reg);
-        if (status)
-        {
-            nrf24l01_enter_standby(device);
-            return status;
-        }
+    status = nrf24l01_write_payload(device, size, data);
+    if (status)
+        return status;
 
-        if (status_reg & NRF24L01_FIFO_RX_EMPTY)
-        {
-            system_nop();
-            continue;
-        }
+    status = nrf24l01_enter_tx(device);
+    if (status)
+        return status;
 
-        status = nrf24l01_get_size(device, size);
+    tickStop = get_tick_count() + NRF24L01_TX_TIMEOUT;
+
+    for (;;)
+    {
+        status = nrf24l01_get_status(device, &status_reg);
         if (status)
+            break;
+
+        if (status_reg & NRF24L01_MAX_RT)
         {
-            nrf24l01_flush_rx(device);
+            // Payload is retransmitted again if flag is cleared while it is in FIFO.
             nrf24l01_enter_standby(device);
-            return status;
+            nrf24l01_flush_tx(device);
+            nrf24l01_clear_irq(device, NRF24L01_MAX_RT);
+            return -ETIMEDOUT;
         }
 
-        status = nrf24l01_read_payload(device, *size, data, pipe);
-        if (status)
+        // RX_DR is set together with TX_DS if ACK carried payload.
+        if (status_reg & NRF24L01_TX_DS)
+            break;
+
+        if (get_tick_count() >= tickStop)
         {
-            nrf24l01_flush_rx(device);
             nrf24l01_enter_standby(device);
-            return status;
+            nrf24l01_flush_tx(device);
+            return -ETIMEDOUT;
         }
 
-        break;
+        system_nop();
     }
 
-    if ((timeout != 0) && (get_tick_count() >= tickStop))
+    nrf24l01_enter_standby(device);
+
+    if (status)
+        return status;
+
+    status = nrf24l01_clear_irq(device, status_reg & (NRF24L01_RX_DR | NRF24L01_TX_DS));
+    if (status)
+        return status;
+
+    if (!(status_reg & NRF24L01_RX_DR))
+        return 0;
+
+    status = nrf24l01_get_size(device, ack_size);
+    if (status)
+        return status;
+
+    if (*ack_size > 32)
     {
-        nrf24l01_flush_rx(device);
-        nrf24l01_enter_standby(device);
-        return -ETIMEDOUT;
+        *ack_size = 0;
+        return nrf24l01_flush_rx(device);
     }
 
-    return nrf24l01_enter_standby(device);
-}
+    uint8_t pipe;
 
+    return nrf24l01_read_payload(device, *ack_size, ack, &pipe);
+}
 
-int nrf24l01_receive(struct nrf24l01 *device, uint8_t* pipe, uint8_t *data, uint16_t size, uint16_t timeout)
+int nrf24l01_send_no_ack(struct nrf24l01 *device, uint8_t *data, uint8_t size)
 {
-    uint64_t tickStop = get_tick_count() + timeout;
-    uint8_t status_reg;
+    uint64_t tickStop;
+    uint8_t fifo_reg;
     int status;
 
-    status = nrf24l01_enter_rx(device);
+    if (size > 32)
+        return -EINVAL;
+
+    status = nrf24l01_write_payload_no_ack(device, size, data);
     if (status)
         return status;
 
-    uint16_t recieved = 0;
-
-    while ((recieved < size) && ((timeout == 0) || (get_tick_count() < tickStop)))
+    status = nrf24l01_enter_tx(device);
+    if (status)
+        return status;
+
+    tickStop = get_tick_count() + NRF24L01_TX_TIMEOUT;
+
+    for (;;)
     {
-        status = nrf24l01_get_fifo_status(device, &status_reg);
+        status = nrf24l01_get_fifo_status(device, &fifo_reg);
+        if (status || (fifo_reg & NRF24L01_FIFO_TX_EMPTY))
+            break;
+
+        if (get_tick_count() >= tickStop)
+        {
+            nrf24l01_enter_standby(device);
+            nrf24l01_flush_tx(device);
+            return -ETIMEDOUT;
+        }
+
+        system_nop();
+    }
+
+    nrf24l01_enter_standby(device);
+
+    if (status)
+        return status;
+
+    return nrf24l01_clear_irq(device, NRF24L01_TX_DS);
+}
+
+/*!
+ * \arg pipe - pipe on which data has been received.
+ * \arg data - output data, the size of this array must be at least 32 bytes.
+ * \arg size - received data size.
+ * \arg timeout - receive timeout. 0 - means wait forever
+ */
+int nrf24l01_receive_packet(struct nrf24l01 *device, uint8_t* pipe, uint8_t *data, uint8_t *size, uint16_t timeout)
+{
+    uint64_t tickStop = get_tick_count() + timeout;
+    int status;
+
+    status = nrf24l01_enter_rx(device);
+    if (status)
+        return status;
+
+
+    while ((timeout == 0) || (get_tick_count() < tickStop))
+    {
+        if (device->rx_ring)
+        {
+            // IRQ mode, no SPI traffic while waiting.
+            struct nrf24l01_frame frame;
+
+            if (nrf24l01_dequeue(device, &frame))
+            {
+                system_nop();
+                continue;
+            }
+
+            *pipe = frame.pipe;
+            *size = frame.size;
+            memcpy(data, frame.data, frame.size);
+            break;
+        }
+
+        status = nrf24l01_get_size(device, size);
         if (status)
         {
+            nrf24l01_flush_rx(device);
             nrf24l01_enter_standby(device);
             return status;
         }
 
-        if (status_reg & NRF24L01_FIFO_RX_EMPTY)
+        // STATUS clocked out with R_RX_PL_WID tells whether RX FIFO is empty.
+        if (((device->status & NRF24L01_RX_P_NO) >> 1) > 5)
         {
             system_nop();
             continue;
         }
 
+        device->saved_transactions++;
+
+        status = nrf24l01_read_payload(device, *size, data, pipe);
+        if (status)
+        {
+            nrf24l01_flush_rx(device);
+            nrf24l01_enter_standby(device);
+            return status;
+        }
+
+        break;
+    }
+
+    if ((timeout != 0) && (get_tick_count() >= tickStop))
+    {
+        nrf24l01_flush_rx(device);
+        nrf24l01_enter_standby(device);
+        return -ETIMEDOUT;
+    }
+
+    return nrf24l01_enter_standby(device);
+}
+
+
+int nrf24l01_receive(struct nrf24l01 *device, uint8_t* pipe, uint8_t *data, uint16_t size, uint16_t timeout)
+{
+    uint64_t tickStop = get_tick_count() + timeout;
+    int status;
+
+    status = nrf24l01_enter_rx(device);
+    if (status)
+        return status;
+
+    uint16_t recieved = 0;
+
+    while ((recieved < size) && ((timeout == 0) || (get_tick_count() < tickStop)))
+    {
+        if (device->rx_ring)
+        {
+            // IRQ mode, no SPI traffic while waiting.
+            struct nrf24l01_frame frame;
+
+            if (nrf24l01_dequeue(device, &frame))
+            {
+                system_nop();
+                continue;
+            }
+
+            uint8_t frameSize = ((recieved + frame.size) > size) ? size - recieved : frame.size;
+            *pipe = frame.pipe;
+            memcpy(data + recieved, frame.data, frameSize);
+            recieved += frameSize;
+            continue;
+        }
+
         uint8_t packetSize;
 
         status = nrf24l01_get_size(device, &packetSize);
@@ -637,6 +1006,14 @@ int nrf24l01_receive(struct nrf24l01 *device, uint8_t* pipe, uint8_t *data, uint
             return status;
         }
 
+        if (((device->status & NRF24L01_RX_P_NO) >> 1) > 5)
+        {
+            system_nop();
+            continue;
+        }
+
+        device->saved_transactions++;
+
         if ((recieved + packetSize) > size)
             packetSize = size - recieved;
 
@@ -670,6 +1047,23 @@ int nrf24l01_enable_pipes(struct nrf24l01 *device, uint8_t pipes)
     int status;
     status = nrf24l01_read_register(device, NRF24L01_REG_EN_RXADDR, &reg);
 
+    if (status)
+        return status;
+
+    reg |= pipes & 0x3F;
+
+    return nrf24l01_write_register(device, NRF24L01_REG_EN_RXADDR, reg);
+}
+
+/*!
+ * \arg - biset of pipes. e.g. 0x01 - pipe 0, 0x3F - all pipes.
+ */
+int nrf24l01_disable_pipes(struct nrf24l01 *device, uint8_t pipes)
+{
+    uint8_t reg;
+    int status;
+    status = nrf24l01_read_register(device, NRF24L01_REG_EN_RXADDR, &reg);
+
     if (status)
         return status;
 
@@ -678,3 +1072,633 @@ int nrf24l01_enable_pipes(struct nrf24l01 *device, uint8_t pipes)
     return nrf24l01_write_register(device, NRF24L01_REG_EN_RXADDR, reg);
 }
 
+
+int nrf24l01_enable_irq(struct nrf24l01 *device, struct nrf24l01_rx_ring *ring)
+{
+    uint8_t reg;
+    int status;
+
+    ring->head = 0;
+    ring->tail = 0;
+    ring->dropped = 0;
+
+    status = gpio_request_one(device->irq_gpio, GPIOF_IN | GPIOF_PULL_UP);
+    if (status)
+        return status;
+
+    status = nrf24l01_clear_irq(device, NRF24L01_RX_DR | NRF24L01_TX_DS | NRF24L01_MAX_RT);
+    if (status)
+        return status;
+
+    device->rx_ring = ring;
+
+    status = nrf24l01_read_register(device, NRF24L01_REG_CONFIG, &reg);
+    if (status)
+        return status;
+
+    reg &= ~(NRF24L01_MASK_RX_DR | NRF24L01_MASK_TX_DS | NRF24L01_MASK_MAX_RT);
+
+    return nrf24l01_write_register(device, NRF24L01_REG_CONFIG, reg);
+}
+
+int nrf24l01_disable_irq(struct nrf24l01 *device)
+{
+    uint8_t reg;
+    int status;
+
+    status = nrf24l01_read_register(device, NRF24L01_REG_CONFIG, &reg);
+    if (status)
+        return status;
+
+    reg |= NRF24L01_MASK_RX_DR | NRF24L01_MASK_TX_DS | NRF24L01_MASK_MAX_RT;
+
+    status = nrf24l01_write_register(device, NRF24L01_REG_CONFIG, reg);
+    if (status)
+        return status;
+
+    device->rx_ring = 0;
+
+    return gpio_free_one(device->irq_gpio);
+}
+
+static int nrf24l01_drain_rx(struct nrf24l01 *device, uint8_t status_reg)
+{
+    struct nrf24l01_rx_ring *ring = device->rx_ring;
+    struct nrf24l01_frame overflow;
+    uint8_t drained = 0;
+    int status;
+
+    // RX_P_NO is 7 when RX FIFO is empty.
+    if (((status_reg & NRF24L01_RX_P_NO) >> 1) > 5)
+        return 0;
+
+    for (;;)
+    {
+        uint8_t head = ring->head;
+        struct nrf24l01_frame *frame = &ring->frames[head & (NRF24L01_RX_RING_SIZE - 1)];
+
+        // Payload is read anyway to free RX FIFO.
+        if ((uint8_t)(head - ring->tail) >= NRF24L01_RX_RING_SIZE)
+            frame = &overflow;
+
+        status = nrf24l01_get_size(device, &frame->size);
+        if (status)
+            return status;
+
+        // STATUS clocked out with R_RX_PL_WID replaces STATUS read after each payload.
+        if (((device->status & NRF24L01_RX_P_NO) >> 1) > 5)
+        {
+            if (drained)
+                device->saved_transactions += drained - 1;
+            return 0;
+        }
+
+        if (frame->size > 32)
+            return nrf24l01_flush_rx(device);
+
+        status = nrf24l01_read_payload(device, frame->size, frame->data, &frame->pipe);
+        if (status)
+            return status;
+
+        if (frame == &overflow)
+        {
+            ring->dropped++;
+        }
+        else
+        {
+            // Frame must be complete before consumer can see it.
+            __sync_synchronize();
+            ring->head = head + 1;
+        }
+
+        drained++;
+    }
+}
+
+int nrf24l01_irq_handler(struct nrf24l01 *device)
+{
+    uint8_t status_reg;
+    int status;
+
+    status = nrf24l01_get_status(device, &status_reg);
+    if (status)
+        return status;
+
+    uint8_t irq = status_reg & (NRF24L01_RX_DR | NRF24L01_TX_DS | NRF24L01_MAX_RT);
+
+    // Flags are cleared before draining, so payload received meanwhile raises IRQ again.
+    if (irq)
+    {
+        status = nrf24l01_clear_irq(device, irq);
+        if (status)
+            return status;
+    }
+
+    if (irq & NRF24L01_MAX_RT)
+    {
+        device->tx_failed++;
+        status = nrf24l01_flush_tx(device);
+        if (status)
+            return status;
+    }
+
+    if (irq & NRF24L01_TX_DS)
+        device->tx_done++;
+
+    if (device->rx_ring)
+        return nrf24l01_drain_rx(device, status_reg);
+
+    return 0;
+}
+
+int nrf24l01_read_frame(struct nrf24l01 *device, struct nrf24l01_frame *frame)
+{
+    int status;
+
+    if (device->rx_ring)
+        return nrf24l01_dequeue(device, frame);
+
+    status = nrf24l01_get_size(device, &frame->size);
+    if (status)
+        return status;
+
+    if (((device->status & NRF24L01_RX_P_NO) >> 1) > 5)
+        return -EAGAIN;
+
+    if (frame->size > 32)
+    {
+        status = nrf24l01_flush_rx(device);
+        return status ? status : -EAGAIN;
+    }
+
+    return nrf24l01_read_payload(device, frame->size, frame->data, &frame->pipe);
+}
+
+int nrf24l01_dequeue(struct nrf24l01 *device, struct nrf24l01_frame *frame)
+{
+    struct nrf24l01_rx_ring *ring = device->rx_ring;
+
+    if (!ring)
+        return -EINVAL;
+
+    uint8_t tail = ring->tail;
+
+    if (ring->head == tail)
+        return -EAGAIN;
+
+    __sync_synchronize();
+    *frame = ring->frames[tail & (NRF24L01_RX_RING_SIZE - 1)];
+    __sync_synchronize();
+    ring->tail = tail + 1;
+
+    return 0;
+}
+
+/*!
+ * Count payloads in TX FIFO while transmission is stopped by MAX_RT, by filling
+ * FIFO with dummy payloads. FIFO must be flushed after that.
+ */
+static int nrf24l01_tx_fifo_count(struct nrf24l01 *device, uint8_t *count)
+{
+    uint8_t dummy = 0;
+    int status;
+
+    for (*count = 3; *count > 0; (*count)--)
+    {
+        status = nrf24l01_write_payload(device, 1, &dummy);
+        if (status)
+            return status;
+
+        // FIFO doesn't change meanwhile, so STATUS clocked out before payload tells
+        // whether write was ignored.
+        if (device->status & NRF24L01_TX_FULL)
+            break;
+
+        device->saved_transactions++;
+    }
+
+    return 0;
+}
+
+int nrf24l01_send_stream(struct nrf24l01 *device, uint8_t *data, uint16_t size, int8_t *results)
+{
+    uint16_t count = (size + 31) / 32;
+    uint16_t written = 0;
+    uint16_t failed = 0;
+    uint64_t tickStop;
+    uint8_t status_reg;
+    int status;
+
+    // Payload counts as sent only after it has left FIFO without MAX_RT.
+    if (results)
+        for (uint16_t i = 0; i < count; i++)
+            results[i] = -EIO;
+
+    // IRQ handler would steal TX flags.
+    if (device->rx_ring)
+        return -EBUSY;
+
+    status = nrf24l01_flush_tx(device);
+    if (status)
+        return status;
+
+    status = nrf24l01_clear_irq(device, NRF24L01_TX_DS | NRF24L01_MAX_RT);
+    if (status)
+        return status;
+
+    status = nrf24l01_enter_tx(device);
+    if (status)
+        return status;
+
+    // Deadline is moved on each payload sent or failed.
+    tickStop = get_tick_count() + NRF24L01_TX_TIMEOUT;
+
+    for (;;)
+    {
+        uint8_t fifo_reg = 0;
+
+        if (written < count)
+        {
+            status = nrf24l01_get_status(device, &status_reg);
+        }
+        else
+        {
+            // All payloads are queued, FIFO_STATUS is polled and STATUS comes with it.
+            status = nrf24l01_get_fifo_status(device, &fifo_reg);
+            status_reg = device->status;
+            device->saved_transactions++;
+        }
+
+        if (status)
+            break;
+
+        if (status_reg & NRF24L01_MAX_RT)
+        {
+            // Transmission is stopped, failed payload is first in FIFO.
+            uint8_t queued;
+
+            status = nrf24l01_tx_fifo_count(device, &queued);
+            if (status)
+                break;
+
+            uint16_t head = written - queued;
+
+            if (results)
+                results[head] = -ETIMEDOUT;
+            failed++;
+
+            status = nrf24l01_flush_tx(device);
+            if (status)
+                break;
+
+            status = nrf24l01_clear_irq(device, NRF24L01_TX_DS | NRF24L01_MAX_RT);
+            if (status)
+                break;
+
+            // Payloads behind failed one are sent again.
+            if (results)
+                for (uint16_t i = head + 1; i < written; i++)
+                    results[i] = -EIO;
+
+            written = head + 1;
+            tickStop = get_tick_count() + NRF24L01_TX_TIMEOUT;
+            continue;
+        }
+
+        if (status_reg & NRF24L01_TX_DS)
+        {
+            status = nrf24l01_clear_irq(device, NRF24L01_TX_DS);
+            if (status)
+                break;
+
+            tickStop = get_tick_count() + NRF24L01_TX_TIMEOUT;
+        }
+        else if (get_tick_count() >= tickStop)
+        {
+            status = -EIO;
+            break;
+        }
+
+        if (written < count)
+        {
+            if (status_reg & NRF24L01_TX_FULL)
+            {
+                system_nop();
+                continue;
+            }
+
+            uint16_t offset = written * 32;
+            uint8_t psize = (size - offset > 32) ? 32 : size - offset;
+
+            status = nrf24l01_write_payload(device, psize, data + offset);
+            if (status)
+                break;
+
+            if (results)
+                results[written] = 0;
+            written++;
+            continue;
+        }
+
+        if (fifo_reg & NRF24L01_FIFO_TX_EMPTY)
+            break;
+
+        system_nop();
+    }
+
+    if (status)
+    {
+        // Payloads left in FIFO are flushed, whole FIFO is taken as lost if it can't be read.
+        uint8_t queued = 3;
+
+        if (nrf24l01_tx_fifo_count(device, &queued) || (queued > written))
+            queued = written < 3 ? written : 3;
+
+        if (results)
+            for (uint16_t i = written - queued; i < written; i++)
+                results[i] = -EIO;
+
+        nrf24l01_flush_tx(device);
+        nrf24l01_enter_standby(device);
+        return status;
+    }
+
+    status = nrf24l01_enter_standby(device);
+    if (status)
+        return status;
+
+    return failed ? -ETIMEDOUT : 0;
+}
+
+//! Single byte registers set by configuration, FEATURE goes before DYNPD and CONFIG is last.
+static const uint8_t nrf24l01_config_registers[] =
+{
+    NRF24L01_REG_EN_AA,
+    NRF24L01_REG_EN_RXADDR,
+    NRF24L01_REG_SETUP_AW,
+    NRF24L01_REG_SETUP_RETR,
+    NRF24L01_REG_RF_CH,
+    NRF24L01_REG_RF_SETUP,
+    NRF24L01_REG_RX_ADDR_P2,
+    NRF24L01_REG_RX_ADDR_P3,
+    NRF24L01_REG_RX_ADDR_P4,
+    NRF24L01_REG_RX_ADDR_P5,
+    NRF24L01_REG_RX_PW_P0,
+    NRF24L01_REG_RX_PW_P1,
+    NRF24L01_REG_RX_PW_P2,
+    NRF24L01_REG_RX_PW_P3,
+    NRF24L01_REG_RX_PW_P4,
+    NRF24L01_REG_RX_PW_P5,
+    NRF24L01_REG_FEATURE,
+    NRF24L01_REG_DYNPD,
+    NRF24L01_REG_CONFIG
+};
+
+//! Bits, which read back as written.
+static uint8_t nrf24l01_register_mask(uint8_t reg)
+{
+    switch (reg)
+    {
+    case NRF24L01_REG_RF_SETUP:
+        return NRF24L01_RF_DR_LOW | NRF24L01_RF_DR | NRF24L01_RF_PWR;
+    case NRF24L01_REG_RF_CH:
+        return 0x7F;
+    case NRF24L01_REG_SETUP_AW:
+        return 0x03;
+    case NRF24L01_REG_CONFIG:
+        return 0x7F;
+    case NRF24L01_REG_RX_PW_P0:
+    case NRF24L01_REG_RX_PW_P1:
+    case NRF24L01_REG_RX_PW_P2:
+    case NRF24L01_REG_RX_PW_P3:
+    case NRF24L01_REG_RX_PW_P4:
+    case NRF24L01_REG_RX_PW_P5:
+        return 0x3F;
+    case NRF24L01_REG_EN_AA:
+    case NRF24L01_REG_EN_RXADDR:
+    case NRF24L01_REG_DYNPD:
+        return 0x3F;
+    case NRF24L01_REG_FEATURE:
+        return 0x07;
+    default:
+        return 0xFF;
+    }
+}
+
+void nrf24l01_init_config(struct nrf24l01_config *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->crc = 1;
+    config->auto_ack = 0x3F;
+    config->pipes = 0x03;
+    config->address_width = 5;
+    config->retransmit_count = 3;
+    config->channel = 2;
+    config->rate = NRF24L01_DATA_RATE_2M;
+    config->power = NRF24L01_POWER_0DBM;
+    memset(config->tx_address, 0xE7, 5);
+    memset(config->rx_address[0], 0xE7, 5);
+    memset(config->rx_address[1], 0xC2, 5);
+
+    for (int i = 0; i < 4; i++)
+        config->rx_address_lsb[i] = 0xC3 + i;
+}
+
+void nrf24l01_reset_registers(struct nrf24l01_registers *regs)
+{
+    memset(regs, 0, sizeof(*regs));
+    regs->reg[NRF24L01_REG_CONFIG] = NRF24L01_EN_CRC;
+    regs->reg[NRF24L01_REG_EN_AA] = 0x3F;
+    regs->reg[NRF24L01_REG_EN_RXADDR] = 0x03;
+    regs->reg[NRF24L01_REG_SETUP_AW] = 0x03;
+    regs->reg[NRF24L01_REG_SETUP_RETR] = 0x03;
+    regs->reg[NRF24L01_REG_RF_CH] = 0x02;
+    regs->reg[NRF24L01_REG_RF_SETUP] = NRF24L01_RF_DR | NRF24L01_RF_PWR | NRF24L01_LNA_HCURR;
+
+    for (int i = 0; i < 4; i++)
+        regs->reg[NRF24L01_REG_RX_ADDR_P2 + i] = 0xC3 + i;
+
+    memset(regs->rx_addr_p0, 0xE7, 5);
+    memset(regs->rx_addr_p1, 0xC2, 5);
+    memset(regs->tx_addr, 0xE7, 5);
+}
+
+int nrf24l01_read_registers(struct nrf24l01 *device, struct nrf24l01_registers *regs)
+{
+    int status;
+
+    for (uint8_t i = 0; i < sizeof(nrf24l01_config_registers); i++)
+    {
+        uint8_t reg = nrf24l01_config_registers[i];
+
+        status = nrf24l01_read_register(device, reg, &regs->reg[reg]);
+        if (status)
+            return status;
+    }
+
+    status = nrf24l01_read_address_register(device, NRF24L01_REG_RX_ADDR_P0, regs->rx_addr_p0);
+    if (status)
+        return status;
+
+    status = nrf24l01_read_address_register(device, NRF24L01_REG_RX_ADDR_P1, regs->rx_addr_p1);
+    if (status)
+        return status;
+
+    return nrf24l01_read_address_register(device, NRF24L01_REG_TX_ADDR, regs->tx_addr);
+}
+
+static int nrf24l01_config_image(const struct nrf24l01_config *config, struct nrf24l01_registers *image)
+{
+    uint8_t *reg = image->reg;
+
+    if ((config->crc > 2) || (config->address_width < 3) || (config->address_width > 5)
+        || (config->retransmit_delay > 15) || (config->retransmit_count > 15) || (config->channel > 127)
+        || (config->rate > NRF24L01_DATA_RATE_2M) || (config->power > NRF24L01_POWER_0DBM))
+        return -EINVAL;
+
+    memset(image, 0, sizeof(*image));
+
+    reg[NRF24L01_REG_CONFIG] = config->irq_mask & (NRF24L01_MASK_RX_DR | NRF24L01_MASK_TX_DS | NRF24L01_MASK_MAX_RT);
+    if (config->crc)
+        reg[NRF24L01_REG_CONFIG] |= NRF24L01_EN_CRC;
+    if (config->crc == 2)
+        reg[NRF24L01_REG_CONFIG] |= NRF24L01_CRCO;
+    if (config->power_up)
+        reg[NRF24L01_REG_CONFIG] |= NRF24L01_PWR_UP;
+    if (config->rx)
+        reg[NRF24L01_REG_CONFIG] |= NRF24L01_PRIM_RX;
+
+    reg[NRF24L01_REG_EN_AA] = config->auto_ack & 0x3F;
+    reg[NRF24L01_REG_EN_RXADDR] = config->pipes & 0x3F;
+    reg[NRF24L01_REG_SETUP_AW] = config->address_width - 2;
+    reg[NRF24L01_REG_SETUP_RETR] = (config->retransmit_delay << 4) | config->retransmit_count;
+    reg[NRF24L01_REG_RF_CH] = config->channel;
+
+    // LNA_HCURR is reset value of nRF24L01 and obsolete on nRF24L01+.
+    reg[NRF24L01_REG_RF_SETUP] = (config->power << 1) | NRF24L01_LNA_HCURR;
+    if (config->rate == NRF24L01_DATA_RATE_250K)
+        reg[NRF24L01_REG_RF_SETUP] |= NRF24L01_RF_DR_LOW;
+    else if (config->rate == NRF24L01_DATA_RATE_2M)
+        reg[NRF24L01_REG_RF_SETUP] |= NRF24L01_RF_DR;
+
+    for (int i = 0; i < 4; i++)
+        reg[NRF24L01_REG_RX_ADDR_P2 + i] = config->rx_address_lsb[i];
+
+    for (int i = 0; i < 6; i++)
+    {
+        if (config->payload_size[i] > 32)
+            return -EINVAL;
+
+        reg[NRF24L01_REG_RX_PW_P0 + i] = config->payload_size[i];
+    }
+
+    reg[NRF24L01_REG_DYNPD] = config->dynamic_size & 0x3F;
+    reg[NRF24L01_REG_FEATURE] = config->features & (NRF24L01_EN_DPL | NRF24L01_EN_ACK_PAY | NRF24L01_EN_DYN_ACK);
+
+    memcpy(image->rx_addr_p0, config->rx_address[0], 5);
+    memcpy(image->rx_addr_p1, config->rx_address[1], 5);
+    memcpy(image->tx_addr, config->tx_address, 5);
+
+    return 0;
+}
+
+static int nrf24l01_apply_address(struct nrf24l01 *device, uint8_t reg, uint8_t *value, uint8_t *shadow,
+                                  uint8_t verify)
+{
+    uint8_t data[5];
+    int status;
+
+    if (!memcmp(value, shadow, 5))
+        return 0;
+
+    status = nrf24l01_write_address_register(device, reg, value);
+    if (status)
+        return status;
+
+    memcpy(shadow, value, 5);
+
+    if (!verify)
+        return 0;
+
+    status = nrf24l01_read_address_register(device, reg, data);
+    if (status)
+        return status;
+
+    if (memcmp(data, value, 5))
+    {
+        memcpy(shadow, data, 5);
+        return -EIO;
+    }
+
+    return 0;
+}
+
+int nrf24l01_apply_config(struct nrf24l01 *device, const struct nrf24l01_config *config,
+                          struct nrf24l01_registers *shadow, uint8_t verify)
+{
+    struct nrf24l01_registers image;
+    uint8_t data;
+    int status;
+
+    status = nrf24l01_config_image(config, &image);
+    if (status)
+        return status;
+
+    status = nrf24l01_apply_address(device, NRF24L01_REG_RX_ADDR_P0, image.rx_addr_p0, shadow->rx_addr_p0, verify);
+    if (status)
+        return status;
+
+    status = nrf24l01_apply_address(device, NRF24L01_REG_RX_ADDR_P1, image.rx_addr_p1, shadow->rx_addr_p1, verify);
+    if (status)
+        return status;
+
+    status = nrf24l01_apply_address(device, NRF24L01_REG_TX_ADDR, image.tx_addr, shadow->tx_addr, verify);
+    if (status)
+        return status;
+
+    for (uint8_t i = 0; i < sizeof(nrf24l01_config_registers); i++)
+    {
+        uint8_t reg = nrf24l01_config_registers[i];
+        uint8_t mask = nrf24l01_register_mask(reg);
+
+        if (!((image.reg[reg] ^ shadow->reg[reg]) & mask))
+            continue;
+
+        status = nrf24l01_write_register(device, reg, image.reg[reg]);
+        if (status)
+            return status;
+
+        shadow->reg[reg] = image.reg[reg];
+
+        // FEATURE is read back anyway, it ignores writes until features are activated.
+        if (!verify && (reg != NRF24L01_REG_FEATURE))
+            continue;
+
+        status = nrf24l01_read_register(device, reg, &data);
+        if (status)
+            return status;
+
+        if ((reg == NRF24L01_REG_FEATURE) && ((data ^ image.reg[reg]) & mask))
+        {
+            status = nrf24l01_toggle_features(device);
+            if (status)
+                return status;
+
+            status = nrf24l01_write_register(device, reg, image.reg[reg]);
+            if (status)
+                return status;
+
+            status = nrf24l01_read_register(device, reg, &data);
+            if (status)
+                return status;
+        }
+
+        if ((data ^ image.reg[reg]) & mask)
+        {
+            shadow->reg[reg] = data;
+            return -EIO;
+        }
+    }
+
+    return 0;
+}
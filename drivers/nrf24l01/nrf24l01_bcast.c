@@ -0,0 +1,295 @@
+#include "bm/nrf24l01_bcast.h"
+#include "bm/nrf24l01.h"
+#include "bm/delay.h"
+#include <string.h>
+#include <errno.h>
+
+int nrf24l01_bcast_init(struct nrf24l01_bcast *bcast, struct nrf24l01 *device)
+{
+    bcast->device = device;
+    bcast->group = 0;
+    bcast->active = 0;
+    bcast->done = 0;
+    bcast->pending = 0;
+    bcast->listening = 0;
+    bcast->received = 0;
+    bcast->recovered = 0;
+    bcast->lost = 0;
+
+    return nrf24l01_enable_dynamic_ack(device);
+}
+
+//! Write packet when TX FIFO has room.
+static int nrf24l01_bcast_queue(struct nrf24l01 *device, uint8_t *packet)
+{
+    uint64_t tickStop = get_tick_count() + NRF24L01_TX_TIMEOUT;
+    uint8_t status_reg;
+    int status;
+
+    for (;;)
+    {
+        status = nrf24l01_get_status(device, &status_reg);
+        if (status)
+            return status;
+
+        if (!(status_reg & NRF24L01_TX_FULL))
+            return nrf24l01_write_payload_no_ack(device, 32, packet);
+
+        if (get_tick_count() >= tickStop)
+            return -ETIMEDOUT;
+
+        system_nop();
+    }
+}
+
+int nrf24l01_bcast_send(struct nrf24l01_bcast *bcast, const uint8_t *data, uint16_t size)
+{
+    struct nrf24l01 *device = bcast->device;
+    uint8_t packet[32];
+    uint8_t parity[32];
+    struct nrf24l01_bcast_header *header = (struct nrf24l01_bcast_header *)packet;
+    struct nrf24l01_bcast_header *parity_header = (struct nrf24l01_bcast_header *)parity;
+    uint16_t packets = (size + NRF24L01_BCAST_PAYLOAD - 1) / NRF24L01_BCAST_PAYLOAD;
+    uint8_t fifo_reg;
+    int status = 0;
+
+    if (device->rx_ring)
+        return -EBUSY;
+
+    bcast->listening = 0;
+
+    status = nrf24l01_enter_tx(device);
+    if (status)
+        return status;
+
+    for (uint16_t first = 0; first < packets; first += NRF24L01_BCAST_GROUP)
+    {
+        uint8_t count = (packets - first > NRF24L01_BCAST_GROUP) ? NRF24L01_BCAST_GROUP : packets - first;
+
+        memset(parity, 0, sizeof(parity));
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+            uint16_t offset = (first + i) * NRF24L01_BCAST_PAYLOAD;
+            uint8_t len = (size - offset > NRF24L01_BCAST_PAYLOAD) ? NRF24L01_BCAST_PAYLOAD : size - offset;
+
+            header->group = bcast->group;
+            header->index = i;
+            header->count = count;
+            header->len = len;
+            memcpy(packet + NRF24L01_BCAST_HEADER_SIZE, data + offset, len);
+            memset(packet + NRF24L01_BCAST_HEADER_SIZE + len, 0, NRF24L01_BCAST_PAYLOAD - len);
+
+            for (int j = NRF24L01_BCAST_HEADER_SIZE - 1; j < 32; j++)
+                parity[j] ^= packet[j];
+
+            status = nrf24l01_bcast_queue(device, packet);
+            if (status)
+                break;
+        }
+
+        if (status)
+            break;
+
+        // Parity len is XOR of packet sizes.
+        parity_header->group = bcast->group;
+        parity_header->index = count;
+        parity_header->count = count;
+
+        status = nrf24l01_bcast_queue(device, parity);
+        if (status)
+            break;
+
+        bcast->group++;
+    }
+
+    uint64_t tickStop = get_tick_count() + NRF24L01_TX_TIMEOUT;
+
+    while (!status)
+    {
+        status = nrf24l01_get_fifo_status(device, &fifo_reg);
+        if (status || (fifo_reg & NRF24L01_FIFO_TX_EMPTY))
+            break;
+
+        if (get_tick_count() >= tickStop)
+            status = -ETIMEDOUT;
+        else
+            system_nop();
+    }
+
+    if (status)
+    {
+        nrf24l01_flush_tx(device);
+        nrf24l01_enter_standby(device);
+        return status;
+    }
+
+    // TX_DS is set for each packet, IRQ pin is released once.
+    status = nrf24l01_clear_irq(device, NRF24L01_TX_DS);
+    if (status)
+        return status;
+
+    return nrf24l01_enter_standby(device);
+}
+
+//! Keep received packet, packet of next group finishes current group.
+static void nrf24l01_bcast_store(struct nrf24l01_bcast *bcast, const uint8_t *packet)
+{
+    const struct nrf24l01_bcast_header *header = (const struct nrf24l01_bcast_header *)packet;
+
+    if ((header->count == 0) || (header->count > NRF24L01_BCAST_GROUP) || (header->index > header->count)
+        || (header->len > NRF24L01_BCAST_PAYLOAD))
+        return;
+
+    if (!bcast->active)
+    {
+        // Late packet of group, which was delivered on timeout.
+        if (bcast->done && (header->group == bcast->group))
+            return;
+
+        bcast->active = 1;
+        bcast->final = 0;
+        bcast->group = header->group;
+        bcast->count = header->count;
+        bcast->pos = 0;
+        bcast->mask = 0;
+    }
+    else if (header->group != bcast->group)
+    {
+        // Link doesn't reorder packets, so current group won't get more packets.
+        bcast->final = 1;
+        bcast->pending = 1;
+        memcpy(bcast->next, packet, 32);
+        return;
+    }
+
+    if (bcast->mask & (1UL << header->index))
+        return;
+
+    bcast->mask |= 1UL << header->index;
+    bcast->len[header->index] = header->len;
+    memcpy(bcast->data[header->index], packet + NRF24L01_BCAST_HEADER_SIZE, NRF24L01_BCAST_PAYLOAD);
+
+    if (header->index < header->count)
+        bcast->received++;
+}
+
+//! Rebuild single missing data packet from parity.
+static void nrf24l01_bcast_recover(struct nrf24l01_bcast *bcast)
+{
+    uint8_t missing = bcast->pos;
+    uint8_t *data = bcast->data[missing];
+
+    bcast->len[missing] = bcast->len[bcast->count];
+    memcpy(data, bcast->data[bcast->count], NRF24L01_BCAST_PAYLOAD);
+
+    for (uint8_t i = 0; i < bcast->count; i++)
+    {
+        if (i == missing)
+            continue;
+
+        bcast->len[missing] ^= bcast->len[i];
+        for (int j = 0; j < NRF24L01_BCAST_PAYLOAD; j++)
+            data[j] ^= bcast->data[i][j];
+    }
+
+    if (bcast->len[missing] > NRF24L01_BCAST_PAYLOAD)
+        bcast->len[missing] = NRF24L01_BCAST_PAYLOAD;
+
+    bcast->mask |= 1UL << missing;
+    bcast->recovered++;
+}
+
+static int nrf24l01_bcast_deliver(struct nrf24l01_bcast *bcast, uint8_t *data, uint8_t *size)
+{
+    while (bcast->active)
+    {
+        if (bcast->pos >= bcast->count)
+        {
+            // Parity of delivered group may still come.
+            if (!bcast->final)
+                return -EAGAIN;
+
+            bcast->active = 0;
+            bcast->done = 1;
+
+            if (bcast->pending)
+            {
+                bcast->pending = 0;
+                nrf24l01_bcast_store(bcast, bcast->next);
+            }
+            continue;
+        }
+
+        if (bcast->mask & (1UL << bcast->pos))
+        {
+            *size = bcast->len[bcast->pos];
+            memcpy(data, bcast->data[bcast->pos], *size);
+            bcast->pos++;
+            return 0;
+        }
+
+        uint32_t received = bcast->mask & ((1UL << bcast->count) - 1);
+        uint8_t missing = bcast->count;
+
+        for (; received; received &= received - 1)
+            missing--;
+
+        if ((missing == 1) && (bcast->mask & (1UL << bcast->count)))
+        {
+            nrf24l01_bcast_recover(bcast);
+            continue;
+        }
+
+        if (!bcast->final)
+            return -EAGAIN;
+
+        bcast->lost++;
+        bcast->pos++;
+    }
+
+    return -EAGAIN;
+}
+
+int nrf24l01_bcast_receive(struct nrf24l01_bcast *bcast, uint8_t *data, uint8_t *size, uint16_t timeout)
+{
+    struct nrf24l01 *device = bcast->device;
+    uint64_t tickStop = get_tick_count() + timeout;
+    struct nrf24l01_frame frame;
+    int status;
+
+    // Device stays in RX mode between calls, so stream isn't lost while data is processed.
+    if (!bcast->listening)
+    {
+        status = nrf24l01_enter_rx(device);
+        if (status)
+            return status;
+
+        bcast->listening = 1;
+    }
+
+    for (;;)
+    {
+        if (!nrf24l01_bcast_deliver(bcast, data, size))
+            return 0;
+
+        if ((timeout != 0) && (get_tick_count() >= tickStop))
+        {
+            bcast->final = 1;
+            return nrf24l01_bcast_deliver(bcast, data, size) ? -ETIMEDOUT : 0;
+        }
+
+        status = nrf24l01_read_frame(device, &frame);
+        if (status == -EAGAIN)
+        {
+            system_nop();
+            continue;
+        }
+
+        if (status)
+            return status;
+
+        if (frame.size == 32)
+            nrf24l01_bcast_store(bcast, frame.data);
+    }
+}
@@ -0,0 +1,301 @@
+#include "bm/nrf24l01_frag.h"
+#include "bm/nrf24l01.h"
+#include "bm/delay.h"
+#include <string.h>
+#include <errno.h>
+
+//! Fragments passed to nrf24l01_send_stream() at once.
+#define NRF24L01_FRAG_BATCH 8
+
+#define NRF24L01_FRAG_HISTORY_NONE 0xFFFF
+
+static uint8_t nrf24l01_frag_count(uint16_t size)
+{
+    return (size + NRF24L01_FRAG_PAYLOAD - 1) / NRF24L01_FRAG_PAYLOAD;
+}
+
+static uint8_t nrf24l01_frag_size(uint16_t size, uint8_t index)
+{
+    uint16_t offset = index * NRF24L01_FRAG_PAYLOAD;
+    return (size - offset > NRF24L01_FRAG_PAYLOAD) ? NRF24L01_FRAG_PAYLOAD : size - offset;
+}
+
+int nrf24l01_frag_init(struct nrf24l01_frag *frag, struct nrf24l01 *device)
+{
+    frag->device = device;
+    frag->next_id = 0;
+    frag->history_pos = 0;
+
+    for (int i = 0; i < NRF24L01_FRAG_HISTORY; i++)
+    {
+        frag->history[i].key = NRF24L01_FRAG_HISTORY_NONE;
+        frag->history[i].stamp = 0;
+    }
+
+    for (int i = 0; i < NRF24L01_FRAG_BUFFERS; i++)
+        nrf24l01_frag_release(&frag->buffers[i]);
+
+    frag->duplicates = 0;
+    frag->dropped = 0;
+    frag->expired = 0;
+    frag->malformed = 0;
+    frag->resent = 0;
+
+    return 0;
+}
+
+int nrf24l01_frag_send(struct nrf24l01_frag *frag, const uint8_t *data, uint16_t size)
+{
+    uint8_t pending[(NRF24L01_FRAG_MAX_FRAGMENTS + 7) / 8];
+    uint8_t frames[NRF24L01_FRAG_BATCH][32];
+    uint8_t batch[NRF24L01_FRAG_BATCH];
+    int8_t results[NRF24L01_FRAG_BATCH];
+
+    if ((size == 0) || (size > NRF24L01_FRAG_MAX_SIZE))
+        return -EINVAL;
+
+    uint8_t count = nrf24l01_frag_count(size);
+    uint8_t id = frag->next_id++;
+
+    memset(pending, 0xFF, sizeof(pending));
+
+    for (int attempt = 0; attempt < NRF24L01_FRAG_RETRIES; attempt++)
+    {
+        uint8_t failed = 0;
+        uint16_t index = 0;
+
+        while (index < count)
+        {
+            uint16_t length = 0;
+            uint8_t num = 0;
+
+            // Only last fragment of message is short, so it is always last in batch.
+            for (; (index < count) && (num < NRF24L01_FRAG_BATCH); index++)
+            {
+                if (!(pending[index / 8] & (1 << (index % 8))))
+                    continue;
+
+                struct nrf24l01_frag_header *header = (struct nrf24l01_frag_header *)frames[num];
+                uint8_t chunk = nrf24l01_frag_size(size, index);
+
+                header->id = id;
+                header->index = index;
+                header->size[0] = size & 0xFF;
+                header->size[1] = size >> 8;
+                memcpy(frames[num] + NRF24L01_FRAG_HEADER_SIZE, data + index * NRF24L01_FRAG_PAYLOAD, chunk);
+
+                length = num * 32 + NRF24L01_FRAG_HEADER_SIZE + chunk;
+                batch[num++] = index;
+            }
+
+            if (!num)
+                break;
+
+            // Fragment is taken as delivered only if stream reports it so.
+            for (int i = 0; i < num; i++)
+                results[i] = -ETIMEDOUT;
+
+            // Stalled radio aborts message, fragments of batch may be lost or duplicated.
+            int status = nrf24l01_send_stream(frag->device, frames[0], length, results);
+            if (status && (status != -ETIMEDOUT))
+                return status;
+
+            for (int i = 0; i < num; i++)
+            {
+                if (results[i])
+                    failed++;
+                else
+                    pending[batch[i] / 8] &= ~(1 << (batch[i] % 8));
+            }
+        }
+
+        if (!failed)
+            return 0;
+
+        if (attempt + 1 < NRF24L01_FRAG_RETRIES)
+            frag->resent += failed;
+    }
+
+    return -ETIMEDOUT;
+}
+
+static struct nrf24l01_frag_buffer *nrf24l01_frag_alloc(struct nrf24l01_frag *frag, uint64_t now)
+{
+    struct nrf24l01_frag_buffer *victim = 0;
+
+    for (int i = 0; i < NRF24L01_FRAG_BUFFERS; i++)
+    {
+        struct nrf24l01_frag_buffer *buffer = &frag->buffers[i];
+
+        if (!buffer->count)
+            return buffer;
+
+        if (buffer->complete)
+            continue;
+
+        if (!victim || (buffer->stamp < victim->stamp))
+            victim = buffer;
+    }
+
+    if (!victim || (victim->stamp + NRF24L01_FRAG_TIMEOUT > now))
+        return 0;
+
+    frag->expired++;
+    return victim;
+}
+
+int nrf24l01_frag_input(struct nrf24l01_frag *frag, uint8_t pipe, const uint8_t *data, uint8_t size,
+                        struct nrf24l01_frag_buffer **message)
+{
+    const struct nrf24l01_frag_header *header = (const struct nrf24l01_frag_header *)data;
+    struct nrf24l01_frag_buffer *buffer = 0;
+
+    *message = 0;
+
+    if (size < NRF24L01_FRAG_HEADER_SIZE)
+    {
+        frag->malformed++;
+        return -EBADMSG;
+    }
+
+    uint16_t message_size = header->size[0] | (header->size[1] << 8);
+    uint8_t count = nrf24l01_frag_count(message_size);
+
+    if ((message_size == 0) || (message_size > NRF24L01_FRAG_MAX_SIZE) || (header->index >= count)
+        || (size != NRF24L01_FRAG_HEADER_SIZE + nrf24l01_frag_size(message_size, header->index)))
+    {
+        frag->malformed++;
+        return -EBADMSG;
+    }
+
+    uint16_t key = (pipe << 8) | header->id;
+    uint64_t now = get_tick_count();
+
+    // Entries expire, so message of restarted sender isn't dropped for ID it has reused.
+    for (int i = 0; i < NRF24L01_FRAG_HISTORY; i++)
+    {
+        struct nrf24l01_frag_history *entry = &frag->history[i];
+
+        if (entry->key != key)
+            continue;
+
+        if (entry->stamp + NRF24L01_FRAG_HISTORY_TIMEOUT <= now)
+        {
+            entry->key = NRF24L01_FRAG_HISTORY_NONE;
+            continue;
+        }
+
+        frag->duplicates++;
+        return 0;
+    }
+
+    for (int i = 0; i < NRF24L01_FRAG_BUFFERS; i++)
+    {
+        struct nrf24l01_frag_buffer *candidate = &frag->buffers[i];
+
+        if (candidate->count && !candidate->complete && (candidate->pipe == pipe) && (candidate->id == header->id))
+        {
+            buffer = candidate;
+            break;
+        }
+    }
+
+    // Size mismatch means sender has reused ID, old message is lost anyway.
+    if (!buffer || (buffer->size != message_size))
+    {
+        if (!buffer)
+            buffer = nrf24l01_frag_alloc(frag, now);
+
+        if (!buffer)
+        {
+            frag->dropped++;
+            return -ENOBUFS;
+        }
+
+        buffer->pipe = pipe;
+        buffer->id = header->id;
+        buffer->count = count;
+        buffer->received = 0;
+        buffer->complete = 0;
+        buffer->size = message_size;
+        memset(buffer->map, 0, sizeof(buffer->map));
+    }
+
+    uint8_t index = header->index;
+
+    if (buffer->map[index / 8] & (1 << (index % 8)))
+    {
+        frag->duplicates++;
+        return 0;
+    }
+
+    memcpy(buffer->data + index * NRF24L01_FRAG_PAYLOAD, data + NRF24L01_FRAG_HEADER_SIZE,
+           size - NRF24L01_FRAG_HEADER_SIZE);
+    buffer->map[index / 8] |= 1 << (index % 8);
+    buffer->received++;
+    buffer->stamp = now;
+
+    if (buffer->received == buffer->count)
+    {
+        buffer->complete = 1;
+        frag->history[frag->history_pos].key = key;
+        frag->history[frag->history_pos].stamp = now;
+        frag->history_pos = (frag->history_pos + 1) % NRF24L01_FRAG_HISTORY;
+        *message = buffer;
+    }
+
+    return 0;
+}
+
+int nrf24l01_frag_receive(struct nrf24l01_frag *frag, struct nrf24l01_frag_buffer **message, uint16_t timeout)
+{
+    struct nrf24l01 *device = frag->device;
+    uint64_t tickStop = get_tick_count() + timeout;
+    struct nrf24l01_frame frame;
+    int status;
+
+    // Device stays in RX mode for whole message, nrf24l01_receive_packet() would leave it between payloads.
+    status = nrf24l01_enter_rx(device);
+    if (status)
+        return status;
+
+    *message = 0;
+
+    while (!*message)
+    {
+        if ((timeout != 0) && (get_tick_count() >= tickStop))
+        {
+            nrf24l01_enter_standby(device);
+            return -ETIMEDOUT;
+        }
+
+        status = nrf24l01_read_frame(device, &frame);
+        if (status == -EAGAIN)
+        {
+            system_nop();
+            continue;
+        }
+
+        if (status)
+            break;
+
+        // Invalid fragments and fragments without buffer are dropped and counted.
+        nrf24l01_frag_input(frag, frame.pipe, frame.data, frame.size, message);
+    }
+
+    if (status)
+    {
+        nrf24l01_flush_rx(device);
+        nrf24l01_enter_standby(device);
+        return status;
+    }
+
+    return nrf24l01_enter_standby(device);
+}
+
+void nrf24l01_frag_release(struct nrf24l01_frag_buffer *message)
+{
+    message->count = 0;
+    message->received = 0;
+    message->complete = 0;
+}
@@ -0,0 +1,386 @@
+#include "bm/nrf24l01_hub.h"
+#include "bm/nrf24l01.h"
+#include "bm/delay.h"
+#include <string.h>
+#include <errno.h>
+
+#define NRF24L01_HUB_QUEUE_MASK (NRF24L01_HUB_QUEUE_SIZE - 1)
+
+static void nrf24l01_hub_reset_node(struct nrf24l01_hub_node *node)
+{
+    node->enabled = 0;
+    node->loaded = 0;
+    node->seen = 0;
+    node->rx_head = 0;
+    node->rx_tail = 0;
+    node->tx_head = 0;
+    node->tx_tail = 0;
+    memset(&node->stats, 0, sizeof(node->stats));
+}
+
+//! Take all ACK payloads back, they stay first in node TX queues.
+static int nrf24l01_hub_unload(struct nrf24l01_hub *hub)
+{
+    for (int i = 0; i < NRF24L01_HUB_NODES; i++)
+    {
+        hub->nodes[i].loaded = 0;
+        hub->nodes[i].seen = 0;
+    }
+
+    hub->loaded = 0;
+
+    return nrf24l01_flush_tx(hub->device);
+}
+
+static void nrf24l01_hub_delivered(struct nrf24l01_hub *hub, struct nrf24l01_hub_node *node)
+{
+    node->loaded = 0;
+    node->seen = 0;
+    hub->loaded--;
+    node->tx_tail++;
+    node->stats.tx++;
+}
+
+/*!
+ * Confirm delivered ACK payloads after TX_DS. ACK payload goes out only with ACK to
+ * payload from its node, so it is delivered by the only loaded node, from which payload
+ * was received. If there are more such nodes, all of them are confirmed when TX FIFO is
+ * empty, otherwise next TX_DS decides.
+ */
+static int nrf24l01_hub_confirm(struct nrf24l01_hub *hub)
+{
+    struct nrf24l01_hub_node *candidate = 0;
+    uint8_t candidates = 0;
+    uint8_t fifo_reg;
+    int status;
+
+    for (int i = 0; i < NRF24L01_HUB_NODES; i++)
+    {
+        if (hub->nodes[i].loaded && hub->nodes[i].seen)
+        {
+            candidate = &hub->nodes[i];
+            candidates++;
+        }
+    }
+
+    if (candidates == 1)
+    {
+        nrf24l01_hub_delivered(hub, candidate);
+        return 0;
+    }
+
+    if (candidates == 0)
+        return 0;
+
+    status = nrf24l01_get_fifo_status(hub->device, &fifo_reg);
+    if (status)
+        return status;
+
+    if (!(fifo_reg & NRF24L01_FIFO_TX_EMPTY))
+        return 0;
+
+    for (int i = 0; i < NRF24L01_HUB_NODES; i++)
+        if (hub->nodes[i].loaded)
+            nrf24l01_hub_delivered(hub, &hub->nodes[i]);
+
+    return 0;
+}
+
+static int nrf24l01_hub_load(struct nrf24l01_hub *hub)
+{
+    uint64_t now = get_tick_count();
+    int waiting = 0;
+    int stale = 0;
+    int status;
+
+    uint8_t first = hub->next;
+
+    for (int i = 0; i < NRF24L01_HUB_NODES; i++)
+    {
+        uint8_t pipe = (first + i) % NRF24L01_HUB_NODES;
+        struct nrf24l01_hub_node *node = &hub->nodes[pipe];
+
+        if (!node->enabled || (node->tx_head == node->tx_tail))
+            continue;
+
+        if (node->loaded)
+        {
+            if (node->loaded_at + NRF24L01_HUB_ACK_TIMEOUT <= now)
+                stale = 1;
+            continue;
+        }
+
+        if (hub->loaded >= 3)
+        {
+            waiting = 1;
+            continue;
+        }
+
+        struct nrf24l01_frame *frame = &node->tx[node->tx_tail & NRF24L01_HUB_QUEUE_MASK];
+
+        status = nrf24l01_write_ack_payload(hub->device, pipe, frame->size, frame->data);
+        if (status)
+            return status;
+
+        node->loaded = 1;
+        node->seen = 0;
+        node->loaded_at = now;
+        hub->loaded++;
+
+        // Round-robin, node gets next slot after all other waiting nodes.
+        hub->next = (pipe + 1) % NRF24L01_HUB_NODES;
+    }
+
+    // Silent node holds TX FIFO slot, other nodes get it on next poll.
+    if (waiting && stale)
+    {
+        for (int i = 0; i < NRF24L01_HUB_NODES; i++)
+            if (hub->nodes[i].loaded)
+                hub->nodes[i].stats.tx_reloaded++;
+
+        return nrf24l01_hub_unload(hub);
+    }
+
+    return 0;
+}
+
+int nrf24l01_hub_init(struct nrf24l01_hub *hub, struct nrf24l01 *device)
+{
+    int status;
+
+    hub->device = device;
+    hub->loaded = 0;
+    hub->next = 0;
+
+    for (int i = 0; i < NRF24L01_HUB_NODES; i++)
+        nrf24l01_hub_reset_node(&hub->nodes[i]);
+
+    status = nrf24l01_disable_pipes(device, 0x3F);
+    if (status)
+        return status;
+
+    status = nrf24l01_enable_dynamic_size(device);
+    if (status)
+        return status;
+
+    status = nrf24l01_enable_ack_payload(device);
+    if (status)
+        return status;
+
+    status = nrf24l01_flush_tx(device);
+    if (status)
+        return status;
+
+    status = nrf24l01_flush_rx(device);
+    if (status)
+        return status;
+
+    status = nrf24l01_clear_irq(device, NRF24L01_RX_DR | NRF24L01_TX_DS | NRF24L01_MAX_RT);
+    if (status)
+        return status;
+
+    return nrf24l01_enter_rx(device);
+}
+
+int nrf24l01_hub_add_node(struct nrf24l01_hub *hub, uint8_t pipe, const uint8_t address[5])
+{
+    struct nrf24l01_hub_node *node;
+    uint8_t reg;
+    int status;
+
+    if (pipe >= NRF24L01_HUB_NODES)
+        return -EINVAL;
+
+    node = &hub->nodes[pipe];
+
+    // Pipes 2-5 share 4 most significant address bytes with pipe 1.
+    if ((pipe >= 2) && (!hub->nodes[1].enabled || memcmp(address + 1, hub->nodes[1].address + 1, 4)))
+        return -EINVAL;
+
+    if (pipe == 1)
+    {
+        for (int i = 2; i < NRF24L01_HUB_NODES; i++)
+            if (hub->nodes[i].enabled && memcmp(address + 1, hub->nodes[i].address + 1, 4))
+                return -EINVAL;
+    }
+
+    nrf24l01_hub_reset_node(node);
+    memcpy(node->address, address, 5);
+
+    status = nrf24l01_set_rx_address(hub->device, pipe, node->address);
+    if (status)
+        return status;
+
+    status = nrf24l01_enable_dynamic_pipe_size(hub->device, 1 << pipe);
+    if (status)
+        return status;
+
+    status = nrf24l01_read_register(hub->device, NRF24L01_REG_EN_AA, &reg);
+    if (status)
+        return status;
+
+    status = nrf24l01_write_register(hub->device, NRF24L01_REG_EN_AA, reg | (1 << pipe));
+    if (status)
+        return status;
+
+    status = nrf24l01_enable_pipes(hub->device, 1 << pipe);
+    if (status)
+        return status;
+
+    node->enabled = 1;
+    return 0;
+}
+
+int nrf24l01_hub_remove_node(struct nrf24l01_hub *hub, uint8_t pipe)
+{
+    struct nrf24l01_hub_node *node;
+    int status;
+
+    if (pipe >= NRF24L01_HUB_NODES)
+        return -EINVAL;
+
+    node = &hub->nodes[pipe];
+
+    status = nrf24l01_disable_pipes(hub->device, 1 << pipe);
+    if (status)
+        return status;
+
+    // Single ACK payload can't be removed from TX FIFO.
+    if (node->loaded)
+    {
+        status = nrf24l01_hub_unload(hub);
+        if (status)
+            return status;
+    }
+
+    nrf24l01_hub_reset_node(node);
+    return 0;
+}
+
+int nrf24l01_hub_poll(struct nrf24l01_hub *hub)
+{
+    struct nrf24l01 *device = hub->device;
+    struct nrf24l01_frame overflow;
+    uint8_t status_reg;
+    int status;
+
+    status = nrf24l01_get_status(device, &status_reg);
+    if (status)
+        return status;
+
+    uint8_t irq = status_reg & (NRF24L01_RX_DR | NRF24L01_TX_DS | NRF24L01_MAX_RT);
+
+    if (irq)
+    {
+        status = nrf24l01_clear_irq(device, irq);
+        if (status)
+            return status;
+    }
+
+    for (;;)
+    {
+        uint8_t size;
+
+        status = nrf24l01_get_size(device, &size);
+        if (status)
+            return status;
+
+        uint8_t pipe = (device->status & NRF24L01_RX_P_NO) >> 1;
+
+        if (pipe >= NRF24L01_HUB_NODES)
+            break;
+
+        if (size > 32)
+        {
+            status = nrf24l01_flush_rx(device);
+            if (status)
+                return status;
+            break;
+        }
+
+        struct nrf24l01_hub_node *node = &hub->nodes[pipe];
+        uint8_t head = node->rx_head;
+        struct nrf24l01_frame *frame = &node->rx[head & NRF24L01_HUB_QUEUE_MASK];
+
+        if ((uint8_t)(head - node->rx_tail) >= NRF24L01_HUB_QUEUE_SIZE)
+            frame = &overflow;
+
+        frame->size = size;
+
+        status = nrf24l01_read_payload(device, size, frame->data, &frame->pipe);
+        if (status)
+            return status;
+
+        /*
+         * Payload may have been received just before ACK payload was loaded and got
+         * empty ACK, so delivery is confirmed by TX_DS only.
+         */
+        if (node->loaded)
+            node->seen = 1;
+
+        node->stats.last_seen = get_tick_count();
+
+        if (frame == &overflow)
+        {
+            node->stats.rx_dropped++;
+        }
+        else
+        {
+            node->stats.rx++;
+            __sync_synchronize();
+            node->rx_head = head + 1;
+        }
+    }
+
+    // TX_DS read before draining follows payloads, which are drained by now.
+    if (irq & NRF24L01_TX_DS)
+    {
+        status = nrf24l01_hub_confirm(hub);
+        if (status)
+            return status;
+    }
+
+    return nrf24l01_hub_load(hub);
+}
+
+int nrf24l01_hub_receive(struct nrf24l01_hub *hub, uint8_t pipe, struct nrf24l01_frame *frame)
+{
+    if ((pipe >= NRF24L01_HUB_NODES) || !hub->nodes[pipe].enabled)
+        return -EINVAL;
+
+    struct nrf24l01_hub_node *node = &hub->nodes[pipe];
+    uint8_t tail = node->rx_tail;
+
+    if (node->rx_head == tail)
+        return -EAGAIN;
+
+    __sync_synchronize();
+    *frame = node->rx[tail & NRF24L01_HUB_QUEUE_MASK];
+    __sync_synchronize();
+    node->rx_tail = tail + 1;
+
+    return 0;
+}
+
+int nrf24l01_hub_send(struct nrf24l01_hub *hub, uint8_t pipe, const uint8_t *data, uint8_t size)
+{
+    if ((pipe >= NRF24L01_HUB_NODES) || !hub->nodes[pipe].enabled || (size > 32))
+        return -EINVAL;
+
+    struct nrf24l01_hub_node *node = &hub->nodes[pipe];
+    uint8_t head = node->tx_head;
+
+    if ((uint8_t)(head - node->tx_tail) >= NRF24L01_HUB_QUEUE_SIZE)
+        return -ENOBUFS;
+
+    struct nrf24l01_frame *frame = &node->tx[head & NRF24L01_HUB_QUEUE_MASK];
+
+    frame->pipe = pipe;
+    frame->size = size;
+    memcpy(frame->data, data, size);
+
+    __sync_synchronize();
+    node->tx_head = head + 1;
+
+    return 0;
+}
@@ -0,0 +1,280 @@
+#include "bm/nrf24l01_link.h"
+#include "bm/nrf24l01.h"
+#include "bm/delay.h"
+#include <string.h>
+#include <errno.h>
+
+//! Airtime in microseconds of packet with given payload, 130 us PLL settling included.
+static uint32_t nrf24l01_link_packet_time(uint8_t rate, uint8_t size)
+{
+    // Preamble, 5-byte address, 9-bit packet control field, payload and 2-byte CRC.
+    uint32_t bits = (1 + 5 + size + 2) * 8 + 9;
+
+    switch (rate)
+    {
+    case NRF24L01_DATA_RATE_250K:
+        return 130 + bits * 4;
+    case NRF24L01_DATA_RATE_2M:
+        return 130 + (bits + 1) / 2;
+    default:
+        return 130 + bits;
+    }
+}
+
+//! Shortest auto retransmit delay, which fits ACK with payload.
+static uint8_t nrf24l01_link_delay(struct nrf24l01_link *link, uint8_t rate)
+{
+    uint32_t time = nrf24l01_link_packet_time(rate, link->ack_size);
+    uint8_t delay = (time + 249) / 250 - 1;
+
+    return (delay > 15) ? 15 : delay;
+}
+
+static int nrf24l01_link_apply(struct nrf24l01_link *link, uint8_t index)
+{
+    struct nrf24l01_link_peer *peer = &link->peers[index];
+    int status;
+
+    status = nrf24l01_set_tx_address(link->device, peer->address);
+    if (status)
+        return status;
+
+    // ACK comes back on pipe 0.
+    status = nrf24l01_set_rx_address(link->device, 0, peer->address);
+    if (status)
+        return status;
+
+    status = nrf24l01_set_data_rate(link->device, peer->rate);
+    if (status)
+        return status;
+
+    status = nrf24l01_set_power(link->device, peer->power);
+    if (status)
+        return status;
+
+    status = nrf24l01_setup_retransmit(link->device, nrf24l01_link_delay(link, peer->rate), peer->retransmits);
+    if (status)
+        return status;
+
+    link->current = index;
+    return 0;
+}
+
+//! Review window and pick settings for next one. Returns 1 if settings changed.
+static int nrf24l01_link_tune(struct nrf24l01_link_peer *peer)
+{
+    uint8_t rate = peer->rate;
+    uint8_t power = peer->power;
+    uint8_t retransmits = peer->retransmits;
+
+    if (peer->window_airtime)
+        peer->goodput[rate] = (uint64_t)peer->window_bytes * 1000000 / peer->window_airtime;
+
+    uint32_t *slower = (rate > NRF24L01_DATA_RATE_250K) ? &peer->goodput[rate - 1] : 0;
+    uint32_t *faster = (rate < NRF24L01_DATA_RATE_2M) ? &peer->goodput[rate + 1] : 0;
+
+    if (peer->window_lost)
+    {
+        if (power < NRF24L01_POWER_0DBM)
+            power++;
+        else if (slower && (*slower > peer->goodput[rate]))
+            rate--;
+        else if (retransmits < 15)
+            retransmits = (retransmits > 11) ? 15 : retransmits + 4;
+        else if (slower)
+            rate--;
+    }
+    else if (peer->window_retransmits > peer->window_sent)
+    {
+        if (power < NRF24L01_POWER_0DBM)
+            power++;
+        else if (slower && ((*slower == 0) || (*slower > peer->goodput[rate])))
+            rate--;
+    }
+    else
+    {
+        // No payload came close to MAX_RT.
+        if ((retransmits > NRF24L01_LINK_MIN_RETRANSMITS) && (peer->window_peak + 2 <= retransmits))
+            retransmits--;
+
+        if (faster)
+        {
+            // Bad result of faster rate is forgotten slowly, so it is probed again later.
+            if ((*faster == 0) || (*faster >= peer->goodput[rate]))
+                rate++;
+            else
+                *faster += (*faster >> 3) + 1;
+        }
+    }
+
+    peer->window_sent = 0;
+    peer->window_lost = 0;
+    peer->window_retransmits = 0;
+    peer->window_peak = 0;
+    peer->window_bytes = 0;
+    peer->window_airtime = 0;
+
+    if ((rate == peer->rate) && (power == peer->power) && (retransmits == peer->retransmits))
+        return 0;
+
+    peer->rate = rate;
+    peer->power = power;
+    peer->retransmits = retransmits;
+    return 1;
+}
+
+int nrf24l01_link_init(struct nrf24l01_link *link, struct nrf24l01 *device, uint8_t channel, uint8_t ack_size)
+{
+    if ((channel > 127) || (ack_size > 32))
+        return -EINVAL;
+
+    link->device = device;
+    link->channel = channel;
+    link->ack_size = ack_size;
+    link->count = 0;
+    link->current = 0xFF;
+
+    return nrf24l01_set_channel(device, channel);
+}
+
+int nrf24l01_link_add_peer(struct nrf24l01_link *link, const uint8_t address[5])
+{
+    struct nrf24l01_link_peer *peer;
+
+    if (link->count >= NRF24L01_LINK_PEERS)
+        return -ENOBUFS;
+
+    peer = &link->peers[link->count];
+    memset(peer, 0, sizeof(*peer));
+    memcpy(peer->address, address, 5);
+    peer->rate = NRF24L01_DATA_RATE_1M;
+    peer->power = NRF24L01_POWER_0DBM;
+    peer->retransmits = NRF24L01_LINK_MIN_RETRANSMITS;
+
+    return link->count++;
+}
+
+int nrf24l01_link_send(struct nrf24l01_link *link, uint8_t index, uint8_t *data, uint8_t size,
+                       uint8_t *ack, uint8_t *ack_size)
+{
+    struct nrf24l01_link_peer *peer;
+    uint8_t retransmits;
+    int result;
+    int status;
+
+    if (index >= link->count)
+        return -EINVAL;
+
+    peer = &link->peers[index];
+
+    if (link->current != index)
+    {
+        status = nrf24l01_link_apply(link, index);
+        if (status)
+            return status;
+    }
+
+    result = nrf24l01_transfer(link->device, data, size, ack, ack_size);
+    if (result && (result != -ETIMEDOUT))
+        return result;
+
+    // ARC_CNT holds retransmits of last payload until next one is sent.
+    status = nrf24l01_get_observe_tx(link->device, 0, &retransmits);
+    if (status)
+        return status;
+
+    uint32_t attempt = nrf24l01_link_packet_time(peer->rate, size)
+                       + (nrf24l01_link_delay(link, peer->rate) + 1) * 250;
+
+    peer->window_sent++;
+    peer->window_retransmits += retransmits;
+    if (retransmits > peer->window_peak)
+        peer->window_peak = retransmits;
+    peer->window_airtime += (retransmits + 1) * attempt;
+    peer->stats.sent++;
+    peer->stats.retransmits += retransmits;
+
+    if (result)
+    {
+        peer->window_lost++;
+        peer->stats.lost++;
+    }
+    else
+    {
+        peer->window_bytes += size;
+    }
+
+    if ((peer->window_sent >= NRF24L01_LINK_WINDOW) && nrf24l01_link_tune(peer))
+    {
+        status = nrf24l01_link_apply(link, index);
+        if (status)
+            return status;
+    }
+
+    return result;
+}
+
+int nrf24l01_link_scan(struct nrf24l01_link *link, uint8_t first, uint8_t last, uint8_t samples, uint8_t *busy)
+{
+    struct nrf24l01 *device = link->device;
+    uint8_t detected = 0;
+    int restore;
+    int status = 0;
+
+    if ((first > last) || (last > 127))
+        return -EINVAL;
+
+    for (uint8_t channel = first; !status && (channel <= last); channel++)
+    {
+        busy[channel - first] = 0;
+
+        status = nrf24l01_set_channel(device, channel);
+
+        for (uint8_t i = 0; !status && (i < samples); i++)
+        {
+            // Carrier is latched after 170 us in RX mode and reset in standby.
+            status = nrf24l01_enter_rx(device);
+            if (status)
+                break;
+
+            delay_us(170);
+
+            status = nrf24l01_get_carrier(device, &detected);
+            nrf24l01_enter_standby(device);
+
+            busy[channel - first] += detected;
+        }
+    }
+
+    nrf24l01_enter_standby(device);
+
+    restore = nrf24l01_set_channel(device, link->channel);
+    return status ? status : restore;
+}
+
+int nrf24l01_link_select_channel(struct nrf24l01_link *link, uint8_t first, uint8_t last, uint8_t samples)
+{
+    uint8_t busy[128];
+    uint8_t best;
+    int status;
+
+    status = nrf24l01_link_scan(link, first, last, samples, busy);
+    if (status)
+        return status;
+
+    best = ((link->channel >= first) && (link->channel <= last)) ? link->channel : first;
+
+    for (uint8_t channel = first; channel <= last; channel++)
+        if (busy[channel - first] < busy[best - first])
+            best = channel;
+
+    if (best == link->channel)
+        return 0;
+
+    status = nrf24l01_set_channel(link->device, best);
+    if (status)
+        return status;
+
+    link->channel = best;
+    return 0;
+}
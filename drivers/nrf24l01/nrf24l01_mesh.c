@@ -0,0 +1,431 @@
+#include "bm/nrf24l01_mesh.h"
+#include "bm/nrf24l01.h"
+#include "bm/delay.h"
+#include <string.h>
+#include <errno.h>
+
+#define NRF24L01_MESH_QUEUE_MASK (NRF24L01_MESH_QUEUE_SIZE - 1)
+#define NRF24L01_MESH_ROUTE_ENTRIES (NRF24L01_MESH_PAYLOAD / sizeof(struct nrf24l01_mesh_route_entry))
+
+static struct nrf24l01_mesh_route *nrf24l01_mesh_find(struct nrf24l01_mesh *mesh, uint8_t dst)
+{
+    for (int i = 0; i < NRF24L01_MESH_ROUTES; i++)
+        if (mesh->routes[i].dst == dst)
+            return &mesh->routes[i];
+
+    return 0;
+}
+
+//! Set route, new route takes free entry or the one with worst metric.
+static void nrf24l01_mesh_set_route(struct nrf24l01_mesh *mesh, uint8_t dst, uint8_t next, uint8_t metric,
+                                    uint64_t now)
+{
+    struct nrf24l01_mesh_route *route = nrf24l01_mesh_find(mesh, dst);
+
+    if (!route)
+    {
+        route = &mesh->routes[0];
+
+        for (int i = 1; (i < NRF24L01_MESH_ROUTES) && route->dst; i++)
+            if (!mesh->routes[i].dst || (mesh->routes[i].metric > route->metric))
+                route = &mesh->routes[i];
+
+        if (route->dst && (route->metric <= metric))
+            return;
+
+        route->dst = dst;
+    }
+
+    route->next = next;
+    route->metric = metric;
+    route->stamp = now;
+}
+
+//! Neighbor doesn't answer, routes through it are broken.
+static void nrf24l01_mesh_break(struct nrf24l01_mesh *mesh, uint8_t next, uint64_t now)
+{
+    for (int i = 0; i < NRF24L01_MESH_ROUTES; i++)
+    {
+        struct nrf24l01_mesh_route *route = &mesh->routes[i];
+
+        if (route->dst && (route->next == next) && (route->metric < NRF24L01_MESH_INFINITY))
+        {
+            route->metric = NRF24L01_MESH_INFINITY;
+            route->stamp = now;
+        }
+    }
+}
+
+//! Broken routes are advertised until timeout, so neighbors drop them early.
+static void nrf24l01_mesh_expire(struct nrf24l01_mesh *mesh, uint64_t now)
+{
+    for (int i = 0; i < NRF24L01_MESH_ROUTES; i++)
+    {
+        struct nrf24l01_mesh_route *route = &mesh->routes[i];
+
+        if (!route->dst || (route->stamp + NRF24L01_MESH_ROUTE_TIMEOUT > now))
+            continue;
+
+        if (route->metric < NRF24L01_MESH_INFINITY)
+        {
+            route->metric = NRF24L01_MESH_INFINITY;
+            route->stamp = now;
+        }
+        else
+        {
+            route->dst = 0;
+        }
+    }
+}
+
+//! Returns 1 if message was seen within NRF24L01_MESH_HISTORY_TIMEOUT.
+static int nrf24l01_mesh_duplicate(struct nrf24l01_mesh *mesh, uint8_t src, uint8_t seq, uint64_t now)
+{
+    uint16_t key = ((uint16_t)src << 8) | seq;
+
+    for (int i = 0; i < NRF24L01_MESH_HISTORY; i++)
+    {
+        struct nrf24l01_mesh_history *entry = &mesh->history[i];
+
+        if (entry->key != key)
+            continue;
+
+        // Restarted node reuses sequence numbers.
+        if (entry->stamp + NRF24L01_MESH_HISTORY_TIMEOUT <= now)
+        {
+            entry->key = 0xFFFF;
+            continue;
+        }
+
+        return 1;
+    }
+
+    mesh->history[mesh->history_pos].key = key;
+    mesh->history[mesh->history_pos].stamp = now;
+    mesh->history_pos = (mesh->history_pos + 1) % NRF24L01_MESH_HISTORY;
+    return 0;
+}
+
+static int nrf24l01_mesh_queue(struct nrf24l01_mesh *mesh, const uint8_t *packet, uint8_t size, uint64_t stamp)
+{
+    uint8_t head = mesh->tx_head;
+
+    if ((uint8_t)(head - mesh->tx_tail) >= NRF24L01_MESH_QUEUE_SIZE)
+        return -ENOBUFS;
+
+    struct nrf24l01_mesh_entry *entry = &mesh->tx[head & NRF24L01_MESH_QUEUE_MASK];
+
+    entry->stamp = stamp;
+    entry->tries = 0;
+    entry->size = size;
+    memcpy(entry->data, packet, size);
+
+    mesh->tx_head = head + 1;
+    return 0;
+}
+
+static void nrf24l01_mesh_input_route(struct nrf24l01_mesh *mesh, struct nrf24l01_frame *frame, uint64_t now)
+{
+    struct nrf24l01_mesh_header *header = (struct nrf24l01_mesh_header *)frame->data;
+    uint8_t count = (frame->size - NRF24L01_MESH_HEADER_SIZE) / sizeof(struct nrf24l01_mesh_route_entry);
+    uint8_t neighbor = header->src;
+
+    if ((neighbor == 0) || (neighbor == NRF24L01_MESH_BROADCAST) || (neighbor == mesh->id))
+        return;
+
+    nrf24l01_mesh_set_route(mesh, neighbor, neighbor, 1, now);
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        struct nrf24l01_mesh_route_entry *entry = (struct nrf24l01_mesh_route_entry *)
+            (frame->data + NRF24L01_MESH_HEADER_SIZE + i * sizeof(struct nrf24l01_mesh_route_entry));
+
+        // Split horizon, route through this node is of no use.
+        if ((entry->dst == 0) || (entry->dst == mesh->id) || (entry->dst == neighbor) || (entry->next == mesh->id))
+            continue;
+
+        uint8_t metric = (entry->metric >= NRF24L01_MESH_INFINITY - 1) ? NRF24L01_MESH_INFINITY : entry->metric + 1;
+        struct nrf24l01_mesh_route *route = nrf24l01_mesh_find(mesh, entry->dst);
+
+        if (route && (route->next == neighbor))
+        {
+            // Current next hop is trusted, even if route got worse.
+            if ((metric < NRF24L01_MESH_INFINITY) || (route->metric < NRF24L01_MESH_INFINITY))
+            {
+                route->metric = metric;
+                route->stamp = now;
+            }
+        }
+        else if ((metric < NRF24L01_MESH_INFINITY) && (!route || (metric < route->metric)))
+        {
+            nrf24l01_mesh_set_route(mesh, entry->dst, neighbor, metric, now);
+        }
+    }
+}
+
+static void nrf24l01_mesh_input_data(struct nrf24l01_mesh *mesh, struct nrf24l01_frame *frame, uint64_t now)
+{
+    struct nrf24l01_mesh_header *header = (struct nrf24l01_mesh_header *)frame->data;
+    uint16_t age = header->age[0] | (header->age[1] << 8);
+
+    // Duplicate of older packet may come after its message has expired from history.
+    if (age >= NRF24L01_MESH_HISTORY_TIMEOUT)
+    {
+        mesh->stats.dropped++;
+        return;
+    }
+
+    if (nrf24l01_mesh_duplicate(mesh, header->src, header->seq, now))
+    {
+        mesh->stats.duplicates++;
+        return;
+    }
+
+    if (header->dst != mesh->id)
+    {
+        header->ttl--;
+
+        if ((header->ttl == 0) || nrf24l01_mesh_queue(mesh, frame->data, frame->size, now))
+            mesh->stats.dropped++;
+
+        return;
+    }
+
+    uint8_t head = mesh->rx_head;
+
+    if ((uint8_t)(head - mesh->rx_tail) >= NRF24L01_MESH_QUEUE_SIZE)
+    {
+        mesh->stats.dropped++;
+        return;
+    }
+
+    struct nrf24l01_mesh_message *message = &mesh->rx[head & NRF24L01_MESH_QUEUE_MASK];
+
+    message->src = header->src;
+    message->hops = NRF24L01_MESH_TTL - header->ttl + 1;
+    message->latency = age;
+    message->size = frame->size - NRF24L01_MESH_HEADER_SIZE;
+    memcpy(message->data, frame->data + NRF24L01_MESH_HEADER_SIZE, message->size);
+
+    mesh->stats.delivered++;
+    mesh->stats.latency_total += message->latency;
+    if (message->latency > mesh->stats.latency_max)
+        mesh->stats.latency_max = message->latency;
+
+    mesh->rx_head = head + 1;
+}
+
+static int nrf24l01_mesh_advertise(struct nrf24l01_mesh *mesh)
+{
+    struct nrf24l01_mesh_header *header;
+    struct nrf24l01_mesh_route_entry *entries;
+    uint8_t packet[32];
+    uint8_t count = 0;
+    uint8_t sent = 0;
+    int status;
+
+    header = (struct nrf24l01_mesh_header *)packet;
+    header->type = NRF24L01_MESH_TYPE_ROUTE;
+    header->ttl = 1;
+    header->src = mesh->id;
+    header->dst = NRF24L01_MESH_BROADCAST;
+    header->seq = 0;
+    header->age[0] = 0;
+    header->age[1] = 0;
+
+    entries = (struct nrf24l01_mesh_route_entry *)(packet + NRF24L01_MESH_HEADER_SIZE);
+
+    for (int i = 0; i < NRF24L01_MESH_ROUTES; i++)
+    {
+        struct nrf24l01_mesh_route *route = &mesh->routes[i];
+
+        if (!route->dst)
+            continue;
+
+        entries[count].dst = route->dst;
+        entries[count].metric = route->metric;
+        entries[count].next = route->next;
+
+        if (++count < NRF24L01_MESH_ROUTE_ENTRIES)
+            continue;
+
+        status = mesh->radio->send(mesh->context, NRF24L01_MESH_BROADCAST, packet,
+                                   NRF24L01_MESH_HEADER_SIZE + count * sizeof(struct nrf24l01_mesh_route_entry));
+        if (status)
+            return status;
+
+        count = 0;
+        sent = 1;
+    }
+
+    // Empty advertisement still announces node to neighbors.
+    if (!count && sent)
+        return 0;
+
+    return mesh->radio->send(mesh->context, NRF24L01_MESH_BROADCAST, packet,
+                             NRF24L01_MESH_HEADER_SIZE + count * sizeof(struct nrf24l01_mesh_route_entry));
+}
+
+//! Send queued packets until queue is empty or next hop doesn't answer.
+static int nrf24l01_mesh_transmit(struct nrf24l01_mesh *mesh)
+{
+    int status;
+
+    while (mesh->tx_head != mesh->tx_tail)
+    {
+        struct nrf24l01_mesh_entry *entry = &mesh->tx[mesh->tx_tail & NRF24L01_MESH_QUEUE_MASK];
+        struct nrf24l01_mesh_header *header = (struct nrf24l01_mesh_header *)entry->data;
+        struct nrf24l01_mesh_route *route = nrf24l01_mesh_find(mesh, header->dst);
+
+        if (!route || (route->metric >= NRF24L01_MESH_INFINITY))
+        {
+            mesh->stats.unreachable++;
+            mesh->tx_tail++;
+            continue;
+        }
+
+        // Age includes time spent in this queue.
+        uint64_t now = get_tick_count();
+        uint32_t age = (header->age[0] | (header->age[1] << 8)) + (uint32_t)(now - entry->stamp);
+        if (age > 0xFFFF)
+            age = 0xFFFF;
+
+        header->age[0] = age;
+        header->age[1] = age >> 8;
+
+        status = mesh->radio->send(mesh->context, route->next, entry->data, entry->size);
+        if (status && (status != -ETIMEDOUT))
+            return status;
+
+        if (!status)
+        {
+            mesh->stats.forwarded++;
+            mesh->tx_tail++;
+            continue;
+        }
+
+        // Age of next attempt starts now.
+        entry->stamp = get_tick_count();
+
+        if (++entry->tries >= NRF24L01_MESH_RETRIES)
+        {
+            mesh->stats.lost++;
+            mesh->tx_tail++;
+            nrf24l01_mesh_break(mesh, route->next, entry->stamp);
+            continue;
+        }
+
+        break;
+    }
+
+    return 0;
+}
+
+int nrf24l01_mesh_init_radio(struct nrf24l01_mesh *mesh, const struct nrf24l01_mesh_radio *radio, void *context,
+                             uint8_t id)
+{
+    if ((id == 0) || (id == NRF24L01_MESH_BROADCAST))
+        return -EINVAL;
+
+    memset(mesh, 0, sizeof(*mesh));
+    mesh->radio = radio;
+    mesh->context = context;
+    mesh->id = id;
+    mesh->next_advert = get_tick_count();
+
+    for (int i = 0; i < NRF24L01_MESH_HISTORY; i++)
+        mesh->history[i].key = 0xFFFF;
+
+    return 0;
+}
+
+int nrf24l01_mesh_send(struct nrf24l01_mesh *mesh, uint8_t dst, const uint8_t *data, uint8_t size)
+{
+    struct nrf24l01_mesh_route *route = nrf24l01_mesh_find(mesh, dst);
+    uint8_t packet[32];
+    struct nrf24l01_mesh_header *header = (struct nrf24l01_mesh_header *)packet;
+
+    if (size > NRF24L01_MESH_PAYLOAD)
+        return -EINVAL;
+
+    if (!route || (route->metric >= NRF24L01_MESH_INFINITY))
+        return -EHOSTUNREACH;
+
+    header->type = NRF24L01_MESH_TYPE_DATA;
+    header->ttl = NRF24L01_MESH_TTL;
+    header->src = mesh->id;
+    header->dst = dst;
+    header->seq = mesh->seq;
+    header->age[0] = 0;
+    header->age[1] = 0;
+    memcpy(packet + NRF24L01_MESH_HEADER_SIZE, data, size);
+
+    int status = nrf24l01_mesh_queue(mesh, packet, NRF24L01_MESH_HEADER_SIZE + size, get_tick_count());
+    if (status)
+        return status;
+
+    // Own messages, which come back over loop, are dropped as duplicates.
+    nrf24l01_mesh_duplicate(mesh, mesh->id, mesh->seq, get_tick_count());
+    mesh->seq++;
+    return 0;
+}
+
+int nrf24l01_mesh_poll(struct nrf24l01_mesh *mesh)
+{
+    struct nrf24l01_frame frame;
+    uint64_t now = get_tick_count();
+    int status;
+
+    for (;;)
+    {
+        status = mesh->radio->receive(mesh->context, &frame);
+        if (status == -EAGAIN)
+            break;
+
+        if (status)
+            return status;
+
+        struct nrf24l01_mesh_header *header = (struct nrf24l01_mesh_header *)frame.data;
+
+        if (frame.size < NRF24L01_MESH_HEADER_SIZE)
+            continue;
+
+        if ((frame.pipe == 2) && (header->type == NRF24L01_MESH_TYPE_ROUTE))
+            nrf24l01_mesh_input_route(mesh, &frame, now);
+        else if ((frame.pipe != 2) && (header->type == NRF24L01_MESH_TYPE_DATA))
+            nrf24l01_mesh_input_data(mesh, &frame, now);
+    }
+
+    nrf24l01_mesh_expire(mesh, now);
+
+    if ((now < mesh->next_advert) && (mesh->tx_head == mesh->tx_tail))
+        return 0;
+
+    if (now >= mesh->next_advert)
+    {
+        mesh->next_advert = now + NRF24L01_MESH_ADVERT_INTERVAL;
+
+        status = nrf24l01_mesh_advertise(mesh);
+        if (status)
+            return status;
+    }
+
+    status = nrf24l01_mesh_transmit(mesh);
+    if (status)
+        return status;
+
+    return mesh->radio->listen(mesh->context);
+}
+
+int nrf24l01_mesh_receive(struct nrf24l01_mesh *mesh, struct nrf24l01_mesh_message *message)
+{
+    uint8_t tail = mesh->rx_tail;
+
+    if (mesh->rx_head == tail)
+        return -EAGAIN;
+
+    *message = mesh->rx[tail & NRF24L01_MESH_QUEUE_MASK];
+    mesh->rx_tail = tail + 1;
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "bm/nrf24l01_mesh.h"
+#include "bm/nrf24l01.h"
+#include <string.h>
+#include <errno.h>
+
+static int nrf24l01_mesh_device_receive(void *context, struct nrf24l01_frame *frame)
+{
+    struct nrf24l01_mesh *mesh = context;
+
+    return nrf24l01_read_frame(mesh->device, frame);
+}
+
+static int nrf24l01_mesh_device_send(void *context, uint8_t dst, uint8_t *packet, uint8_t size)
+{
+    struct nrf24l01_mesh *mesh = context;
+    uint8_t ack[32];
+    uint8_t ack_size;
+    uint8_t addr[5];
+    int status;
+
+    nrf24l01_enter_standby(mesh->device);
+
+    addr[0] = dst;
+    memcpy(addr + 1, mesh->base, 4);
+
+    status = nrf24l01_set_tx_address(mesh->device, addr);
+    if (status)
+        return status;
+
+    if (dst == NRF24L01_MESH_BROADCAST)
+        return nrf24l01_send_no_ack(mesh->device, packet, size);
+
+    status = nrf24l01_set_rx_address(mesh->device, 0, addr);
+    if (status)
+        return status;
+
+    return nrf24l01_transfer(mesh->device, packet, size, ack, &ack_size);
+}
+
+static int nrf24l01_mesh_device_listen(void *context)
+{
+    struct nrf24l01_mesh *mesh = context;
+    uint8_t addr[5];
+    int status;
+
+    // Pipe 0 got next hop address for ACK, it would take packets of that node in RX mode.
+    addr[0] = mesh->id;
+    memcpy(addr + 1, mesh->base, 4);
+
+    status = nrf24l01_set_rx_address(mesh->device, 0, addr);
+    if (status)
+        return status;
+
+    return nrf24l01_enter_rx(mesh->device);
+}
+
+static const struct nrf24l01_mesh_radio nrf24l01_mesh_device_radio =
+{
+    nrf24l01_mesh_device_receive,
+    nrf24l01_mesh_device_send,
+    nrf24l01_mesh_device_listen,
+};
+
+int nrf24l01_mesh_init(struct nrf24l01_mesh *mesh, struct nrf24l01 *device, uint8_t id, const uint8_t base[4])
+{
+    uint8_t addr[5];
+    int status;
+
+    if (device->rx_ring)
+        return -EBUSY;
+
+    status = nrf24l01_mesh_init_radio(mesh, &nrf24l01_mesh_device_radio, mesh, id);
+    if (status)
+        return status;
+
+    mesh->device = device;
+    memcpy(mesh->base, base, 4);
+
+    addr[0] = id;
+    memcpy(addr + 1, base, 4);
+
+    status = nrf24l01_set_rx_address(device, 1, addr);
+    if (status)
+        return status;
+
+    addr[0] = NRF24L01_MESH_BROADCAST;
+
+    status = nrf24l01_set_rx_address(device, 2, addr);
+    if (status)
+        return status;
+
+    status = nrf24l01_enable_pipes(device, 0x07);
+    if (status)
+        return status;
+
+    status = nrf24l01_enable_dynamic_size(device);
+    if (status)
+        return status;
+
+    status = nrf24l01_enable_dynamic_pipe_size(device, 0x07);
+    if (status)
+        return status;
+
+    status = nrf24l01_enable_dynamic_ack(device);
+    if (status)
+        return status;
+
+    return mesh->radio->listen(mesh->context);
+}
+
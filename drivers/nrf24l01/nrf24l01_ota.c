@@ -0,0 +1,674 @@
+#include "bm/nrf24l01_ota.h"
+#include "bm/nrf24l01.h"
+#include "bm/sst25.h"
+#include "bm/crc.h"
+#include "bm/delay.h"
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+
+#define NRF24L01_OTA_BITMAP_SIZE (SST25_SECTOR_SIZE - sizeof(struct nrf24l01_ota_header))
+#define NRF24L01_OTA_START_SIZE 9
+#define NRF24L01_OTA_POLL_SIZE 2
+
+static uint32_t nrf24l01_ota_get32(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static void nrf24l01_ota_put32(uint8_t *data, uint32_t value)
+{
+    data[0] = value;
+    data[1] = value >> 8;
+    data[2] = value >> 16;
+    data[3] = value >> 24;
+}
+
+//! Size of block in image of given size.
+static uint16_t nrf24l01_ota_block_size(uint32_t size, uint16_t block)
+{
+    uint32_t left = size - (uint32_t)block * NRF24L01_OTA_BLOCK_SIZE;
+    return (left > NRF24L01_OTA_BLOCK_SIZE) ? NRF24L01_OTA_BLOCK_SIZE : left;
+}
+
+//! Map with all chunks of block of given size.
+static uint32_t nrf24l01_ota_full_map(uint16_t size)
+{
+    return (1UL << ((size + NRF24L01_OTA_CHUNK - 1) / NRF24L01_OTA_CHUNK)) - 1;
+}
+
+static uint32_t nrf24l01_ota_header_addr(struct nrf24l01_ota *ota)
+{
+    return (uint32_t)ota->first_sector * SST25_SECTOR_SIZE;
+}
+
+static uint32_t nrf24l01_ota_image_addr(struct nrf24l01_ota *ota, uint32_t offset)
+{
+    return (uint32_t)(ota->first_sector + 1) * SST25_SECTOR_SIZE + offset;
+}
+
+//! Largest image, which fits both in flash area and in block bitmap.
+static uint32_t nrf24l01_ota_capacity(struct nrf24l01_ota *ota)
+{
+    uint32_t area = (uint32_t)(ota->sector_count - 1) * SST25_SECTOR_SIZE;
+    uint32_t bitmap = (uint32_t)NRF24L01_OTA_BITMAP_SIZE * 8 * NRF24L01_OTA_BLOCK_SIZE;
+
+    if (bitmap > 0xFFFFUL * NRF24L01_OTA_BLOCK_SIZE)
+        bitmap = 0xFFFFUL * NRF24L01_OTA_BLOCK_SIZE;
+
+    return (area < bitmap) ? area : bitmap;
+}
+
+//! Image sectors, which must be erased before block is programmed.
+static uint16_t nrf24l01_ota_sectors(struct nrf24l01_ota *ota, uint16_t block)
+{
+    uint32_t end = (uint32_t)block * NRF24L01_OTA_BLOCK_SIZE + nrf24l01_ota_block_size(ota->size, block);
+    return (end + SST25_SECTOR_SIZE - 1) / SST25_SECTOR_SIZE;
+}
+
+static void nrf24l01_ota_reset(struct nrf24l01_ota *ota)
+{
+    ota->received = 0;
+    ota->programmed = 0;
+    ota->erased = 0;
+    ota->verify_pos = 0;
+    ota->verify_crc = CRC32_INIT;
+
+    for (uint8_t i = 0; i < NRF24L01_OTA_BUFFERS; i++)
+    {
+        ota->buffers[i].map = 0;
+        memset(ota->buffers[i].data, 0xFF, NRF24L01_OTA_BLOCK_SIZE);
+    }
+}
+
+//! Wait for flash operation in progress and terminate AAI sequence.
+static int nrf24l01_ota_flash_idle(struct nrf24l01_ota *ota)
+{
+    int status;
+
+    if (ota->busy)
+    {
+        status = sst25_wait_for_ready(ota->flash, SST25_TIMEOUT_SECTOR_ERASE);
+        if (status)
+            return status;
+
+        ota->busy = 0;
+        if (ota->erasing)
+        {
+            ota->erasing = 0;
+            ota->erased++;
+        }
+    }
+
+    if (ota->aai)
+    {
+        ota->aai = 0;
+        ota->program_pos = 0;
+        return sst25_aai_end(ota->flash);
+    }
+
+    return 0;
+}
+
+int nrf24l01_ota_init(struct nrf24l01_ota *ota, struct nrf24l01 *device, struct sst25 *flash,
+                      uint16_t first_sector, uint16_t sector_count)
+{
+    struct nrf24l01_ota_header header;
+    int status;
+
+    if (sector_count < 2)
+        return -EINVAL;
+
+    memset(ota, 0, sizeof(*ota));
+    ota->device = device;
+    ota->flash = flash;
+    ota->first_sector = first_sector;
+    ota->sector_count = sector_count;
+    ota->state = NRF24L01_OTA_IDLE;
+    nrf24l01_ota_reset(ota);
+
+    status = sst25_read_data(flash, nrf24l01_ota_header_addr(ota), (uint8_t *)&header, sizeof(header));
+    if (status)
+        return status;
+
+    if ((header.magic != NRF24L01_OTA_MAGIC) ||
+            (header.header_crc != crc16_ccitt(CRC16_CCITT_INIT, &header, offsetof(struct nrf24l01_ota_header, header_crc))) ||
+            (header.size == 0) || (header.size > nrf24l01_ota_capacity(ota)))
+        return 0;
+
+    ota->size = header.size;
+    ota->crc = header.crc;
+    ota->blocks = (header.size + NRF24L01_OTA_BLOCK_SIZE - 1) / NRF24L01_OTA_BLOCK_SIZE;
+
+    if (header.verified == 0)
+    {
+        ota->state = NRF24L01_OTA_DONE;
+        ota->received = ota->blocks;
+        ota->programmed = ota->blocks;
+        ota->verify_pos = ota->size;
+        return 0;
+    }
+
+    // Blocks are marked in order, bits of each bitmap byte are cleared from LSB.
+    uint8_t *bitmap = ota->buffers[0].data;
+    uint16_t bytes = (ota->blocks + 7) / 8;
+
+    for (uint16_t offset = 0; offset < bytes; offset += NRF24L01_OTA_BLOCK_SIZE)
+    {
+        uint16_t count = (bytes - offset > NRF24L01_OTA_BLOCK_SIZE) ? NRF24L01_OTA_BLOCK_SIZE : bytes - offset;
+        uint16_t i;
+
+        status = sst25_read_data(flash, nrf24l01_ota_header_addr(ota) + sizeof(header) + offset, bitmap, count);
+        if (status)
+            return status;
+
+        for (i = 0; (i < count) && (bitmap[i] == 0); i++)
+            ota->programmed += 8;
+
+        if (i < count)
+        {
+            for (uint8_t mask = bitmap[i]; !(mask & 1); mask >>= 1)
+                ota->programmed++;
+            break;
+        }
+    }
+
+    memset(bitmap, 0xFF, NRF24L01_OTA_BLOCK_SIZE);
+
+    if (ota->programmed > ota->blocks)
+        ota->programmed = ota->blocks;
+
+    /*
+     * Sector of next block was erased if it holds programmed blocks. Interrupted block
+     * is programmed again with the same data, which doesn't change programmed bits.
+     */
+    ota->received = ota->programmed;
+    ota->erased = ((uint32_t)ota->programmed * NRF24L01_OTA_BLOCK_SIZE + SST25_SECTOR_SIZE - 1) / SST25_SECTOR_SIZE;
+    ota->state = NRF24L01_OTA_RECEIVING;
+
+    return 0;
+}
+
+static int nrf24l01_ota_start(struct nrf24l01_ota *ota, const uint8_t *data, uint8_t size)
+{
+    struct nrf24l01_ota_header header;
+    int status;
+
+    if (size != NRF24L01_OTA_START_SIZE)
+    {
+        ota->stats.rejected++;
+        return 0;
+    }
+
+    uint32_t image_size = nrf24l01_ota_get32(data + 1);
+    uint32_t image_crc = nrf24l01_ota_get32(data + 5);
+
+    // Same image is resumed.
+    if (((ota->state == NRF24L01_OTA_RECEIVING) || (ota->state == NRF24L01_OTA_DONE)) &&
+            (image_size == ota->size) && (image_crc == ota->crc))
+        return 0;
+
+    status = nrf24l01_ota_flash_idle(ota);
+    if (status)
+        return status;
+
+    ota->size = image_size;
+    ota->crc = image_crc;
+    ota->blocks = (image_size + NRF24L01_OTA_BLOCK_SIZE - 1) / NRF24L01_OTA_BLOCK_SIZE;
+    nrf24l01_ota_reset(ota);
+
+    if ((image_size == 0) || (image_size > nrf24l01_ota_capacity(ota)))
+    {
+        ota->state = NRF24L01_OTA_FAILED;
+        return 0;
+    }
+
+    status = sst25_erase(ota->flash, ota->first_sector, SST25_ERASE_4K);
+    if (status)
+        return status;
+
+    header.magic = NRF24L01_OTA_MAGIC;
+    header.size = image_size;
+    header.crc = image_crc;
+    header.header_crc = crc16_ccitt(CRC16_CCITT_INIT, &header, offsetof(struct nrf24l01_ota_header, header_crc));
+    header.verified = 0xFFFF;
+
+    status = sst25_write_data(ota->flash, nrf24l01_ota_header_addr(ota), (uint8_t *)&header, sizeof(header));
+    if (status)
+        return status;
+
+    ota->state = NRF24L01_OTA_RECEIVING;
+    return 0;
+}
+
+static void nrf24l01_ota_data(struct nrf24l01_ota *ota, const uint8_t *data, uint8_t size)
+{
+    const struct nrf24l01_ota_data_header *header = (const struct nrf24l01_ota_data_header *)data;
+
+    if ((ota->state != NRF24L01_OTA_RECEIVING) || (size <= NRF24L01_OTA_DATA_HEADER_SIZE))
+    {
+        ota->stats.rejected++;
+        return;
+    }
+
+    uint16_t block = header->block[0] | (header->block[1] << 8);
+
+    if (block < ota->received)
+    {
+        ota->stats.duplicates++;
+        return;
+    }
+
+    if ((block >= ota->blocks) || (block >= ota->programmed + NRF24L01_OTA_BUFFERS))
+    {
+        ota->stats.rejected++;
+        return;
+    }
+
+    uint16_t block_size = nrf24l01_ota_block_size(ota->size, block);
+    uint16_t offset = header->chunk * NRF24L01_OTA_CHUNK;
+
+    if ((offset >= block_size) || (size - NRF24L01_OTA_DATA_HEADER_SIZE !=
+            ((block_size - offset > NRF24L01_OTA_CHUNK) ? NRF24L01_OTA_CHUNK : block_size - offset)))
+    {
+        ota->stats.rejected++;
+        return;
+    }
+
+    struct nrf24l01_ota_buffer *buffer = &ota->buffers[block % NRF24L01_OTA_BUFFERS];
+    uint32_t bit = 1UL << header->chunk;
+
+    if (buffer->map & bit)
+    {
+        ota->stats.duplicates++;
+        return;
+    }
+
+    memcpy(buffer->data + offset, data + NRF24L01_OTA_DATA_HEADER_SIZE, size - NRF24L01_OTA_DATA_HEADER_SIZE);
+    buffer->map |= bit;
+    ota->stats.chunks++;
+
+    while ((ota->received < ota->blocks) && (ota->received < ota->programmed + NRF24L01_OTA_BUFFERS) &&
+            (ota->buffers[ota->received % NRF24L01_OTA_BUFFERS].map ==
+             nrf24l01_ota_full_map(nrf24l01_ota_block_size(ota->size, ota->received))))
+        ota->received++;
+}
+
+//! Received chunks of block, 0 if block isn't buffered.
+static uint32_t nrf24l01_ota_block_map(struct nrf24l01_ota *ota, uint16_t block)
+{
+    if ((block >= ota->blocks) || (block >= ota->programmed + NRF24L01_OTA_BUFFERS))
+        return 0;
+
+    return ota->buffers[block % NRF24L01_OTA_BUFFERS].map;
+}
+
+static int nrf24l01_ota_poll_status(struct nrf24l01_ota *ota, uint8_t pipe, const uint8_t *data, uint8_t size)
+{
+    struct nrf24l01_ota_status status;
+    int ret;
+
+    if (size != NRF24L01_OTA_POLL_SIZE)
+    {
+        ota->stats.rejected++;
+        return 0;
+    }
+
+    status.type = NRF24L01_OTA_TYPE_STATUS;
+    status.token = data[1];
+    status.state = ota->state;
+    status.window = 0;
+    status.next[0] = ota->received;
+    status.next[1] = ota->received >> 8;
+
+    if (ota->state == NRF24L01_OTA_RECEIVING)
+    {
+        uint16_t end = ota->programmed + NRF24L01_OTA_BUFFERS;
+
+        if (end > ota->blocks)
+            end = ota->blocks;
+
+        status.window = end - ota->received;
+    }
+
+    nrf24l01_ota_put32(status.map[0], nrf24l01_ota_block_map(ota, ota->received));
+    nrf24l01_ota_put32(status.map[1], nrf24l01_ota_block_map(ota, ota->received + 1));
+
+    ota->stats.polls++;
+
+    // Status goes with ACK of next packet, stale one is dropped.
+    ret = nrf24l01_flush_tx(ota->device);
+    if (ret)
+        return ret;
+
+    return nrf24l01_write_ack_payload(ota->device, pipe, sizeof(status), (uint8_t *)&status);
+}
+
+//! Check next part of programmed image.
+static int nrf24l01_ota_verify(struct nrf24l01_ota *ota)
+{
+    uint8_t *buffer = ota->buffers[0].data;
+    uint32_t size = ota->size - ota->verify_pos;
+    int status;
+
+    if (size > NRF24L01_OTA_BLOCK_SIZE)
+        size = NRF24L01_OTA_BLOCK_SIZE;
+
+    status = sst25_read_data(ota->flash, nrf24l01_ota_image_addr(ota, ota->verify_pos), buffer, size);
+    if (status)
+        return status;
+
+    ota->verify_crc = crc32(ota->verify_crc, buffer, size);
+    ota->verify_pos += size;
+    memset(buffer, 0xFF, size);
+
+    if (ota->verify_pos < ota->size)
+        return 0;
+
+    uint32_t addr = nrf24l01_ota_header_addr(ota);
+    uint8_t zero[4] = {0, 0, 0, 0};
+
+    if (ota->verify_crc != ota->crc)
+    {
+        // Header is invalidated, so image is received from start next time.
+        ota->state = NRF24L01_OTA_FAILED;
+        return sst25_write_data(ota->flash, addr + offsetof(struct nrf24l01_ota_header, magic), zero, 4);
+    }
+
+    ota->state = NRF24L01_OTA_DONE;
+    return sst25_write_data(ota->flash, addr + offsetof(struct nrf24l01_ota_header, verified), zero, 2);
+}
+
+/*! Start next flash operation if flash is ready.
+ * \returns 1 if operation was started, 0 if flash is busy or there is nothing to do,
+ *          negative error code otherwise.
+ */
+static int nrf24l01_ota_flash_step(struct nrf24l01_ota *ota)
+{
+    struct nrf24l01_ota_buffer *buffer = &ota->buffers[ota->programmed % NRF24L01_OTA_BUFFERS];
+    int status;
+
+    if (ota->busy)
+    {
+        uint8_t reg;
+
+        status = sst25_get_status(ota->flash, &reg);
+        if (status)
+            return status;
+
+        if (reg & SST25_STATUS_BUSY)
+            return 0;
+
+        ota->busy = 0;
+        if (ota->erasing)
+        {
+            ota->erasing = 0;
+            ota->erased++;
+        }
+    }
+
+    if (ota->aai)
+    {
+        // Odd size of last block is padded with 0xFF.
+        uint16_t size = (nrf24l01_ota_block_size(ota->size, ota->programmed) + 1) & ~1;
+
+        if (ota->program_pos < size)
+        {
+            status = sst25_aai_next(ota->flash, buffer->data + ota->program_pos);
+            if (status)
+                return status;
+
+            ota->program_pos += 2;
+            ota->busy = 1;
+            return 1;
+        }
+
+        ota->aai = 0;
+        ota->program_pos = 0;
+
+        status = sst25_aai_end(ota->flash);
+        if (status)
+            return status;
+
+        uint8_t mark = 0xFF << ((ota->programmed % 8) + 1);
+
+        status = sst25_write_data(ota->flash, nrf24l01_ota_header_addr(ota) + sizeof(struct nrf24l01_ota_header)
+                                  + ota->programmed / 8, &mark, 1);
+        if (status)
+            return status;
+
+        buffer->map = 0;
+        memset(buffer->data, 0xFF, NRF24L01_OTA_BLOCK_SIZE);
+        ota->programmed++;
+        return 1;
+    }
+
+    if (ota->state != NRF24L01_OTA_RECEIVING)
+        return 0;
+
+    if ((ota->programmed < ota->received) && (ota->erased >= nrf24l01_ota_sectors(ota, ota->programmed)))
+    {
+        status = sst25_aai_start(ota->flash, nrf24l01_ota_image_addr(ota, (uint32_t)ota->programmed * NRF24L01_OTA_BLOCK_SIZE),
+                                 buffer->data);
+        if (status)
+            return status;
+
+        ota->aai = 1;
+        ota->program_pos = 2;
+        ota->busy = 1;
+        return 1;
+    }
+
+    // Erase ahead, so that sectors are ready when blocks are received.
+    uint16_t sectors = (ota->size + SST25_SECTOR_SIZE - 1) / SST25_SECTOR_SIZE;
+    uint16_t target = (uint32_t)ota->programmed * NRF24L01_OTA_BLOCK_SIZE / SST25_SECTOR_SIZE + 1 + NRF24L01_OTA_ERASE_AHEAD;
+
+    if (target > sectors)
+        target = sectors;
+
+    if (ota->erased < target)
+    {
+        status = sst25_erase_start(ota->flash, ota->first_sector + 1 + ota->erased, SST25_ERASE_4K);
+        if (status)
+            return status;
+
+        ota->erasing = 1;
+        ota->busy = 1;
+        return 1;
+    }
+
+    if (ota->programmed == ota->blocks)
+    {
+        status = nrf24l01_ota_verify(ota);
+        return status ? status : 1;
+    }
+
+    return 0;
+}
+
+int nrf24l01_ota_poll(struct nrf24l01_ota *ota)
+{
+    struct nrf24l01_frame frame;
+    int work;
+    int status;
+
+    do
+    {
+        work = 0;
+
+        status = nrf24l01_read_frame(ota->device, &frame);
+        if (!status)
+        {
+            work = 1;
+
+            switch (frame.size ? frame.data[0] : 0)
+            {
+            case NRF24L01_OTA_TYPE_START:
+                status = nrf24l01_ota_start(ota, frame.data, frame.size);
+                break;
+            case NRF24L01_OTA_TYPE_DATA:
+                nrf24l01_ota_data(ota, frame.data, frame.size);
+                break;
+            case NRF24L01_OTA_TYPE_POLL:
+                status = nrf24l01_ota_poll_status(ota, frame.pipe, frame.data, frame.size);
+                break;
+            default:
+                ota->stats.rejected++;
+                break;
+            }
+
+            if (status)
+                return status;
+        }
+        else if (status != -EAGAIN)
+        {
+            return status;
+        }
+
+        status = nrf24l01_ota_flash_step(ota);
+        if (status < 0)
+            return status;
+
+        work |= status;
+    }
+    while (work);
+
+    return ota->state == NRF24L01_OTA_DONE;
+}
+
+/*! Get receiver status. First POLL makes receiver load status, which comes with ACK
+ * of next one.
+ */
+static int nrf24l01_ota_get_status(struct nrf24l01 *device, uint8_t token, struct nrf24l01_ota_status *status)
+{
+    uint8_t poll[NRF24L01_OTA_POLL_SIZE] = {NRF24L01_OTA_TYPE_POLL, token};
+    uint8_t ack[32];
+    uint8_t ack_size;
+    int ret;
+
+    for (uint8_t i = 0; i < NRF24L01_OTA_RETRIES; i++)
+    {
+        if (i)
+            delay_ms(NRF24L01_OTA_POLL_DELAY);
+
+        ret = nrf24l01_transfer(device, poll, sizeof(poll), ack, &ack_size);
+        if (ret && (ret != -ETIMEDOUT))
+            return ret;
+
+        if (!ret && (ack_size == sizeof(*status)) && (ack[0] == NRF24L01_OTA_TYPE_STATUS) && (ack[1] == token))
+        {
+            memcpy(status, ack, sizeof(*status));
+            return 0;
+        }
+    }
+
+    return -ETIMEDOUT;
+}
+
+int nrf24l01_ota_send(struct nrf24l01 *device, const uint8_t *image, uint32_t size)
+{
+    struct nrf24l01_ota_status status;
+    uint8_t packet[32];
+    uint8_t ack[32];
+    uint8_t ack_size;
+    uint8_t token = 0;
+    uint8_t started = 0;
+    uint16_t last_next = 0xFFFF;
+    uint64_t progress = get_tick_count();
+    int ret;
+
+    uint32_t blocks = (size + NRF24L01_OTA_BLOCK_SIZE - 1) / NRF24L01_OTA_BLOCK_SIZE;
+
+    if ((size == 0) || (blocks > 0xFFFF))
+        return -EINVAL;
+
+    for (;;)
+    {
+        // Receiver resumes image with the same size and CRC.
+        if (!started)
+        {
+            packet[0] = NRF24L01_OTA_TYPE_START;
+            nrf24l01_ota_put32(packet + 1, size);
+            nrf24l01_ota_put32(packet + 5, crc32(CRC32_INIT, image, size));
+
+            for (uint8_t i = 0; ; i++)
+            {
+                ret = nrf24l01_transfer(device, packet, NRF24L01_OTA_START_SIZE, ack, &ack_size);
+                if (!ret)
+                    break;
+
+                if ((ret != -ETIMEDOUT) || (i + 1 >= NRF24L01_OTA_RETRIES))
+                    return ret;
+
+                delay_ms(NRF24L01_OTA_POLL_DELAY);
+            }
+
+            started = 1;
+        }
+
+        ret = nrf24l01_ota_get_status(device, ++token, &status);
+        if (ret)
+            return ret;
+
+        if (status.state == NRF24L01_OTA_DONE)
+            return 0;
+
+        if (status.state == NRF24L01_OTA_FAILED)
+            return -EIO;
+
+        // Receiver was reset and lost image.
+        if (status.state == NRF24L01_OTA_IDLE)
+        {
+            started = 0;
+            continue;
+        }
+
+        uint16_t next = status.next[0] | (status.next[1] << 8);
+        uint64_t now = get_tick_count();
+
+        if (next != last_next)
+        {
+            last_next = next;
+            progress = now;
+        }
+        else if (now - progress > NRF24L01_OTA_TIMEOUT)
+        {
+            return -ETIMEDOUT;
+        }
+
+        if (!status.window)
+        {
+            delay_ms(NRF24L01_OTA_POLL_DELAY);
+            continue;
+        }
+
+        for (uint8_t w = 0; w < status.window; w++)
+        {
+            uint16_t block = next + w;
+            uint16_t block_size = nrf24l01_ota_block_size(size, block);
+            uint32_t map = (w < 2) ? nrf24l01_ota_get32(status.map[w]) : 0;
+            struct nrf24l01_ota_data_header *header = (struct nrf24l01_ota_data_header *)packet;
+
+            for (uint8_t chunk = 0; chunk * NRF24L01_OTA_CHUNK < block_size; chunk++)
+            {
+                uint16_t offset = chunk * NRF24L01_OTA_CHUNK;
+                uint8_t chunk_size = (block_size - offset > NRF24L01_OTA_CHUNK) ? NRF24L01_OTA_CHUNK : block_size - offset;
+
+                if (map & (1UL << chunk))
+                    continue;
+
+                header->type = NRF24L01_OTA_TYPE_DATA;
+                header->block[0] = block;
+                header->block[1] = block >> 8;
+                header->chunk = chunk;
+                memcpy(packet + NRF24L01_OTA_DATA_HEADER_SIZE,
+                       image + (uint32_t)block * NRF24L01_OTA_BLOCK_SIZE + offset, chunk_size);
+
+                // Lost chunks are reported by next status.
+                ret = nrf24l01_transfer(device, packet, NRF24L01_OTA_DATA_HEADER_SIZE + chunk_size, ack, &ack_size);
+                if (ret && (ret != -ETIMEDOUT))
+                    return ret;
+            }
+        }
+    }
+}
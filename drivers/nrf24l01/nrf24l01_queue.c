@@ -0,0 +1,488 @@
+#include "bm/nrf24l01_queue.h"
+#include "bm/nrf24l01.h"
+#include "bm/sst25.h"
+#include "bm/crc.h"
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+
+#define NRF24L01_QUEUE_HEADER_SIZE sizeof(struct nrf24l01_queue_segment_header)
+#define NRF24L01_QUEUE_BLOCK_HEADER_SIZE sizeof(struct nrf24l01_queue_block_header)
+#define NRF24L01_QUEUE_BLOCK_SPACE(len) (NRF24L01_QUEUE_BLOCK_HEADER_SIZE + (((len) + 1) & ~1))
+#define NRF24L01_QUEUE_BLOCK_END 0xFFFF
+
+static uint32_t nrf24l01_queue_segment_addr(struct nrf24l01_queue *queue, uint16_t segment)
+{
+    return (uint32_t)(queue->first_sector + segment) * NRF24L01_QUEUE_SEGMENT_SIZE;
+}
+
+static uint16_t nrf24l01_queue_block_crc(const struct nrf24l01_queue_block_header *header, const uint8_t *payload)
+{
+    uint16_t crc = crc16_ccitt(CRC16_CCITT_INIT, &header->len, sizeof(header->len));
+    return crc16_ccitt(crc, payload, header->len);
+}
+
+//! Program state field at addr to NRF24L01_QUEUE_DONE.
+static int nrf24l01_queue_mark_done(struct nrf24l01_queue *queue, uint32_t addr)
+{
+    uint8_t done[2] = {0, 0};
+    return sst25_write_data(queue->flash, addr, done, sizeof(done));
+}
+
+/*!
+ * \returns 1 if segment header is valid, 0 if segment is erased or broken, negative error code otherwise.
+ */
+static int nrf24l01_queue_read_header(struct nrf24l01_queue *queue, uint16_t segment,
+                                      struct nrf24l01_queue_segment_header *header)
+{
+    int status = sst25_read_data(queue->flash, nrf24l01_queue_segment_addr(queue, segment), (uint8_t *)header,
+                                 sizeof(*header));
+    if (status)
+        return status;
+
+    return (header->magic == NRF24L01_QUEUE_MAGIC) &&
+           (header->crc == crc16_ccitt(CRC16_CCITT_INIT, header, offsetof(struct nrf24l01_queue_segment_header, crc)));
+}
+
+/*! Load oldest unsent block to read buffer, drained segments are marked done on the way.
+ * \returns 0 on success, -ENOENT if there are no unsent blocks, negative error code otherwise.
+ */
+static int nrf24l01_queue_load_block(struct nrf24l01_queue *queue)
+{
+    int status;
+
+    if (queue->empty)
+        return -ENOENT;
+
+    for (;;)
+    {
+        if ((queue->tail == queue->head) && (queue->tail_offset >= queue->offset))
+            return -ENOENT;
+
+        struct nrf24l01_queue_block_header header = {NRF24L01_QUEUE_BLOCK_END, 0, 0, 0};
+        uint32_t base = nrf24l01_queue_segment_addr(queue, queue->tail);
+
+        if (queue->tail_offset + NRF24L01_QUEUE_BLOCK_HEADER_SIZE <= NRF24L01_QUEUE_SEGMENT_SIZE)
+        {
+            status = sst25_read_data(queue->flash, base + queue->tail_offset, (uint8_t *)&header, sizeof(header));
+            if (status)
+                return status;
+        }
+
+        if ((header.len != NRF24L01_QUEUE_BLOCK_END) && (header.len <= NRF24L01_QUEUE_BLOCK_SIZE) &&
+                (queue->tail_offset + NRF24L01_QUEUE_BLOCK_SPACE(header.len) <= NRF24L01_QUEUE_SEGMENT_SIZE))
+        {
+            if (header.state == NRF24L01_QUEUE_PENDING)
+            {
+                status = sst25_read_data(queue->flash, base + queue->tail_offset + NRF24L01_QUEUE_BLOCK_HEADER_SIZE,
+                                         queue->read_block, header.len);
+                if (status)
+                    return status;
+
+                if (header.crc == nrf24l01_queue_block_crc(&header, queue->read_block))
+                {
+                    if (header.len)
+                    {
+                        queue->read_pos = 0;
+                        queue->read_len = header.len;
+                        return 0;
+                    }
+                }
+                else
+                {
+                    queue->stats.corrupted++;
+                }
+            }
+
+            queue->tail_offset += NRF24L01_QUEUE_BLOCK_SPACE(header.len);
+            continue;
+        }
+
+        // End of segment or interrupted write.
+        if (queue->tail == queue->head)
+        {
+            queue->tail_offset = queue->offset;
+            return -ENOENT;
+        }
+
+        status = nrf24l01_queue_mark_done(queue, base + offsetof(struct nrf24l01_queue_segment_header, state));
+        if (status)
+            return status;
+
+        queue->tail = (queue->tail + 1) % queue->sector_count;
+        queue->tail_offset = NRF24L01_QUEUE_HEADER_SIZE;
+    }
+}
+
+//! Mark read block sent and load next one.
+static int nrf24l01_queue_finish_block(struct nrf24l01_queue *queue)
+{
+    uint32_t addr = nrf24l01_queue_segment_addr(queue, queue->tail) + queue->tail_offset;
+    int status;
+
+    status = nrf24l01_queue_mark_done(queue, addr + offsetof(struct nrf24l01_queue_block_header, state));
+    if (status)
+        return status;
+
+    queue->tail_offset += NRF24L01_QUEUE_BLOCK_SPACE(queue->read_len);
+    queue->read_len = 0;
+    queue->read_pos = 0;
+
+    status = nrf24l01_queue_load_block(queue);
+    return (status == -ENOENT) ? 0 : status;
+}
+
+//! Erase next segment, overwriting the oldest one if queue is full.
+static int nrf24l01_queue_open_segment(struct nrf24l01_queue *queue)
+{
+    uint16_t next = queue->empty ? 0 : (queue->head + 1) % queue->sector_count;
+    uint32_t seq = queue->empty ? 0 : queue->seq + 1;
+    int status;
+
+    if (queue->empty || ((queue->tail == queue->head) && !queue->read_len && (queue->tail_offset >= queue->offset)))
+    {
+        // Everything is sent, head segment is drained.
+        if (!queue->empty)
+        {
+            status = nrf24l01_queue_mark_done(queue, nrf24l01_queue_segment_addr(queue, queue->head)
+                                              + offsetof(struct nrf24l01_queue_segment_header, state));
+            if (status)
+                return status;
+        }
+
+        queue->tail = next;
+        queue->tail_offset = NRF24L01_QUEUE_HEADER_SIZE;
+    }
+    else if (next == queue->tail)
+    {
+        queue->stats.overruns++;
+        queue->tail = (queue->tail + 1) % queue->sector_count;
+        queue->tail_offset = NRF24L01_QUEUE_HEADER_SIZE;
+        queue->read_len = 0;
+        queue->read_pos = 0;
+    }
+
+    status = sst25_erase(queue->flash, queue->first_sector + next, SST25_ERASE_4K);
+    if (status)
+        return status;
+
+    queue->stats.erases++;
+
+    struct nrf24l01_queue_segment_header header =
+    {
+        .magic = NRF24L01_QUEUE_MAGIC,
+        .seq = seq,
+        .crc = 0,
+        .state = NRF24L01_QUEUE_PENDING
+    };
+    header.crc = crc16_ccitt(CRC16_CCITT_INIT, &header, offsetof(struct nrf24l01_queue_segment_header, crc));
+
+    queue->head = next;
+    queue->seq = seq;
+    queue->offset = NRF24L01_QUEUE_HEADER_SIZE;
+    queue->empty = 0;
+
+    return sst25_write_data(queue->flash, nrf24l01_queue_segment_addr(queue, next), (uint8_t *)&header, sizeof(header));
+}
+
+int nrf24l01_queue_mount(struct nrf24l01_queue *queue, struct nrf24l01 *device, struct sst25 *flash,
+                         uint16_t first_sector, uint16_t sector_count)
+{
+    if (sector_count < 2)
+        return -EINVAL;
+
+    memset(queue, 0, sizeof(*queue));
+    queue->device = device;
+    queue->flash = flash;
+    queue->first_sector = first_sector;
+    queue->sector_count = sector_count;
+    queue->offset = NRF24L01_QUEUE_HEADER_SIZE;
+    queue->tail_offset = NRF24L01_QUEUE_HEADER_SIZE;
+
+    struct nrf24l01_queue_segment_header header;
+    uint32_t seq;
+
+    int status = nrf24l01_queue_read_header(queue, 0, &header);
+    if (status < 0)
+        return status;
+
+    if (status)
+    {
+        /*
+         * Segments from 0 to head have consecutive numbers, segments after head are
+         * older or erased, so head is found by binary search.
+         */
+        uint16_t lo = 0, hi = sector_count;
+        seq = header.seq;
+
+        while (hi - lo > 1)
+        {
+            uint16_t mid = (lo + hi) / 2;
+
+            status = nrf24l01_queue_read_header(queue, mid, &header);
+            if (status < 0)
+                return status;
+
+            if (status && (header.seq == seq + mid))
+                lo = mid;
+            else
+                hi = mid;
+        }
+
+        queue->head = lo;
+    }
+    else
+    {
+        // Segment 0 is erased: either queue is empty or wrap was interrupted.
+        queue->head = sector_count - 1;
+    }
+
+    status = nrf24l01_queue_read_header(queue, queue->head, &header);
+    if (status < 0)
+        return status;
+
+    if (!status)
+    {
+        queue->empty = 1;
+        queue->head = 0;
+        return 0;
+    }
+
+    queue->seq = header.seq;
+
+    // Head marked done means that next segment wasn't opened, new blocks go there.
+    if (header.state != NRF24L01_QUEUE_PENDING)
+        queue->offset = NRF24L01_QUEUE_SEGMENT_SIZE;
+
+    // Oldest segment follows head, or segment after it if it was being erased.
+    uint16_t oldest = 0;
+
+    for (uint16_t i = 1; i < 3; i++)
+    {
+        uint16_t segment = (queue->head + i) % sector_count;
+
+        if (segment == queue->head)
+            break;
+
+        status = nrf24l01_queue_read_header(queue, segment, &header);
+        if (status < 0)
+            return status;
+
+        if (status && (header.seq == queue->seq - (sector_count - i)))
+        {
+            oldest = segment;
+            break;
+        }
+    }
+
+    // Drained segments are marked done in order, so tail is found by binary search too.
+    uint16_t count = (queue->head + sector_count - oldest) % sector_count + 1;
+    uint16_t lo = 0, hi = count - 1;
+
+    while (lo < hi)
+    {
+        uint16_t mid = (lo + hi) / 2;
+
+        status = nrf24l01_queue_read_header(queue, (oldest + mid) % sector_count, &header);
+        if (status < 0)
+            return status;
+
+        if (status && (header.state != NRF24L01_QUEUE_PENDING))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    queue->tail = (oldest + lo) % sector_count;
+
+    // Find write offset in head segment.
+    uint32_t base = nrf24l01_queue_segment_addr(queue, queue->head);
+
+    while (queue->offset + NRF24L01_QUEUE_BLOCK_HEADER_SIZE <= NRF24L01_QUEUE_SEGMENT_SIZE)
+    {
+        struct nrf24l01_queue_block_header block;
+
+        status = sst25_read_data(flash, base + queue->offset, (uint8_t *)&block, sizeof(block));
+        if (status)
+            return status;
+
+        if (block.len == NRF24L01_QUEUE_BLOCK_END)
+            break;
+
+        if ((block.len > NRF24L01_QUEUE_BLOCK_SIZE) ||
+                (queue->offset + NRF24L01_QUEUE_BLOCK_SPACE(block.len) > NRF24L01_QUEUE_SEGMENT_SIZE))
+        {
+            // Interrupted write, continue in next segment.
+            queue->offset = NRF24L01_QUEUE_SEGMENT_SIZE;
+            break;
+        }
+
+        queue->offset += NRF24L01_QUEUE_BLOCK_SPACE(block.len);
+    }
+
+    // Skip sent blocks of tail segment.
+    status = nrf24l01_queue_load_block(queue);
+    return (status == -ENOENT) ? 0 : status;
+}
+
+int nrf24l01_queue_format(struct nrf24l01_queue *queue, struct nrf24l01 *device, struct sst25 *flash,
+                          uint16_t first_sector, uint16_t sector_count)
+{
+    for (uint16_t i = 0; i < sector_count; i++)
+    {
+        int status = sst25_erase(flash, first_sector + i, SST25_ERASE_4K);
+        if (status)
+            return status;
+    }
+
+    return nrf24l01_queue_mount(queue, device, flash, first_sector, sector_count);
+}
+
+int nrf24l01_queue_is_empty(struct nrf24l01_queue *queue)
+{
+    if (queue->read_len || (queue->block_pos < queue->block_len))
+        return 0;
+
+    return queue->empty || ((queue->tail == queue->head) && (queue->tail_offset >= queue->offset));
+}
+
+//! Drop frames sent from RAM block.
+static void nrf24l01_queue_compact(struct nrf24l01_queue *queue)
+{
+    if (!queue->block_pos)
+        return;
+
+    queue->block_len -= queue->block_pos;
+    memmove(queue->block, queue->block + queue->block_pos, queue->block_len);
+    queue->block_pos = 0;
+}
+
+int nrf24l01_queue_flush(struct nrf24l01_queue *queue)
+{
+    int status;
+
+    nrf24l01_queue_compact(queue);
+
+    if (!queue->block_len)
+        return 0;
+
+    uint16_t space = NRF24L01_QUEUE_BLOCK_SPACE(queue->block_len);
+
+    if (queue->empty || (queue->offset + space > NRF24L01_QUEUE_SEGMENT_SIZE))
+    {
+        status = nrf24l01_queue_open_segment(queue);
+        if (status)
+            return status;
+    }
+
+    struct nrf24l01_queue_block_header header =
+    {
+        .len = queue->block_len,
+        .crc = 0,
+        .state = NRF24L01_QUEUE_PENDING,
+        .reserved = 0xFFFF
+    };
+    header.crc = nrf24l01_queue_block_crc(&header, queue->block);
+
+    uint32_t addr = nrf24l01_queue_segment_addr(queue, queue->head) + queue->offset;
+
+    // Space and frames are consumed even if programming fails.
+    queue->block[queue->block_len] = 0xFF;
+    queue->offset += space;
+    queue->block_len = 0;
+    queue->stats.blocks++;
+
+    status = sst25_write_data(queue->flash, addr, (uint8_t *)&header, sizeof(header));
+    if (status)
+        return status;
+
+    return sst25_write_data(queue->flash, addr + NRF24L01_QUEUE_BLOCK_HEADER_SIZE, queue->block,
+                            space - NRF24L01_QUEUE_BLOCK_HEADER_SIZE);
+}
+
+int nrf24l01_queue_send(struct nrf24l01_queue *queue, uint8_t *data, uint8_t size)
+{
+    int status;
+
+    if ((size == 0) || (size > 32))
+        return -EINVAL;
+
+    if (nrf24l01_queue_is_empty(queue))
+    {
+        status = nrf24l01_send(queue->device, data, size);
+        if (status != -ETIMEDOUT)
+            return status;
+    }
+
+    nrf24l01_queue_compact(queue);
+
+    if (queue->block_len + 1 + size > NRF24L01_QUEUE_BLOCK_SIZE)
+    {
+        status = nrf24l01_queue_flush(queue);
+        if (status)
+            return status;
+    }
+
+    queue->block[queue->block_len++] = size;
+    memcpy(queue->block + queue->block_len, data, size);
+    queue->block_len += size;
+    queue->stats.queued++;
+
+    return 0;
+}
+
+int nrf24l01_queue_poll(struct nrf24l01_queue *queue, uint16_t max)
+{
+    uint16_t sent = 0;
+    int status;
+
+    for (;;)
+    {
+        if (!queue->read_len)
+        {
+            status = nrf24l01_queue_load_block(queue);
+            if (status && (status != -ENOENT))
+                return status;
+        }
+
+        uint8_t *block = queue->read_len ? queue->read_block : queue->block;
+        uint16_t *pos = queue->read_len ? &queue->read_pos : &queue->block_pos;
+        uint16_t len = queue->read_len ? queue->read_len : queue->block_len;
+
+        if (*pos >= len)
+        {
+            queue->block_pos = 0;
+            queue->block_len = 0;
+            return 0;
+        }
+
+        if (max && (sent >= max))
+            return -EAGAIN;
+
+        uint8_t size = block[*pos];
+
+        if ((size == 0) || (size > 32) || (*pos + 1 + size > len))
+        {
+            // Broken frame, rest of block is dropped.
+            queue->stats.corrupted++;
+            *pos = len;
+        }
+        else
+        {
+            status = nrf24l01_send(queue->device, block + *pos + 1, size);
+            if (status)
+                return status;
+
+            *pos += 1 + size;
+            sent++;
+            queue->stats.sent++;
+        }
+
+        if (queue->read_len && (queue->read_pos >= queue->read_len))
+        {
+            status = nrf24l01_queue_finish_block(queue);
+            if (status)
+                return status;
+        }
+    }
+}
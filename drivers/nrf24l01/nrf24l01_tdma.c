@@ -0,0 +1,372 @@
+#include "bm/nrf24l01_tdma.h"
+#include "bm/nrf24l01.h"
+#include "bm/delay.h"
+#include <string.h>
+#include <errno.h>
+
+static uint32_t nrf24l01_tdma_frame_time(struct nrf24l01_tdma *tdma)
+{
+    return (uint32_t)(tdma->slots + 1) * tdma->slot_time;
+}
+
+static void nrf24l01_tdma_wait(uint64_t tick)
+{
+    while (get_tick_count() < tick)
+        system_nop();
+}
+
+static int nrf24l01_tdma_wake(struct nrf24l01_tdma *tdma)
+{
+    int status;
+
+    if (tdma->awake)
+        return 0;
+
+    status = nrf24l01_power_up(tdma->device);
+    if (status)
+        return status;
+
+    delay_ms(NRF24L01_TDMA_WAKEUP);
+
+    tdma->awake = 1;
+    return 0;
+}
+
+static int nrf24l01_tdma_sleep(struct nrf24l01_tdma *tdma)
+{
+    if (!tdma->awake)
+        return 0;
+
+    tdma->awake = 0;
+    return nrf24l01_power_down(tdma->device);
+}
+
+static int nrf24l01_tdma_send_beacon(struct nrf24l01_tdma *tdma, uint64_t now)
+{
+    struct nrf24l01 *device = tdma->device;
+    struct nrf24l01_tdma_beacon beacon;
+    int status;
+
+    beacon.marker = NRF24L01_TDMA_MARKER;
+    beacon.seq = ++tdma->seq;
+    beacon.slots = tdma->slots;
+    beacon.slot_time = tdma->slot_time;
+    beacon.time[0] = now;
+    beacon.time[1] = now >> 8;
+    beacon.time[2] = now >> 16;
+    beacon.time[3] = now >> 24;
+
+    nrf24l01_enter_standby(device);
+
+    status = nrf24l01_send_no_ack(device, (uint8_t *)&beacon, sizeof(beacon));
+    if (status)
+        return status;
+
+    tdma->frame_start = now;
+    tdma->hub_time = now;
+    tdma->beacons++;
+
+    return nrf24l01_enter_rx(device);
+}
+
+int nrf24l01_tdma_hub_init(struct nrf24l01_tdma *tdma, struct nrf24l01 *device, const uint8_t address[5],
+                           uint8_t slots, uint8_t slot_time)
+{
+    uint8_t addr[5];
+    int status;
+
+    if ((slots == 0) || (slot_time == 0))
+        return -EINVAL;
+
+    memset(tdma, 0, sizeof(*tdma));
+    tdma->device = device;
+    tdma->hub = 1;
+    tdma->slots = slots;
+    tdma->slot_time = slot_time;
+    tdma->awake = 1;
+
+    memcpy(addr, address, 5);
+
+    status = nrf24l01_set_tx_address(device, addr);
+    if (status)
+        return status;
+
+    status = nrf24l01_set_rx_address(device, 0, addr);
+    if (status)
+        return status;
+
+    status = nrf24l01_enable_pipes(device, 1);
+    if (status)
+        return status;
+
+    status = nrf24l01_enable_dynamic_ack(device);
+    if (status)
+        return status;
+
+    // First poll sends beacon.
+    tdma->frame_start = get_tick_count() - nrf24l01_tdma_frame_time(tdma);
+
+    return nrf24l01_enter_rx(device);
+}
+
+int nrf24l01_tdma_poll(struct nrf24l01_tdma *tdma, struct nrf24l01_frame *frame)
+{
+    uint64_t now = get_tick_count();
+    int status;
+
+    if (!tdma->hub)
+        return -EINVAL;
+
+    // Late beacon starts frame late, nodes align to beacon reception.
+    if (now >= tdma->frame_start + nrf24l01_tdma_frame_time(tdma))
+    {
+        status = nrf24l01_tdma_send_beacon(tdma, now);
+        if (status)
+            return status;
+    }
+
+    return nrf24l01_read_frame(tdma->device, frame);
+}
+
+int nrf24l01_tdma_node_init(struct nrf24l01_tdma *tdma, struct nrf24l01 *device, const uint8_t hub_address[5],
+                            uint8_t slot)
+{
+    uint8_t addr[5];
+    int status;
+
+    memset(tdma, 0, sizeof(*tdma));
+    tdma->device = device;
+    tdma->slot = slot;
+
+    memcpy(addr, hub_address, 5);
+
+    status = nrf24l01_set_tx_address(device, addr);
+    if (status)
+        return status;
+
+    // Pipe 0 receives both ACKs and beacons.
+    status = nrf24l01_set_rx_address(device, 0, addr);
+    if (status)
+        return status;
+
+    status = nrf24l01_enable_pipes(device, 1);
+    if (status)
+        return status;
+
+    return nrf24l01_power_down(device);
+}
+
+//! Listen for beacon until tick count reaches until.
+static int nrf24l01_tdma_listen(struct nrf24l01_tdma *tdma, uint64_t until)
+{
+    struct nrf24l01 *device = tdma->device;
+    struct nrf24l01_tdma_beacon *beacon;
+    struct nrf24l01_frame frame;
+    int status;
+
+    status = nrf24l01_tdma_wake(tdma);
+    if (status)
+        return status;
+
+    status = nrf24l01_enter_rx(device);
+    if (status)
+        return status;
+
+    for (;;)
+    {
+        status = nrf24l01_read_frame(device, &frame);
+        if (status == -EAGAIN)
+        {
+            if (get_tick_count() >= until)
+            {
+                status = -ETIMEDOUT;
+                break;
+            }
+
+            system_nop();
+            continue;
+        }
+
+        if (status)
+            break;
+
+        beacon = (struct nrf24l01_tdma_beacon *)frame.data;
+
+        if ((frame.size != sizeof(*beacon)) || (beacon->marker != NRF24L01_TDMA_MARKER)
+            || (beacon->slots == 0) || (beacon->slot_time == 0))
+            continue;
+
+        tdma->frame_start = get_tick_count();
+        tdma->hub_time = beacon->time[0] | (beacon->time[1] << 8) | (beacon->time[2] << 16)
+                         | ((uint32_t)beacon->time[3] << 24);
+        tdma->seq = beacon->seq;
+        tdma->slots = beacon->slots;
+        tdma->slot_time = beacon->slot_time;
+        tdma->synced = 1;
+        tdma->beacons++;
+        break;
+    }
+
+    nrf24l01_enter_standby(device);
+    return status;
+}
+
+int nrf24l01_tdma_sync(struct nrf24l01_tdma *tdma, uint16_t timeout)
+{
+    uint64_t until = timeout ? get_tick_count() + NRF24L01_TDMA_WAKEUP + timeout : UINT64_MAX;
+    int sleep_status;
+    int status;
+
+    if (tdma->hub)
+        return -EINVAL;
+
+    status = nrf24l01_tdma_listen(tdma, until);
+    sleep_status = nrf24l01_tdma_sleep(tdma);
+
+    return status ? status : sleep_status;
+}
+
+/*! Sleep until node slot, listening for beacon on the way when resync is due.
+ * \returns 0 and tick count of slot end on success, negative error code otherwise.
+ */
+static int nrf24l01_tdma_next_slot(struct nrf24l01_tdma *tdma, uint64_t *end)
+{
+    int status;
+
+    for (;;)
+    {
+        uint64_t now = get_tick_count();
+        uint32_t frame_time = nrf24l01_tdma_frame_time(tdma);
+        uint32_t frames = (now - tdma->frame_start) / frame_time;
+        uint64_t start = tdma->frame_start + (uint64_t)frames * frame_time + (tdma->slot + 1) * tdma->slot_time;
+
+        if (now + NRF24L01_TDMA_GUARD > start + tdma->slot_time)
+        {
+            frames++;
+            start += frame_time;
+        }
+
+        // Beacon of slot frame, resync moves to frame which beacon is still ahead.
+        uint64_t beacon = start - (tdma->slot + 1) * tdma->slot_time;
+
+        if ((frames >= NRF24L01_TDMA_RESYNC) && (beacon + NRF24L01_TDMA_GUARD <= now))
+        {
+            frames++;
+            start += frame_time;
+            beacon += frame_time;
+        }
+
+        if (frames >= NRF24L01_TDMA_RESYNC)
+        {
+            status = nrf24l01_tdma_sleep(tdma);
+            if (status)
+                return status;
+
+            if (beacon > now + NRF24L01_TDMA_WAKEUP + NRF24L01_TDMA_GUARD)
+                nrf24l01_tdma_wait(beacon - NRF24L01_TDMA_WAKEUP - NRF24L01_TDMA_GUARD);
+
+            status = nrf24l01_tdma_listen(tdma, beacon + tdma->slot_time);
+            if (!status)
+                continue;
+
+            if (status != -ETIMEDOUT)
+                return status;
+
+            tdma->missed++;
+
+            if (frames >= 2 * NRF24L01_TDMA_RESYNC)
+            {
+                tdma->synced = 0;
+                return -ENOLINK;
+            }
+
+            // Old timing is kept, beacon of next frame is tried.
+            continue;
+        }
+
+        if (tdma->awake && (start > now + NRF24L01_TDMA_WAKEUP))
+        {
+            status = nrf24l01_tdma_sleep(tdma);
+            if (status)
+                return status;
+        }
+
+        if (!tdma->awake)
+        {
+            if (start > now + NRF24L01_TDMA_WAKEUP)
+                nrf24l01_tdma_wait(start - NRF24L01_TDMA_WAKEUP);
+
+            status = nrf24l01_tdma_wake(tdma);
+            if (status)
+                return status;
+
+            // Slot may be over already.
+            continue;
+        }
+
+        nrf24l01_tdma_wait(start);
+
+        *end = start + tdma->slot_time;
+        return 0;
+    }
+}
+
+int nrf24l01_tdma_send(struct nrf24l01_tdma *tdma, uint8_t *data, uint16_t size)
+{
+    uint8_t ack[32];
+    uint8_t ack_size;
+    uint16_t offset = 0;
+    uint64_t end;
+    int result = 0;
+    int status = 0;
+
+    if (tdma->hub)
+        return -EINVAL;
+
+    if (tdma->device->rx_ring)
+        return -EBUSY;
+
+    if (!tdma->synced)
+        return -ENOLINK;
+
+    if (tdma->slot >= tdma->slots)
+        return -EINVAL;
+
+    while (!status && (offset < size))
+    {
+        status = nrf24l01_tdma_next_slot(tdma, &end);
+        if (status)
+            break;
+
+        while ((offset < size) && (get_tick_count() + NRF24L01_TDMA_GUARD <= end))
+        {
+            uint8_t chunk = (size - offset > 32) ? 32 : size - offset;
+
+            status = nrf24l01_transfer(tdma->device, data + offset, chunk, ack, &ack_size);
+            if (status == -ETIMEDOUT)
+            {
+                result = -ETIMEDOUT;
+                status = 0;
+            }
+
+            if (status)
+                break;
+
+            offset += chunk;
+        }
+    }
+
+    if (status)
+    {
+        nrf24l01_tdma_sleep(tdma);
+        return status;
+    }
+
+    status = nrf24l01_tdma_sleep(tdma);
+    return status ? status : result;
+}
+
+uint32_t nrf24l01_tdma_time(struct nrf24l01_tdma *tdma)
+{
+    return tdma->hub_time + (uint32_t)(get_tick_count() - tdma->frame_start);
+}
@@ -0,0 +1,209 @@
+#include "bm/nrf24l01_telemetry.h"
+#include "bm/nrf24l01.h"
+#include <string.h>
+#include <errno.h>
+
+#define NRF24L01_TELEMETRY_BITS ((32 - NRF24L01_TELEMETRY_HEADER_SIZE) * 8)
+
+static const uint8_t nrf24l01_telemetry_time_bits[4] = {0, 8, 16, 32};
+static const uint8_t nrf24l01_telemetry_value_bits[4] = {0, 6, 16, 32};
+
+//! Smallest class which holds value.
+static uint8_t nrf24l01_telemetry_class(const uint8_t *bits, uint32_t value)
+{
+    for (uint8_t i = 0; i < 3; i++)
+        if (!(value >> bits[i]))
+            return i;
+
+    return 3;
+}
+
+static void nrf24l01_telemetry_put(uint8_t *records, uint16_t *pos, uint32_t value, uint8_t bits)
+{
+    while (bits--)
+    {
+        uint8_t *byte = &records[*pos >> 3];
+        uint8_t mask = 0x80 >> (*pos & 7);
+
+        if ((value >> bits) & 1)
+            *byte |= mask;
+        else
+            *byte &= ~mask;
+
+        (*pos)++;
+    }
+}
+
+static uint32_t nrf24l01_telemetry_get(const uint8_t *records, uint16_t *pos, uint8_t bits)
+{
+    uint32_t value = 0;
+
+    while (bits--)
+    {
+        value = (value << 1) | ((records[*pos >> 3] >> (7 - (*pos & 7))) & 1);
+        (*pos)++;
+    }
+
+    return value;
+}
+
+static void nrf24l01_telemetry_reset(struct nrf24l01_telemetry *telemetry)
+{
+    telemetry->count = 0;
+    telemetry->bits = 0;
+    memset(telemetry->last, 0, sizeof(telemetry->last));
+    memset(telemetry->frame, 0, sizeof(telemetry->frame));
+}
+
+void nrf24l01_telemetry_init(struct nrf24l01_telemetry *telemetry, struct nrf24l01 *device, uint32_t deadline)
+{
+    telemetry->device = device;
+    telemetry->deadline = deadline;
+    telemetry->seq = 0;
+    telemetry->time = 0;
+    telemetry->samples = 0;
+    telemetry->frames = 0;
+    telemetry->failed = 0;
+
+    nrf24l01_telemetry_reset(telemetry);
+}
+
+int nrf24l01_telemetry_flush(struct nrf24l01_telemetry *telemetry)
+{
+    int status;
+
+    if (!telemetry->count)
+        return 0;
+
+    telemetry->frame[0] = telemetry->seq;
+    telemetry->frame[1] = telemetry->count;
+
+    status = nrf24l01_send(telemetry->device, telemetry->frame,
+                           NRF24L01_TELEMETRY_HEADER_SIZE + (telemetry->bits + 7) / 8);
+    if (status)
+    {
+        telemetry->failed++;
+        return status;
+    }
+
+    telemetry->frames++;
+    telemetry->seq++;
+    nrf24l01_telemetry_reset(telemetry);
+
+    return 0;
+}
+
+int nrf24l01_telemetry_add(struct nrf24l01_telemetry *telemetry, uint8_t channel, uint32_t time, int32_t value)
+{
+    uint8_t *records = telemetry->frame + NRF24L01_TELEMETRY_HEADER_SIZE;
+    int status;
+
+    if ((channel >= NRF24L01_TELEMETRY_CHANNELS) || (telemetry->count && (time < telemetry->time)))
+        return -EINVAL;
+
+    for (;;)
+    {
+        uint32_t time_delta = telemetry->count ? time - telemetry->time : 0;
+        int32_t delta = (int32_t)((uint32_t)value - (uint32_t)telemetry->last[channel]);
+        uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+        uint8_t time_class = nrf24l01_telemetry_class(nrf24l01_telemetry_time_bits, time_delta);
+        uint8_t value_class = nrf24l01_telemetry_class(nrf24l01_telemetry_value_bits, zigzag);
+        uint16_t bits = 8 + nrf24l01_telemetry_time_bits[time_class] + nrf24l01_telemetry_value_bits[value_class];
+
+        if ((telemetry->bits + bits > NRF24L01_TELEMETRY_BITS) || (telemetry->count == 0xFF))
+        {
+            status = nrf24l01_telemetry_flush(telemetry);
+            if (status)
+                return status;
+
+            continue;
+        }
+
+        if (!telemetry->count)
+        {
+            telemetry->frame[2] = time;
+            telemetry->frame[3] = time >> 8;
+            telemetry->frame[4] = time >> 16;
+            telemetry->frame[5] = time >> 24;
+        }
+
+        nrf24l01_telemetry_put(records, &telemetry->bits, channel, 4);
+        nrf24l01_telemetry_put(records, &telemetry->bits, time_class, 2);
+        nrf24l01_telemetry_put(records, &telemetry->bits, time_delta, nrf24l01_telemetry_time_bits[time_class]);
+        nrf24l01_telemetry_put(records, &telemetry->bits, value_class, 2);
+        nrf24l01_telemetry_put(records, &telemetry->bits, zigzag, nrf24l01_telemetry_value_bits[value_class]);
+
+        telemetry->count++;
+        telemetry->time = time;
+        telemetry->last[channel] = value;
+        telemetry->samples++;
+
+        return 0;
+    }
+}
+
+int nrf24l01_telemetry_poll(struct nrf24l01_telemetry *telemetry, uint32_t now)
+{
+    uint32_t first;
+
+    if (!telemetry->count)
+        return 0;
+
+    first = telemetry->frame[2] | (telemetry->frame[3] << 8) | (telemetry->frame[4] << 16)
+            | ((uint32_t)telemetry->frame[5] << 24);
+
+    if (now - first < telemetry->deadline)
+        return 0;
+
+    return nrf24l01_telemetry_flush(telemetry);
+}
+
+int nrf24l01_telemetry_unpack(const uint8_t *data, uint8_t size, struct nrf24l01_telemetry_sample *samples,
+                              uint8_t *count, uint8_t *seq)
+{
+    int32_t last[NRF24L01_TELEMETRY_CHANNELS];
+    const uint8_t *records = data + NRF24L01_TELEMETRY_HEADER_SIZE;
+    uint16_t limit;
+    uint16_t pos = 0;
+    uint32_t time;
+
+    if ((size < NRF24L01_TELEMETRY_HEADER_SIZE) || (size > 32) || (data[1] > NRF24L01_TELEMETRY_MAX_SAMPLES))
+        return -EBADMSG;
+
+    limit = (size - NRF24L01_TELEMETRY_HEADER_SIZE) * 8;
+    time = data[2] | (data[3] << 8) | (data[4] << 16) | ((uint32_t)data[5] << 24);
+    memset(last, 0, sizeof(last));
+
+    for (uint8_t i = 0; i < data[1]; i++)
+    {
+        if (pos + 8 > limit)
+            return -EBADMSG;
+
+        uint8_t channel = nrf24l01_telemetry_get(records, &pos, 4);
+        uint8_t time_bits = nrf24l01_telemetry_time_bits[nrf24l01_telemetry_get(records, &pos, 2)];
+
+        if (pos + time_bits + 2 > limit)
+            return -EBADMSG;
+
+        time += nrf24l01_telemetry_get(records, &pos, time_bits);
+
+        uint8_t value_bits = nrf24l01_telemetry_value_bits[nrf24l01_telemetry_get(records, &pos, 2)];
+
+        if (pos + value_bits > limit)
+            return -EBADMSG;
+
+        uint32_t zigzag = nrf24l01_telemetry_get(records, &pos, value_bits);
+
+        last[channel] = (int32_t)((uint32_t)last[channel] + ((zigzag >> 1) ^ -(zigzag & 1)));
+
+        samples[i].channel = channel;
+        samples[i].time = time;
+        samples[i].value = last[channel];
+    }
+
+    *count = data[1];
+    if (seq)
+        *seq = data[0];
+
+    return 0;
+}
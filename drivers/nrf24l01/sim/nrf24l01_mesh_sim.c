@@ -0,0 +1,144 @@
+#include "nrf24l01_mesh_sim.h"
+#include "bm/nrf24l01_mesh.h"
+#include <string.h>
+#include <errno.h>
+
+static struct nrf24l01_mesh_sim_radio *nrf24l01_mesh_sim_find(struct nrf24l01_mesh_sim *sim, uint8_t id)
+{
+    for (int i = 0; i < NRF24L01_MESH_SIM_RADIOS; i++)
+        if (sim->radios[i].id == id)
+            return &sim->radios[i];
+
+    return 0;
+}
+
+//! Returns 1 if packet is stored in FIFO of receiver.
+static int nrf24l01_mesh_sim_deliver(struct nrf24l01_mesh_sim_radio *src, struct nrf24l01_mesh_sim_radio *dst,
+                                     uint8_t pipe, const uint8_t *packet, uint8_t size)
+{
+    struct nrf24l01_mesh_sim *sim = src->sim;
+
+    if (!dst->listening)
+        return 0;
+
+    if (sim->link && !sim->link(sim->context, src->id, dst->id))
+    {
+        sim->lost++;
+        return 0;
+    }
+
+    if (dst->count >= NRF24L01_MESH_SIM_FIFO)
+    {
+        sim->overflows++;
+        return 0;
+    }
+
+    struct nrf24l01_frame *frame = &dst->fifo[(dst->head + dst->count) % NRF24L01_MESH_SIM_FIFO];
+
+    frame->pipe = pipe;
+    frame->size = size;
+    memcpy(frame->data, packet, size);
+    dst->count++;
+
+    return 1;
+}
+
+static int nrf24l01_mesh_sim_receive(void *context, struct nrf24l01_frame *frame)
+{
+    struct nrf24l01_mesh_sim_radio *radio = context;
+
+    if (!radio->count)
+        return -EAGAIN;
+
+    *frame = radio->fifo[radio->head];
+    radio->head = (radio->head + 1) % NRF24L01_MESH_SIM_FIFO;
+    radio->count--;
+
+    return 0;
+}
+
+static int nrf24l01_mesh_sim_send(void *context, uint8_t dst, uint8_t *packet, uint8_t size)
+{
+    struct nrf24l01_mesh_sim_radio *radio = context;
+    struct nrf24l01_mesh_sim *sim = radio->sim;
+
+    if (size > 32)
+        return -EINVAL;
+
+    radio->listening = 0;
+    sim->packets++;
+
+    if (dst == NRF24L01_MESH_BROADCAST)
+    {
+        for (int i = 0; i < NRF24L01_MESH_SIM_RADIOS; i++)
+            if (sim->radios[i].id && (&sim->radios[i] != radio))
+                nrf24l01_mesh_sim_deliver(radio, &sim->radios[i], 2, packet, size);
+
+        return 0;
+    }
+
+    struct nrf24l01_mesh_sim_radio *receiver = nrf24l01_mesh_sim_find(sim, dst);
+
+    if (!receiver || !nrf24l01_mesh_sim_deliver(radio, receiver, 1, packet, size))
+        return -ETIMEDOUT;
+
+    return 0;
+}
+
+static int nrf24l01_mesh_sim_listen(void *context)
+{
+    struct nrf24l01_mesh_sim_radio *radio = context;
+
+    radio->listening = 1;
+    return 0;
+}
+
+static const struct nrf24l01_mesh_radio nrf24l01_mesh_sim_radio =
+{
+    nrf24l01_mesh_sim_receive,
+    nrf24l01_mesh_sim_send,
+    nrf24l01_mesh_sim_listen,
+};
+
+void nrf24l01_mesh_sim_init(struct nrf24l01_mesh_sim *sim, int (*link)(void *context, uint8_t src, uint8_t dst),
+                            void *context)
+{
+    memset(sim, 0, sizeof(*sim));
+    sim->link = link;
+    sim->context = context;
+}
+
+int nrf24l01_mesh_sim_attach(struct nrf24l01_mesh_sim *sim, struct nrf24l01_mesh *mesh, uint8_t id)
+{
+    if ((id == 0) || (id == NRF24L01_MESH_BROADCAST))
+        return -EINVAL;
+
+    // Restarted node gets its radio back with empty FIFO.
+    struct nrf24l01_mesh_sim_radio *radio = nrf24l01_mesh_sim_find(sim, id);
+    if (!radio)
+        radio = nrf24l01_mesh_sim_find(sim, 0);
+
+    if (!radio)
+        return -ENOBUFS;
+
+    memset(radio, 0, sizeof(*radio));
+    radio->sim = sim;
+    radio->id = id;
+
+    int status = nrf24l01_mesh_init_radio(mesh, &nrf24l01_mesh_sim_radio, radio, id);
+    if (status)
+        return status;
+
+    return nrf24l01_mesh_sim_listen(radio);
+}
+
+int nrf24l01_mesh_sim_detach(struct nrf24l01_mesh_sim *sim, uint8_t id)
+{
+    struct nrf24l01_mesh_sim_radio *radio = nrf24l01_mesh_sim_find(sim, id);
+
+    if (!radio)
+        return -ENOENT;
+
+    memset(radio, 0, sizeof(*radio));
+    return 0;
+}
@@ -0,0 +1,78 @@
+#ifndef BAREMETAL_NRF24L01_MESH_SIM_H
+#define BAREMETAL_NRF24L01_MESH_SIM_H
+
+/*!
+ * \defgroup drivers Drivers - Device drivers
+ * \{
+ * \defgroup nrf24l01_mesh_sim NRF24L01 mesh simulation - Simulated radios for host tests
+ * \{
+ */
+
+#include <stdint.h>
+#include <bm/nrf24l01_mesh.h>
+
+//! Maximum number of radios in simulation.
+#ifndef NRF24L01_MESH_SIM_RADIOS
+#define NRF24L01_MESH_SIM_RADIOS 32
+#endif
+
+//! Packets buffered by each radio, as in RX FIFO of device.
+#ifndef NRF24L01_MESH_SIM_FIFO
+#define NRF24L01_MESH_SIM_FIFO 3
+#endif
+
+struct nrf24l01_mesh_sim;
+
+//! Simulated radio.
+struct nrf24l01_mesh_sim_radio
+{
+    struct nrf24l01_mesh_sim *sim;
+    uint8_t id;                                    /*!< Node ID, 0 if radio is free */
+    uint8_t listening;                             /*!< Radio is in RX mode */
+    uint8_t head;                                  /*!< First packet in FIFO */
+    uint8_t count;                                 /*!< Packets in FIFO */
+    struct nrf24l01_frame fifo[NRF24L01_MESH_SIM_FIFO];
+};
+
+/*!
+ * Shared air of simulated radios. Delivery is immediate, so mesh nodes of one host
+ * process are polled in turn, host advances get_tick_count() with tick(). Unicast packet
+ * is acknowledged, if it reaches listening node with room in FIFO.
+ */
+struct nrf24l01_mesh_sim
+{
+    //! Returns 1 if packet sent by node src reaches node dst, 0 if it is lost. All nodes reach each other if 0.
+    int (*link)(void *context, uint8_t src, uint8_t dst);
+    void *context;                                 /*!< Passed to link callback */
+    struct nrf24l01_mesh_sim_radio radios[NRF24L01_MESH_SIM_RADIOS];
+
+    uint32_t packets;                              /*!< Packets sent */
+    uint32_t lost;                                 /*!< Packet receptions lost on link */
+    uint32_t overflows;                            /*!< Packet receptions dropped because FIFO was full */
+};
+
+/*! Init simulation without radios.
+ * \param sim simulation.
+ * \param link link callback, 0 if all nodes reach each other.
+ * \param context passed to link callback.
+ */
+void nrf24l01_mesh_sim_init(struct nrf24l01_mesh_sim *sim, int (*link)(void *context, uint8_t src, uint8_t dst),
+                            void *context);
+
+/*! Add radio and init mesh node on it. Node may be attached again to simulate restart.
+ * \param sim simulation.
+ * \param mesh mesh node.
+ * \param id node ID, from 1 to 254.
+ * \returns 0 on success, -ENOBUFS if there are NRF24L01_MESH_SIM_RADIOS radios already,
+ *          -EINVAL if ID is invalid.
+ */
+int nrf24l01_mesh_sim_attach(struct nrf24l01_mesh_sim *sim, struct nrf24l01_mesh *mesh, uint8_t id);
+
+/*! Remove radio of node, e.g. to simulate power loss. Node mustn't be polled afterwards.
+ * \returns 0 on success, -ENOENT if there is no radio with this ID.
+ */
+int nrf24l01_mesh_sim_detach(struct nrf24l01_mesh_sim *sim, uint8_t id);
+
+//! \} \}
+
+#endif
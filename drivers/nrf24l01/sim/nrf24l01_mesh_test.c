@@ -0,0 +1,142 @@
+#include "nrf24l01_mesh_sim.h"
+#include "bm/nrf24l01_mesh.h"
+#include "bm/delay.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+//! Nodes form a square grid, each node reaches its horizontal and vertical neighbors only.
+#define GRID 4
+#define NODES (GRID * GRID)
+
+//! Percentage of packet receptions lost on link.
+#define LOSS 5
+
+#define MESSAGES 200
+
+//! Time for routes to settle and for history of restarted node to expire, in milliseconds.
+#define SETTLE 8000
+
+static struct nrf24l01_mesh_sim sim;
+static struct nrf24l01_mesh nodes[NODES];
+
+void system_nop()
+{
+}
+
+static int grid_link(void *context, uint8_t src, uint8_t dst)
+{
+    int dx = abs((src - 1) % GRID - (dst - 1) % GRID);
+    int dy = abs((src - 1) / GRID - (dst - 1) / GRID);
+
+    (void)context;
+
+    if (dx + dy != 1)
+        return 0;
+
+    return (rand() % 100) >= LOSS;
+}
+
+//! Poll all nodes each millisecond, messages of last node are counted.
+static int run(uint32_t ms, uint32_t *received)
+{
+    struct nrf24l01_mesh_message message;
+    int status;
+
+    while (ms--)
+    {
+        tick();
+
+        for (int i = 0; i < NODES; i++)
+        {
+            status = nrf24l01_mesh_poll(&nodes[i]);
+            if (status)
+                return status;
+        }
+
+        while (!nrf24l01_mesh_receive(&nodes[NODES - 1], &message))
+            (*received)++;
+    }
+
+    return 0;
+}
+
+//! Send messages across the grid, returns number of messages lost.
+static uint32_t send_across(uint32_t count, const char *name)
+{
+    struct nrf24l01_mesh_stats *stats = &nodes[NODES - 1].stats;
+    uint32_t delivered = stats->delivered;
+    uint32_t latency = stats->latency_total;
+    uint32_t received = 0;
+    uint8_t data[4];
+    int status;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        data[0] = i;
+        data[1] = i >> 8;
+        data[2] = i >> 16;
+        data[3] = i >> 24;
+
+        status = nrf24l01_mesh_send(&nodes[0], NODES, data, sizeof(data));
+        if (!status)
+            status = run(5, &received);
+
+        if (status)
+        {
+            printf("%s: error %d\n", name, status);
+            return count;
+        }
+    }
+
+    status = run(100, &received);
+    if (status)
+    {
+        printf("%s: error %d\n", name, status);
+        return count;
+    }
+
+    delivered = stats->delivered - delivered;
+    latency = stats->latency_total - latency;
+    printf("%s: %u of %u messages received, latency %u ms average, %u ms max\n", name, (unsigned)received,
+           (unsigned)count, delivered ? (unsigned)(latency / delivered) : 0, stats->latency_max);
+
+    return count - received;
+}
+
+int main()
+{
+    uint32_t received = 0;
+    uint32_t failed = 0;
+    int status;
+
+    nrf24l01_mesh_sim_init(&sim, grid_link, 0);
+
+    for (int i = 0; i < NODES; i++)
+    {
+        status = nrf24l01_mesh_sim_attach(&sim, &nodes[i], i + 1);
+        if (status)
+        {
+            printf("attach %d: error %d\n", i + 1, status);
+            return 1;
+        }
+    }
+
+    printf("%d nodes in %dx%d grid, %d%% loss\n", NODES, GRID, GRID, LOSS);
+
+    if (run(SETTLE, &received))
+        return 1;
+
+    failed += send_across(MESSAGES, "grid");
+
+    // Restarted node begins sequence numbers again, which mustn't be taken as duplicates.
+    nrf24l01_mesh_sim_attach(&sim, &nodes[0], 1);
+    if (run(SETTLE, &received))
+        return 1;
+
+    failed += send_across(10, "restart");
+
+    printf("%u packets sent, %u receptions out of range or lost, %u dropped by full FIFO\n",
+           (unsigned)sim.packets, (unsigned)sim.lost, (unsigned)sim.overflows);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,677 @@
+#include "nrf24l01_sim.h"
+#include "bm/nrf24l01.h"
+#include "bm/delay.h"
+#include "bm/gpio.h"
+#include "bm/spi.h"
+#include <string.h>
+#include <errno.h>
+
+//! CE pin of device is its ID plus this, CS pin is ID.
+#define NRF24L01_SIM_CE 0x100
+#define NRF24L01_SIM_IRQ 0x200
+
+//! Longest command, one byte and 32-byte payload.
+#define NRF24L01_SIM_COMMAND 33
+
+//! RX_FULL of FIFO_STATUS.
+#define NRF24L01_SIM_FIFO_RX_FULL 0x02
+
+//! TX settling time in microseconds.
+#define NRF24L01_SIM_SETTLE 130
+
+static struct nrf24l01_sim *nrf24l01_sim_current;
+static struct spi_master nrf24l01_sim_master;
+
+static struct nrf24l01_sim_device *nrf24l01_sim_find(struct nrf24l01_sim *sim, uint8_t id)
+{
+    for (int i = 0; i < NRF24L01_SIM_DEVICES; i++)
+        if (sim->devices[i].id == id)
+            return &sim->devices[i];
+
+    return 0;
+}
+
+static void nrf24l01_sim_set_time(struct nrf24l01_sim *sim, uint64_t time)
+{
+    uint64_t ms = sim->time / 1000;
+
+    sim->time = time;
+
+    for (; ms < sim->time / 1000; ms++)
+        tick();
+}
+
+//! Update STATUS and FIFO_STATUS from FIFOs.
+static void nrf24l01_sim_update(struct nrf24l01_sim_device *device)
+{
+    uint8_t *registers = device->registers;
+    uint8_t pipe = device->rx_count ? device->rx[0].pipe : 7;
+
+    registers[NRF24L01_REG_STATUS] &= NRF24L01_RX_DR | NRF24L01_TX_DS | NRF24L01_MAX_RT;
+    registers[NRF24L01_REG_STATUS] |= pipe << 1;
+    if (device->tx_count == 3)
+        registers[NRF24L01_REG_STATUS] |= NRF24L01_TX_FULL;
+
+    registers[NRF24L01_REG_FIFO_STATUS] = 0;
+    if (!device->rx_count)
+        registers[NRF24L01_REG_FIFO_STATUS] |= NRF24L01_FIFO_RX_EMPTY;
+    if (device->rx_count == 3)
+        registers[NRF24L01_REG_FIFO_STATUS] |= NRF24L01_SIM_FIFO_RX_FULL;
+    if (!device->tx_count)
+        registers[NRF24L01_REG_FIFO_STATUS] |= NRF24L01_FIFO_TX_EMPTY;
+    if (device->tx_count == 3)
+        registers[NRF24L01_REG_FIFO_STATUS] |= NRF24L01_FIFO_TX_FULL;
+}
+
+static uint8_t nrf24l01_sim_address_width(struct nrf24l01_sim_device *device)
+{
+    uint8_t width = device->registers[NRF24L01_REG_SETUP_AW] & 0x3;
+
+    return width ? width + 2 : 5;
+}
+
+//! Air time of packet in microseconds, with preamble, address, control field and CRC.
+static uint32_t nrf24l01_sim_air_time(struct nrf24l01_sim_device *device, uint8_t size)
+{
+    uint8_t config = device->registers[NRF24L01_REG_CONFIG];
+    uint8_t rate = device->registers[NRF24L01_REG_RF_SETUP];
+    uint8_t crc = (config & NRF24L01_EN_CRC) ? ((config & NRF24L01_CRCO) ? 2 : 1) : 0;
+    uint32_t bits = (1 + nrf24l01_sim_address_width(device) + size + crc) * 8 + 9;
+
+    if (rate & NRF24L01_RF_DR_LOW)
+        return bits * 4;
+    if (rate & NRF24L01_RF_DR)
+        return (bits + 1) / 2;
+
+    return bits;
+}
+
+//! Returns pipe of receiver, which gets packet sent by device, or -1.
+static int nrf24l01_sim_match(struct nrf24l01_sim_device *receiver, struct nrf24l01_sim_device *device)
+{
+    const uint8_t rate = NRF24L01_RF_DR_LOW | NRF24L01_RF_DR;
+    uint8_t *registers = receiver->registers;
+    uint8_t width = nrf24l01_sim_address_width(device);
+    uint8_t address[5];
+
+    if (!receiver->ce || !(registers[NRF24L01_REG_CONFIG] & NRF24L01_PWR_UP)
+        || !(registers[NRF24L01_REG_CONFIG] & NRF24L01_PRIM_RX)
+        || (registers[NRF24L01_REG_RF_CH] != device->registers[NRF24L01_REG_RF_CH])
+        || ((registers[NRF24L01_REG_RF_SETUP] & rate) != (device->registers[NRF24L01_REG_RF_SETUP] & rate))
+        || (nrf24l01_sim_address_width(receiver) != width))
+        return -1;
+
+    for (int pipe = 0; pipe < 6; pipe++)
+    {
+        if (!(registers[NRF24L01_REG_EN_RXADDR] & (1 << pipe)))
+            continue;
+
+        memcpy(address, receiver->rx_address[pipe ? 1 : 0], 5);
+        if (pipe >= 2)
+            address[0] = registers[NRF24L01_REG_RX_ADDR_P0 + pipe];
+
+        if (!memcmp(address, device->tx_address, width))
+            return pipe;
+    }
+
+    return -1;
+}
+
+/*! Deliver packet to devices, which listen on its address.
+ * \returns device, which acknowledges packet, or 0.
+ */
+static struct nrf24l01_sim_device *nrf24l01_sim_deliver(struct nrf24l01_sim *sim, struct nrf24l01_sim_device *device,
+                                                        struct nrf24l01_sim_payload *payload, uint8_t *ack_pipe)
+{
+    struct nrf24l01_sim_device *ack = 0;
+
+    for (int i = 0; i < NRF24L01_SIM_DEVICES; i++)
+    {
+        struct nrf24l01_sim_device *receiver = &sim->devices[i];
+
+        if (!receiver->id || (receiver == device))
+            continue;
+
+        int pipe = nrf24l01_sim_match(receiver, device);
+        if (pipe < 0)
+            continue;
+
+        if (sim->link && !sim->link(sim->context, device->id, receiver->id))
+        {
+            sim->lost++;
+            continue;
+        }
+
+        int auto_ack = !payload->no_ack && (receiver->registers[NRF24L01_REG_EN_AA] & (1 << pipe));
+
+        // Retransmit of received payload is acknowledged, but not stored again.
+        if (auto_ack && (receiver->rx_src[pipe] == device->id) && (receiver->rx_pid[pipe] == device->pid))
+        {
+            ack = receiver;
+            *ack_pipe = pipe;
+            continue;
+        }
+
+        if (receiver->rx_count == 3)
+        {
+            sim->overflows++;
+            continue;
+        }
+
+        receiver->rx[receiver->rx_count] = *payload;
+        receiver->rx[receiver->rx_count].pipe = pipe;
+        receiver->rx_count++;
+        receiver->rx_src[pipe] = device->id;
+        receiver->rx_pid[pipe] = device->pid;
+        receiver->registers[NRF24L01_REG_STATUS] |= NRF24L01_RX_DR;
+        nrf24l01_sim_update(receiver);
+
+        if (auto_ack)
+        {
+            ack = receiver;
+            *ack_pipe = pipe;
+        }
+    }
+
+    return ack;
+}
+
+//! Move ACK payload queued for pipe, if there is one, from receiver to device.
+static void nrf24l01_sim_acknowledge(struct nrf24l01_sim_device *receiver, struct nrf24l01_sim_device *device,
+                                     uint8_t pipe)
+{
+    uint8_t i;
+
+    if (!(receiver->registers[NRF24L01_REG_FEATURE] & NRF24L01_EN_ACK_PAY))
+        return;
+
+    for (i = 0; (i < receiver->tx_count) && (receiver->tx[i].pipe != pipe); i++);
+
+    if (i == receiver->tx_count)
+        return;
+
+    if (device->rx_count < 3)
+    {
+        device->rx[device->rx_count] = receiver->tx[i];
+        device->rx[device->rx_count].pipe = 0;
+        device->rx_count++;
+        device->registers[NRF24L01_REG_STATUS] |= NRF24L01_RX_DR;
+    }
+
+    receiver->tx_count--;
+    memmove(&receiver->tx[i], &receiver->tx[i + 1], (receiver->tx_count - i) * sizeof(receiver->tx[0]));
+    receiver->registers[NRF24L01_REG_STATUS] |= NRF24L01_TX_DS;
+    nrf24l01_sim_update(receiver);
+}
+
+static int nrf24l01_sim_auto_ack(struct nrf24l01_sim_device *device)
+{
+    return !device->tx[0].no_ack && (device->registers[NRF24L01_REG_EN_AA] & NRF24L01_ENAA_P0);
+}
+
+//! Put attempt of head of TX FIFO on air, with ACK if one is expected.
+static void nrf24l01_sim_attempt(struct nrf24l01_sim *sim, struct nrf24l01_sim_device *device, uint32_t delay)
+{
+    uint32_t time = NRF24L01_SIM_SETTLE + nrf24l01_sim_air_time(device, device->tx[0].size);
+
+    if (nrf24l01_sim_auto_ack(device))
+        time += NRF24L01_SIM_SETTLE + nrf24l01_sim_air_time(device, 0);
+
+    device->tx_start = sim->time + delay;
+    device->tx_end = device->tx_start + time;
+}
+
+//! Start sending head of TX FIFO, if device is in TX mode and air is free of its packets.
+static void nrf24l01_sim_start(struct nrf24l01_sim *sim, struct nrf24l01_sim_device *device)
+{
+    uint8_t *registers = device->registers;
+
+    if (device->tx_end || !device->ce || !device->tx_count || (registers[NRF24L01_REG_STATUS] & NRF24L01_MAX_RT)
+        || ((registers[NRF24L01_REG_CONFIG] & (NRF24L01_PWR_UP | NRF24L01_PRIM_RX)) != NRF24L01_PWR_UP))
+        return;
+
+    device->pid = (device->pid + 1) & 0x3;
+    device->attempt = 0;
+    nrf24l01_sim_attempt(sim, device, 0);
+}
+
+//! Returns 1 if other device was on air on the same channel during attempt of device.
+static int nrf24l01_sim_collision(struct nrf24l01_sim *sim, struct nrf24l01_sim_device *device)
+{
+    for (int i = 0; i < NRF24L01_SIM_DEVICES; i++)
+    {
+        struct nrf24l01_sim_device *other = &sim->devices[i];
+
+        if (!other->id || (other == device)
+            || (other->registers[NRF24L01_REG_RF_CH] != device->registers[NRF24L01_REG_RF_CH]))
+            continue;
+
+        if (other->tx_end && (other->tx_start < device->tx_end) && (device->tx_start < other->tx_end))
+            return 1;
+
+        if ((other->air_start < device->tx_end) && (device->tx_start < other->air_end))
+            return 1;
+    }
+
+    return 0;
+}
+
+//! Attempt of device is over, deliver packet, then retransmit or finish it.
+static void nrf24l01_sim_finish(struct nrf24l01_sim *sim, struct nrf24l01_sim_device *device)
+{
+    uint8_t *registers = device->registers;
+    uint8_t retransmits = registers[NRF24L01_REG_SETUP_RETR] & 0xF;
+    uint32_t delay = ((registers[NRF24L01_REG_SETUP_RETR] >> 4) + 1) * 250;
+    struct nrf24l01_sim_device *receiver = 0;
+    uint8_t pipe = 0;
+    int collision;
+
+    collision = nrf24l01_sim_collision(sim, device);
+    device->air_start = device->tx_start;
+    device->air_end = device->tx_end;
+    device->tx_end = 0;
+
+    // Payload was flushed or device was powered down on air.
+    if (!device->tx_count || !(registers[NRF24L01_REG_CONFIG] & NRF24L01_PWR_UP))
+        return;
+
+    sim->packets++;
+    sim->bytes += device->tx[0].size;
+
+    if (collision)
+        sim->collisions++;
+    else
+        receiver = nrf24l01_sim_deliver(sim, device, &device->tx[0], &pipe);
+
+    registers[NRF24L01_REG_OBSERVE_TX] = (registers[NRF24L01_REG_OBSERVE_TX] & NRF24L01_PLOS_CNT) | device->attempt;
+
+    // ACK crosses link back to device.
+    if (!nrf24l01_sim_auto_ack(device) ||
+        (receiver && (!sim->link || sim->link(sim->context, receiver->id, device->id))))
+    {
+        if (receiver)
+            nrf24l01_sim_acknowledge(receiver, device, pipe);
+
+        device->tx_count--;
+        memmove(&device->tx[0], &device->tx[1], device->tx_count * sizeof(device->tx[0]));
+        registers[NRF24L01_REG_STATUS] |= NRF24L01_TX_DS;
+    }
+    else if (device->attempt < retransmits)
+    {
+        device->attempt++;
+        nrf24l01_sim_attempt(sim, device, delay);
+    }
+    else
+    {
+        // Payload stays in FIFO until MAX_RT is cleared.
+        if ((registers[NRF24L01_REG_OBSERVE_TX] & NRF24L01_PLOS_CNT) != NRF24L01_PLOS_CNT)
+            registers[NRF24L01_REG_OBSERVE_TX] += 0x10;
+        registers[NRF24L01_REG_STATUS] |= NRF24L01_MAX_RT;
+    }
+
+    nrf24l01_sim_update(device);
+}
+
+static void nrf24l01_sim_air(struct nrf24l01_sim *sim)
+{
+    for (int i = 0; i < NRF24L01_SIM_DEVICES; i++)
+        if (sim->devices[i].id)
+            nrf24l01_sim_start(sim, &sim->devices[i]);
+}
+
+void nrf24l01_sim_advance(struct nrf24l01_sim *sim, uint32_t us)
+{
+    uint64_t time = sim->time + us;
+
+    // Attempts, which end meanwhile, are finished in order.
+    for (;;)
+    {
+        struct nrf24l01_sim_device *next = 0;
+
+        for (int i = 0; i < NRF24L01_SIM_DEVICES; i++)
+        {
+            struct nrf24l01_sim_device *device = &sim->devices[i];
+
+            if (device->tx_end && (device->tx_end <= time) && (!next || (device->tx_end < next->tx_end)))
+                next = device;
+        }
+
+        if (!next)
+            break;
+
+        nrf24l01_sim_set_time(sim, next->tx_end);
+        nrf24l01_sim_finish(sim, next);
+        nrf24l01_sim_start(sim, next);
+    }
+
+    nrf24l01_sim_set_time(sim, time);
+}
+
+static void nrf24l01_sim_write_register(struct nrf24l01_sim_device *device, uint8_t reg, const uint8_t *data,
+                                        uint8_t size)
+{
+    if (!size)
+        return;
+
+    switch (reg)
+    {
+    case NRF24L01_REG_RX_ADDR_P0:
+    case NRF24L01_REG_RX_ADDR_P1:
+        memcpy(device->rx_address[reg - NRF24L01_REG_RX_ADDR_P0], data, size > 5 ? 5 : size);
+        break;
+    case NRF24L01_REG_TX_ADDR:
+        memcpy(device->tx_address, data, size > 5 ? 5 : size);
+        break;
+    case NRF24L01_REG_STATUS:
+        device->registers[reg] &= ~(data[0] & (NRF24L01_RX_DR | NRF24L01_TX_DS | NRF24L01_MAX_RT));
+        break;
+    case NRF24L01_REG_OBSERVE_TX:
+    case NRF24L01_REG_CD:
+    case NRF24L01_REG_FIFO_STATUS:
+        break;
+    case NRF24L01_REG_RF_CH:
+        // Writing channel resets lost packet count.
+        device->registers[NRF24L01_REG_OBSERVE_TX] &= NRF24L01_ARC_CNT;
+        device->registers[reg] = data[0] & 0x7F;
+        break;
+    default:
+        if (reg < sizeof(device->registers))
+            device->registers[reg] = data[0];
+        break;
+    }
+}
+
+static void nrf24l01_sim_read_register(struct nrf24l01_sim_device *device, uint8_t reg, uint8_t *data, uint8_t size)
+{
+    switch (reg)
+    {
+    case NRF24L01_REG_RX_ADDR_P0:
+    case NRF24L01_REG_RX_ADDR_P1:
+        memcpy(data, device->rx_address[reg - NRF24L01_REG_RX_ADDR_P0], size > 5 ? 5 : size);
+        break;
+    case NRF24L01_REG_TX_ADDR:
+        memcpy(data, device->tx_address, size > 5 ? 5 : size);
+        break;
+    default:
+        memset(data, device->registers[reg], size);
+        break;
+    }
+}
+
+static void nrf24l01_sim_queue(struct nrf24l01_sim_device *device, const uint8_t *data, uint8_t size, uint8_t pipe,
+                               uint8_t no_ack)
+{
+    struct nrf24l01_sim_payload *payload;
+
+    if ((device->tx_count == 3) || (size == 0) || (size > 32))
+        return;
+
+    payload = &device->tx[device->tx_count++];
+    payload->pipe = pipe;
+    payload->no_ack = no_ack && (device->registers[NRF24L01_REG_FEATURE] & NRF24L01_EN_DYN_ACK);
+    payload->size = size;
+    memcpy(payload->data, data, size);
+}
+
+//! Run command, STATUS is clocked out first.
+static void nrf24l01_sim_command(struct nrf24l01_sim_device *device, const uint8_t *in, uint8_t *out, uint8_t size)
+{
+    uint8_t command = in[0];
+
+    memset(out, 0, size);
+    out[0] = device->registers[NRF24L01_REG_STATUS];
+
+    if (command < NRF24L01_CMD_W_REGISTER)
+    {
+        nrf24l01_sim_read_register(device, command & 0x1F, out + 1, size - 1);
+        return;
+    }
+
+    if (command < NRF24L01_CMD_ACTIVATE)
+    {
+        nrf24l01_sim_write_register(device, command & 0x1F, in + 1, size - 1);
+        nrf24l01_sim_update(device);
+        return;
+    }
+
+    switch (command)
+    {
+    case NRF24L01_CMD_R_RX_PAYLOAD:
+        if (!device->rx_count)
+            break;
+        memcpy(out + 1, device->rx[0].data, (size - 1 > device->rx[0].size) ? device->rx[0].size : size - 1);
+        device->rx_count--;
+        memmove(&device->rx[0], &device->rx[1], device->rx_count * sizeof(device->rx[0]));
+        break;
+    case NRF24L01_CMD_R_RX_PL_WID:
+        if (size > 1)
+            out[1] = device->rx_count ? device->rx[0].size : 0;
+        break;
+    case NRF24L01_CMD_W_TX_PAYLOAD:
+        nrf24l01_sim_queue(device, in + 1, size - 1, 0, 0);
+        break;
+    case NRF24L01_CMD_W_TX_PAYLOAD_NO_ACK:
+        nrf24l01_sim_queue(device, in + 1, size - 1, 0, 1);
+        break;
+    case NRF24L01_CMD_FLUSH_TX:
+        device->tx_count = 0;
+        break;
+    case NRF24L01_CMD_FLUSH_RX:
+        device->rx_count = 0;
+        break;
+    default:
+        // ACTIVATE is ignored, as by nRF24L01+, which has features always available.
+        if ((command & 0xF8) == NRF24L01_CMD_W_ACK_PAYLOAD)
+            nrf24l01_sim_queue(device, in + 1, size - 1, command & 0x7, 0);
+        break;
+    }
+
+    nrf24l01_sim_update(device);
+}
+
+void nrf24l01_sim_init(struct nrf24l01_sim *sim, int (*link)(void *context, uint8_t src, uint8_t dst),
+                       void *context)
+{
+    memset(sim, 0, sizeof(*sim));
+    sim->link = link;
+    sim->context = context;
+
+    nrf24l01_sim_current = sim;
+}
+
+static void nrf24l01_sim_task_entry()
+{
+    struct nrf24l01_sim_task *task = nrf24l01_sim_current->current;
+
+    task->entry(task->arg);
+    task->done = 1;
+}
+
+int nrf24l01_sim_spawn(struct nrf24l01_sim *sim, struct nrf24l01_sim_task *task, void (*entry)(void *arg), void *arg)
+{
+    if (sim->task_count == NRF24L01_SIM_TASKS)
+        return -ENOBUFS;
+
+    task->entry = entry;
+    task->arg = arg;
+    task->done = 0;
+
+    getcontext(&task->context);
+    task->context.uc_stack.ss_sp = task->stack;
+    task->context.uc_stack.ss_size = sizeof(task->stack);
+    task->context.uc_link = &sim->main;
+    makecontext(&task->context, nrf24l01_sim_task_entry, 0);
+
+    sim->tasks[sim->task_count++] = task;
+    return 0;
+}
+
+void nrf24l01_sim_run(struct nrf24l01_sim *sim)
+{
+    uint8_t running;
+
+    do
+    {
+        running = 0;
+
+        for (uint8_t i = 0; i < sim->task_count; i++)
+        {
+            if (sim->tasks[i]->done)
+                continue;
+
+            sim->current = sim->tasks[i];
+            swapcontext(&sim->main, &sim->current->context);
+            sim->current = 0;
+            running = 1;
+        }
+
+        nrf24l01_sim_advance(sim, NRF24L01_SIM_NOP_TIME);
+    }
+    while (running);
+
+    sim->task_count = 0;
+}
+
+int nrf24l01_sim_attach(struct nrf24l01_sim *sim, struct nrf24l01 *device, uint8_t id)
+{
+    struct nrf24l01_sim_device *sim_device;
+
+    if (!id || nrf24l01_sim_find(sim, id))
+        return -EINVAL;
+
+    sim_device = nrf24l01_sim_find(sim, 0);
+    if (!sim_device)
+        return -ENOBUFS;
+
+    memset(sim_device, 0, sizeof(*sim_device));
+    sim_device->id = id;
+
+    // Reset values.
+    sim_device->registers[NRF24L01_REG_CONFIG] = NRF24L01_EN_CRC;
+    sim_device->registers[NRF24L01_REG_EN_AA] = 0x3F;
+    sim_device->registers[NRF24L01_REG_EN_RXADDR] = NRF24L01_ERX_P0 | NRF24L01_ERX_P1;
+    sim_device->registers[NRF24L01_REG_SETUP_AW] = 0x03;
+    sim_device->registers[NRF24L01_REG_SETUP_RETR] = 0x03;
+    sim_device->registers[NRF24L01_REG_RF_CH] = 0x02;
+    sim_device->registers[NRF24L01_REG_RF_SETUP] = 0x0F;
+    for (int pipe = 2; pipe < 6; pipe++)
+        sim_device->registers[NRF24L01_REG_RX_ADDR_P0 + pipe] = 0xC1 + pipe;
+    memset(sim_device->rx_address[0], 0xE7, 5);
+    memset(sim_device->rx_address[1], 0xC2, 5);
+    memset(sim_device->tx_address, 0xE7, 5);
+    nrf24l01_sim_update(sim_device);
+
+    return nrf24l01_init_struct(&nrf24l01_sim_master, id, NRF24L01_SIM_CE + id, NRF24L01_SIM_IRQ + id, device);
+}
+
+int spi_sync(struct spi_client *client, struct spi_message *messages, int num)
+{
+    struct nrf24l01_sim *sim = nrf24l01_sim_current;
+    struct nrf24l01_sim_device *device;
+    uint8_t in[NRF24L01_SIM_COMMAND];
+    uint8_t out[NRF24L01_SIM_COMMAND];
+    uint16_t size = 0;
+    uint16_t offset = 0;
+    int i;
+
+    if (!sim || !client->chip_select || (client->chip_select > 0xFF))
+        return -ENODEV;
+
+    device = nrf24l01_sim_find(sim, client->chip_select);
+    if (!device)
+        return -ENODEV;
+
+    for (i = 0; i < num; i++)
+    {
+        if (size + messages[i].len > sizeof(in))
+            return -EINVAL;
+
+        if (messages[i].tx_buf)
+            memcpy(in + size, messages[i].tx_buf, messages[i].len);
+        else
+            memset(in + size, 0, messages[i].len);
+
+        size += messages[i].len;
+    }
+
+    if (!size)
+        return 0;
+
+    nrf24l01_sim_command(device, in, out, size);
+
+    for (i = 0; i < num; i++)
+    {
+        if (messages[i].rx_buf)
+            memcpy(messages[i].rx_buf, out + offset, messages[i].len);
+
+        offset += messages[i].len;
+        nrf24l01_sim_advance(sim, messages[i].delay_usecs);
+    }
+
+    // 8 MHz SCK.
+    nrf24l01_sim_advance(sim, size);
+    nrf24l01_sim_air(sim);
+
+    return 0;
+}
+
+int spi_init(struct spi_master *master)
+{
+    (void)master;
+    return 0;
+}
+
+int gpio_request_one(uint16_t gpio, uint8_t flags)
+{
+    (void)gpio;
+    (void)flags;
+    return 0;
+}
+
+int gpio_free_one(uint16_t gpio)
+{
+    (void)gpio;
+    return 0;
+}
+
+void gpio_set_value(uint16_t gpio, int value)
+{
+    struct nrf24l01_sim *sim = nrf24l01_sim_current;
+    struct nrf24l01_sim_device *device;
+
+    if (!sim || (gpio <= NRF24L01_SIM_CE) || (gpio > NRF24L01_SIM_CE + 0xFF))
+        return;
+
+    device = nrf24l01_sim_find(sim, gpio - NRF24L01_SIM_CE);
+    if (!device)
+        return;
+
+    device->ce = value ? 1 : 0;
+    nrf24l01_sim_air(sim);
+}
+
+int gpio_get_value(uint16_t gpio)
+{
+    (void)gpio;
+    return 1;
+}
+
+void delay_us(uint16_t uS)
+{
+    if (nrf24l01_sim_current)
+        nrf24l01_sim_advance(nrf24l01_sim_current, uS);
+}
+
+void system_nop()
+{
+    struct nrf24l01_sim *sim = nrf24l01_sim_current;
+
+    if (!sim)
+        return;
+
+    // Time passes when all tasks had their turn.
+    if (sim->current)
+        swapcontext(&sim->current->context, &sim->main);
+    else
+        nrf24l01_sim_advance(sim, NRF24L01_SIM_NOP_TIME);
+}
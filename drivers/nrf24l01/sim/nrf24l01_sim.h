@@ -0,0 +1,144 @@
+#ifndef BAREMETAL_NRF24L01_SIM_H
+#define BAREMETAL_NRF24L01_SIM_H
+
+/*!
+ * \defgroup drivers Drivers - Device drivers
+ * \{
+ * \defgroup nrf24l01_sim NRF24L01 simulation - Simulated devices behind SPI for host tests
+ * \{
+ */
+
+#include <stdint.h>
+#include <ucontext.h>
+#include <bm/nrf24l01.h>
+
+//! Maximum number of devices in simulation.
+#ifndef NRF24L01_SIM_DEVICES
+#define NRF24L01_SIM_DEVICES 32
+#endif
+
+//! Maximum number of tasks in simulation.
+#ifndef NRF24L01_SIM_TASKS
+#define NRF24L01_SIM_TASKS 33
+#endif
+
+//! Stack size of task.
+#ifndef NRF24L01_SIM_STACK
+#define NRF24L01_SIM_STACK 65536
+#endif
+
+//! Simulated time in microseconds, which passes while every task calls system_nop() once.
+#ifndef NRF24L01_SIM_NOP_TIME
+#define NRF24L01_SIM_NOP_TIME 10
+#endif
+
+//! Payload in FIFO of simulated device.
+struct nrf24l01_sim_payload
+{
+    uint8_t pipe;                                  /*!< RX pipe, or pipe of ACK payload */
+    uint8_t no_ack;                                /*!< Sent without ACK */
+    uint8_t size;
+    uint8_t data[32];
+};
+
+//! Simulated device, registers and FIFOs as seen over SPI.
+struct nrf24l01_sim_device
+{
+    uint8_t id;                                    /*!< Device ID, 0 if device is free */
+    uint8_t ce;                                    /*!< CE pin level */
+    uint8_t registers[0x20];
+    uint8_t rx_address[2][5];                      /*!< Full addresses of pipe 0 and 1 */
+    uint8_t tx_address[5];
+    uint8_t pid;                                   /*!< Packet ID of last sent payload */
+    uint8_t attempt;                               /*!< Retransmits of payload on air */
+    uint64_t tx_start;                             /*!< Time, when attempt on air started */
+    uint64_t tx_end;                               /*!< Time, when attempt on air ends, 0 if there is none */
+    uint64_t air_start;                            /*!< Start of last finished attempt */
+    uint64_t air_end;                              /*!< End of last finished attempt */
+    uint8_t rx_pid[6];                             /*!< Packet ID of last received payload per pipe */
+    uint8_t rx_src[6];                             /*!< Sender of last received payload per pipe */
+    uint8_t rx_count;
+    uint8_t tx_count;
+    struct nrf24l01_sim_payload rx[3];
+    struct nrf24l01_sim_payload tx[3];
+};
+
+/*!
+ * Task of simulation, e.g. firmware of one device. Tasks run in turn, each one until it
+ * calls system_nop(), as with cooperative RTOS.
+ */
+struct nrf24l01_sim_task
+{
+    ucontext_t context;
+    void (*entry)(void *arg);
+    void *arg;                                     /*!< Passed to entry */
+    uint8_t done;                                  /*!< Entry has returned */
+    uint8_t stack[NRF24L01_SIM_STACK];
+};
+
+/*!
+ * Air shared by simulated devices, all of one host process. Devices are attached to
+ * struct nrf24l01 and driven by the driver through spi_sync() and gpio_set_value(),
+ * which the simulation implements together with system_nop() and delay_us().
+ * Simulated time advances with SPI transfers, air time of packets and busy waiting,
+ * get_tick_count() follows it through tick(). Packet is on air for its air time after
+ * device enters TX mode, with retransmits and ACK payloads as configured, and is lost
+ * if other device sends on the same channel meanwhile. Payload length is always taken
+ * from the packet. Devices are usually driven by tasks, so each one waits in its own
+ * busy loops while others run.
+ */
+struct nrf24l01_sim
+{
+    //! Returns 1 if packet sent by device src reaches device dst, 0 if it is lost. All devices reach each other if 0.
+    int (*link)(void *context, uint8_t src, uint8_t dst);
+    void *context;                                 /*!< Passed to link callback */
+    uint64_t time;                                 /*!< Simulated time in microseconds */
+    struct nrf24l01_sim_device devices[NRF24L01_SIM_DEVICES];
+
+    ucontext_t main;                               /*!< Context of nrf24l01_sim_run() */
+    struct nrf24l01_sim_task *tasks[NRF24L01_SIM_TASKS];
+    struct nrf24l01_sim_task *current;             /*!< Running task, 0 outside of tasks */
+    uint8_t task_count;
+
+    uint32_t packets;                              /*!< Packets sent, including retransmits */
+    uint32_t bytes;                                /*!< Payload bytes sent, including retransmits */
+    uint32_t lost;                                 /*!< Packet receptions lost on link */
+    uint32_t collisions;                           /*!< Packets lost because other device was on air */
+    uint32_t overflows;                            /*!< Packets dropped because RX FIFO was full */
+};
+
+/*! Init simulation without devices and tasks and make it the one driven by SPI and GPIO calls.
+ * \param sim simulation.
+ * \param link link callback, 0 if all devices reach each other.
+ * \param context passed to link callback.
+ */
+void nrf24l01_sim_init(struct nrf24l01_sim *sim, int (*link)(void *context, uint8_t src, uint8_t dst),
+                       void *context);
+
+/*! Add device with registers in reset state and init device structure for it.
+ * \param sim simulation.
+ * \param device device.
+ * \param id device ID, from 1 to 255.
+ * \returns 0 on success, -ENOBUFS if there are NRF24L01_SIM_DEVICES devices already,
+ *          -EINVAL if ID is invalid or used.
+ */
+int nrf24l01_sim_attach(struct nrf24l01_sim *sim, struct nrf24l01 *device, uint8_t id);
+
+/*! Add task, which is started by nrf24l01_sim_run().
+ * \param sim simulation.
+ * \param task task, valid until simulation is run.
+ * \param entry task function.
+ * \param arg passed to entry.
+ * \returns 0 on success, -ENOBUFS if there are NRF24L01_SIM_TASKS tasks already.
+ */
+int nrf24l01_sim_spawn(struct nrf24l01_sim *sim, struct nrf24l01_sim_task *task, void (*entry)(void *arg), void *arg);
+
+//! Run tasks until all of them return, tasks are removed afterwards.
+void nrf24l01_sim_run(struct nrf24l01_sim *sim);
+
+//! Advance simulated time, get_tick_count() is incremented for each millisecond passed.
+void nrf24l01_sim_advance(struct nrf24l01_sim *sim, uint32_t us);
+
+//! \} \}
+
+#endif
@@ -0,0 +1,238 @@
+#include "nrf24l01_sim.h"
+#include "bm/nrf24l01_tdma.h"
+#include "bm/delay.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define NODES_MAX 16
+
+//! Slot length in milliseconds, fits a few payloads.
+#define SLOT_TIME 4
+
+//! Percentage of packet receptions lost on link.
+#define LOSS 2
+
+//! Messages sent by each node, next one is ready as soon as previous one is sent.
+#define MESSAGES 20
+
+//! Message size, two payloads.
+#define MESSAGE 64
+
+static const uint8_t hub_address[5] = {0xE1, 0xB5, 0xB5, 0xB5, 0xB5};
+
+static struct nrf24l01_sim sim;
+
+static struct nrf24l01 hub_device;
+static struct nrf24l01_tdma hub;
+static struct nrf24l01_sim_task hub_task;
+
+static struct nrf24l01 node_devices[NODES_MAX];
+static struct nrf24l01_tdma nodes[NODES_MAX];
+static struct nrf24l01_sim_task node_tasks[NODES_MAX];
+static int node_status[NODES_MAX];
+
+static uint8_t node_count;
+static uint8_t nodes_done;
+static int hub_status;
+
+//! Payloads received by hub, per node.
+static uint32_t received[NODES_MAX];
+static uint32_t latency_total;
+static uint32_t latency_max;
+
+static int loss_link(void *context, uint8_t src, uint8_t dst)
+{
+    (void)context;
+    (void)src;
+    (void)dst;
+
+    return (rand() % 100) >= LOSS;
+}
+
+//! Payload is node index and hub time, when message was ready.
+static int hub_receive()
+{
+    struct nrf24l01_frame frame;
+    uint32_t stamp, latency;
+    int status;
+
+    while (!(status = nrf24l01_tdma_poll(&hub, &frame)))
+    {
+        if ((frame.size < 5) || (frame.data[0] >= node_count))
+            continue;
+
+        stamp = frame.data[1] | (frame.data[2] << 8) | (frame.data[3] << 16) | ((uint32_t)frame.data[4] << 24);
+        latency = (uint32_t)get_tick_count() - stamp;
+
+        received[frame.data[0]]++;
+        latency_total += latency;
+        if (latency > latency_max)
+            latency_max = latency;
+    }
+
+    return (status == -EAGAIN) ? 0 : status;
+}
+
+static void hub_run(void *arg)
+{
+    (void)arg;
+
+    while (!hub_status && (nodes_done < node_count))
+    {
+        hub_status = hub_receive();
+        system_nop();
+    }
+}
+
+static void node_run(void *arg)
+{
+    uint8_t index = (struct nrf24l01_tdma *)arg - nodes;
+    struct nrf24l01_tdma *node = arg;
+    uint8_t data[MESSAGE];
+    int status;
+
+    status = nrf24l01_tdma_sync(node, 1000);
+
+    for (int i = 0; !status && (i < MESSAGES); i++)
+    {
+        uint32_t stamp = nrf24l01_tdma_time(node);
+
+        for (int offset = 0; offset < MESSAGE; offset += 32)
+        {
+            memset(data + offset, 0, 32);
+            data[offset] = index;
+            data[offset + 1] = stamp;
+            data[offset + 2] = stamp >> 8;
+            data[offset + 3] = stamp >> 16;
+            data[offset + 4] = stamp >> 24;
+        }
+
+        // Payloads which reached MAX_RT are counted as lost.
+        status = nrf24l01_tdma_send(node, data, MESSAGE);
+        if (status == -ETIMEDOUT)
+            status = 0;
+    }
+
+    node_status[index] = status;
+    nodes_done++;
+}
+
+static int setup_device(struct nrf24l01 *device, uint8_t id)
+{
+    int status;
+
+    status = nrf24l01_sim_attach(&sim, device, id);
+    if (status)
+        return status;
+
+    status = nrf24l01_enable_dynamic_size(device);
+    if (status)
+        return status;
+
+    status = nrf24l01_enable_dynamic_pipe_size(device, 0x3F);
+    if (status)
+        return status;
+
+    // Payload is started up to NRF24L01_TDMA_GUARD before slot end, so it has no time for retransmits.
+    status = nrf24l01_setup_retransmit(device, 0, 0);
+    if (status)
+        return status;
+
+    return nrf24l01_power_up(device);
+}
+
+/*! Run hub and nodes, each node in its own task.
+ * \returns 0 if nodes kept to their slots, 1 otherwise.
+ */
+static int run(uint8_t count)
+{
+    const uint32_t sent = count * MESSAGES * (MESSAGE / 32);
+    uint8_t address[5];
+    uint32_t total = 0;
+    uint64_t start;
+    int status;
+
+    node_count = count;
+    nodes_done = 0;
+    hub_status = 0;
+    memset(received, 0, sizeof(received));
+    latency_total = 0;
+    latency_max = 0;
+
+    nrf24l01_sim_init(&sim, loss_link, 0);
+    memcpy(address, hub_address, 5);
+
+    status = setup_device(&hub_device, 1);
+    if (!status)
+        status = nrf24l01_tdma_hub_init(&hub, &hub_device, address, count, SLOT_TIME);
+    if (!status)
+        status = nrf24l01_sim_spawn(&sim, &hub_task, hub_run, 0);
+
+    for (uint8_t i = 0; !status && (i < count); i++)
+    {
+        status = setup_device(&node_devices[i], i + 2);
+        if (!status)
+            status = nrf24l01_tdma_node_init(&nodes[i], &node_devices[i], address, i);
+        if (!status)
+            status = nrf24l01_sim_spawn(&sim, &node_tasks[i], node_run, &nodes[i]);
+    }
+
+    if (status)
+    {
+        printf("%2u nodes: setup error %d\n", count, status);
+        return 1;
+    }
+
+    start = get_tick_count();
+    nrf24l01_sim_run(&sim);
+
+    // Last slot is over, hub reads what is left.
+    if (!hub_status)
+        hub_status = hub_receive();
+
+    if (hub_status)
+    {
+        printf("%2u nodes: hub error %d\n", count, hub_status);
+        return 1;
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (node_status[i])
+        {
+            printf("%2u nodes: node %u error %d\n", count, i, node_status[i]);
+            return 1;
+        }
+
+        if (received[i] > MESSAGES * (MESSAGE / 32))
+        {
+            printf("%2u nodes: node %u payloads received twice\n", count, i);
+            return 1;
+        }
+
+        total += received[i];
+    }
+
+    uint32_t elapsed = get_tick_count() - start;
+
+    printf("%2u nodes: %4u of %4u payloads, %5u B/s, latency %3u ms average, %3u ms max, %u collisions\n",
+           count, (unsigned)total, (unsigned)sent, (unsigned)(total * 32 * 1000 / elapsed),
+           total ? (unsigned)(latency_total / total) : 0, (unsigned)latency_max, (unsigned)sim.collisions);
+
+    // Payloads are lost on link, but never because nodes sent at the same time.
+    return sim.collisions ? 1 : 0;
+}
+
+int main()
+{
+    int failed = 0;
+
+    printf("TDMA, %d ms slots, %d%% loss, %d-byte messages\n", SLOT_TIME, LOSS, MESSAGE);
+
+    for (uint8_t count = 1; count <= NODES_MAX; count *= 2)
+        failed += run(count);
+
+    return failed ? 1 : 0;
+}
@@ -1,8 +1,12 @@
 #include "bm/sst25.h"
 #include "bm/spi.h"
 #include "bm/delay.h"
+#include <string.h>
 #include <errno.h>
 
+#define SST25_COMPARE_CHUNK 32
+#define SST25_PROGRAM_GAP 4
+
 int sst25_init_struct(struct spi_master* master, uint16_t cs_gpio, struct sst25 *sst25)
 {
     sst25->spi.master = master;
@@ -88,7 +92,7 @@ int sst25_wait_for_ready(struct sst25 *sst25, int timeout)
     return 0;
 }
 
-int sst25_erase(struct sst25 *sst25, uint16_t addr, int type)
+int sst25_erase_start(struct sst25 *sst25, uint16_t addr, int type)
 {
     uint32_t realaddr;
     uint8_t op;
@@ -129,10 +133,11 @@ int sst25_erase(struct sst25 *sst25, uint16_t addr, int type)
         .delay_usecs = 0
     };
 
-    status = spi_sync(&sst25->spi, &message, 1);
-    if (status)
-        return status;
+    return spi_sync(&sst25->spi, &message, 1);
+}
 
+int sst25_wait_for_erase(struct sst25 *sst25, int type)
+{
     int timeout = 0;
 
     switch (type)
@@ -142,16 +147,26 @@ int sst25_erase(struct sst25 *sst25, uint16_t addr, int type)
         break;
     case SST25_ERASE_32K:
     case SST25_ERASE_64K:
-        timeout = SST25_TIMEOUT_BLOCK_ERASE;
         timeout = SST25_TIMEOUT_BLOCK_ERASE;
         break;
     case SST25_ERASE_CHIP:
         timeout = SST25_TIMEOUT_CHIP_ERASE;
         break;
+    default:
+        return -EINVAL;
     }
     return sst25_wait_for_ready(sst25, timeout);
 }
 
+int sst25_erase(struct sst25 *sst25, uint16_t addr, int type)
+{
+    int status = sst25_erase_start(sst25, addr, type);
+    if (status)
+        return status;
+
+    return sst25_wait_for_erase(sst25, type);
+}
+
 
 int sst25_read_data(struct sst25 *sst25, uint32_t addr, uint8_t *data, uint16_t size)
 {
@@ -178,44 +193,18 @@ int sst25_read_data(struct sst25 *sst25, uint32_t addr, uint8_t *data, uint16_t
     return spi_sync(&sst25->spi, messages, 2);
 }
 
-int sst25_write_data(struct sst25 *sst25, uint32_t addr, uint8_t *data, uint16_t size)
+static int sst25_program_byte(struct sst25 *sst25, uint32_t addr, uint8_t data)
 {
-    if (!size)
-        return 0;
-
     int status = sst25_write_enable(sst25);
     if (status)
         return status;
 
-    uint16_t start = 0;
-    if ((addr & 0x1) || (size == 1))
-    {
-        char command[5] = {SST25_OP_BYTE_PROGRAM, (addr >> 16) & 0xFF, (addr >> 8) & 0xFF, (addr) & 0xFF, data[0]};
-        struct spi_message message =
-        {
-            .tx_buf = command,
-            .rx_buf = 0,
-            .len = 5,
-            .cs_change = 0,
-            .delay_usecs = 0
-        };
-        start = 1;
-        int status = spi_sync(&sst25->spi, &message, 1);
-        if (status)
-            return status;
-
-        delay_us(10);
-    }
-    if (size - start == 0)
-        return 0;
-
-    uint32_t waddr = addr + start;
-    char command[6] = {SST25_OP_AAI_WORD_PROGRAM, (waddr >> 16) & 0xFF, (waddr >> 8) & 0xFF, (waddr) & 0xFF, data[start], data[start + 1]};
+    char command[5] = {SST25_OP_BYTE_PROGRAM, (addr >> 16) & 0xFF, (addr >> 8) & 0xFF, (addr) & 0xFF, data};
     struct spi_message message =
     {
         .tx_buf = command,
         .rx_buf = 0,
-        .len = 6,
+        .len = 5,
         .cs_change = 0,
         .delay_usecs = 0
     };
@@ -223,23 +212,68 @@ int sst25_write_data(struct sst25 *sst25, uint32_t addr, uint8_t *data, uint16_t
     if (status)
         return status;
 
-    status = sst25_wait_for_ready(sst25, 1);
+    delay_us(10);
+    return 0;
+}
+
+int sst25_aai_start(struct sst25 *sst25, uint32_t addr, const uint8_t *word)
+{
+    int status = sst25_write_enable(sst25);
     if (status)
         return status;
 
-    int sended = start + 2;
-    for (int i = 1; i < (size - start) / 2; i++)
+    char command[6] = {SST25_OP_AAI_WORD_PROGRAM, (addr >> 16) & 0xFF, (addr >> 8) & 0xFF, (addr) & 0xFF, word[0], word[1]};
+    struct spi_message message =
     {
-        char command[3] = {SST25_OP_AAI_WORD_PROGRAM, data[start + i * 2], data[start + i * 2 + 1]};
-        struct spi_message message =
-        {
-            .tx_buf = command,
-            .rx_buf = 0,
-            .len = 3,
-            .cs_change = 0,
-            .delay_usecs = 0
-        };
-        int status = spi_sync(&sst25->spi, &message, 1);
+        .tx_buf = command,
+        .rx_buf = 0,
+        .len = 6,
+        .cs_change = 0,
+        .delay_usecs = 0
+    };
+    return spi_sync(&sst25->spi, &message, 1);
+}
+
+int sst25_aai_next(struct sst25 *sst25, const uint8_t *word)
+{
+    char command[3] = {SST25_OP_AAI_WORD_PROGRAM, word[0], word[1]};
+    struct spi_message message =
+    {
+        .tx_buf = command,
+        .rx_buf = 0,
+        .len = 3,
+        .cs_change = 0,
+        .delay_usecs = 0
+    };
+    return spi_sync(&sst25->spi, &message, 1);
+}
+
+int sst25_aai_end(struct sst25 *sst25)
+{
+    // WRDI terminates AAI sequence.
+    return sst25_write_disable(sst25);
+}
+
+int sst25_write_data(struct sst25 *sst25, uint32_t addr, uint8_t *data, uint16_t size)
+{
+    if (!size)
+        return 0;
+
+    int status;
+    uint16_t start = 0;
+    if (addr & 0x1)
+    {
+        status = sst25_program_byte(sst25, addr, data[0]);
+        if (status)
+            return status;
+
+        start = 1;
+    }
+
+    uint16_t words = (size - start) / 2;
+    if (words)
+    {
+        status = sst25_aai_start(sst25, addr + start, data + start);
         if (status)
             return status;
 
@@ -247,28 +281,134 @@ int sst25_write_data(struct sst25 *sst25, uint32_t addr, uint8_t *data, uint16_t
         if (status)
             return status;
 
-        sended += 2;
+        for (int i = 1; i < words; i++)
+        {
+            status = sst25_aai_next(sst25, data + start + i * 2);
+            if (status)
+                return status;
+
+            status = sst25_wait_for_ready(sst25, 1);
+            if (status)
+                return status;
+        }
+
+        status = sst25_aai_end(sst25);
+        if (status)
+            return status;
     }
-    if (size - sended > 0)
+
+    if ((size - start) & 0x1)
+        return sst25_program_byte(sst25, addr + size - 1, data[size - 1]);
+
+    return 0;
+}
+
+/*!
+ * Program changed bytes of range. Nearby runs are merged, bytes between them are
+ * programmed with their current value, that doesn't change flash.
+ * \returns 1 if range can't be written without erase, 0 on success, negative error code otherwise.
+ */
+static int sst25_program_changes(struct sst25 *sst25, uint32_t addr, uint8_t *data, uint16_t size)
+{
+    uint8_t current[SST25_COMPARE_CHUNK];
+    int32_t run_start = -1, run_end = 0;
+    int status;
+
+    for (uint16_t offset = 0; offset < size; offset += SST25_COMPARE_CHUNK)
     {
-        char command[5] = {SST25_OP_BYTE_PROGRAM, (addr >> 16) & 0xFF, (addr >> 8) & 0xFF, (addr) & 0xFF, data[size - 1]};
-        struct spi_message message =
-        {
-            .tx_buf = command,
-            .rx_buf = 0,
-            .len = 5,
-            .cs_change = 0,
-            .delay_usecs = 0
-        };
-        int status = spi_sync(&sst25->spi, &message, 1);
+        uint16_t chunk = (size - offset > SST25_COMPARE_CHUNK) ? SST25_COMPARE_CHUNK : size - offset;
+
+        status = sst25_read_data(sst25, addr + offset, current, chunk);
         if (status)
             return status;
 
-        delay_us(10);
+        // Check whole chunk before programming, so erase is detected as early as possible.
+        for (uint16_t i = 0; i < chunk; i++)
+            if ((current[i] & data[offset + i]) != data[offset + i])
+                return 1;
+
+        for (uint16_t i = 0; i < chunk; i++)
+        {
+            int32_t pos = offset + i;
+
+            if (current[i] == data[pos])
+                continue;
+
+            if ((run_start >= 0) && (pos - run_end > SST25_PROGRAM_GAP))
+            {
+                status = sst25_write_data(sst25, addr + run_start, data + run_start, run_end - run_start);
+                if (status)
+                    return status;
+                run_start = -1;
+            }
+
+            if (run_start < 0)
+                run_start = pos;
+            run_end = pos + 1;
+        }
     }
-    status = sst25_write_disable(sst25);
-    if (status)
-        return status;
+
+    if (run_start >= 0)
+        return sst25_write_data(sst25, addr + run_start, data + run_start, run_end - run_start);
+
+    return 0;
+}
+
+int sst25_update_data(struct sst25 *sst25, uint32_t addr, uint8_t *data, uint16_t size, uint8_t *buffer)
+{
+    while (size)
+    {
+        uint16_t offset = addr & (SST25_SECTOR_SIZE - 1);
+        uint16_t chunk = SST25_SECTOR_SIZE - offset;
+
+        if (chunk > size)
+            chunk = size;
+
+        int status = sst25_program_changes(sst25, addr, data, chunk);
+        if (status < 0)
+            return status;
+
+        if (status)
+        {
+            if (!buffer)
+                return -ENOBUFS;
+
+            uint32_t base = addr - offset;
+
+            status = sst25_read_data(sst25, base, buffer, SST25_SECTOR_SIZE);
+            if (status)
+                return status;
+
+            memcpy(buffer + offset, data, chunk);
+
+            status = sst25_erase(sst25, base >> 12, SST25_ERASE_4K);
+            if (status)
+                return status;
+
+            // Erased bytes don't need programming.
+            for (uint16_t i = 0; i < SST25_SECTOR_SIZE;)
+            {
+                while ((i < SST25_SECTOR_SIZE) && (buffer[i] == 0xFF))
+                    i++;
+
+                uint16_t start = i;
+                while ((i < SST25_SECTOR_SIZE) && !((buffer[i] == 0xFF) && (i + 1 < SST25_SECTOR_SIZE) && (buffer[i + 1] == 0xFF)))
+                    i++;
+
+                if (i > start)
+                {
+                    status = sst25_write_data(sst25, base + start, buffer + start, i - start);
+                    if (status)
+                        return status;
+                }
+            }
+        }
+
+        addr += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+
     return 0;
 }
 
@@ -0,0 +1,356 @@
+#include "bm/sst25_cache.h"
+#include "bm/sst25.h"
+#include "bm/spi.h"
+#include <string.h>
+#include <errno.h>
+
+#define SST25_CACHE_LINE_MASK (SST25_CACHE_LINE_SIZE - 1)
+
+static struct sst25_cache_line *sst25_cache_lookup(struct sst25_cache *cache, uint32_t base)
+{
+    for (int i = 0; i < SST25_CACHE_LINES; i++)
+        if (cache->lines[i].addr == base)
+            return &cache->lines[i];
+
+    return 0;
+}
+
+static int sst25_cache_write_back(struct sst25_cache *cache, struct sst25_cache_line *line)
+{
+    if (!line->dirty_end)
+        return 0;
+
+    int status = sst25_write_data(cache->flash, line->addr + line->dirty_start, line->data + line->dirty_start,
+                                  line->dirty_end - line->dirty_start);
+    if (status)
+        return status;
+
+    line->dirty_start = 0;
+    line->dirty_end = 0;
+    cache->stats.write_backs++;
+    return 0;
+}
+
+/*!
+ * Least recently used line. Empty lines are preferred.
+ * \arg clean - skip dirty lines and lines used in current access, used for read-ahead.
+ */
+static struct sst25_cache_line *sst25_cache_victim(struct sst25_cache *cache, int clean)
+{
+    struct sst25_cache_line *victim = 0;
+
+    for (int i = 0; i < SST25_CACHE_LINES; i++)
+    {
+        struct sst25_cache_line *line = &cache->lines[i];
+
+        if (line->addr == SST25_CACHE_INVALID)
+            return line;
+
+        if (clean && (line->dirty_end || (line->used == cache->stamp)))
+            continue;
+
+        if (!victim || (line->used < victim->used))
+            victim = line;
+    }
+
+    return victim;
+}
+
+static int sst25_cache_fill(struct sst25_cache *cache, uint32_t base, struct sst25_cache_line **result)
+{
+    struct sst25_cache_line *lines[1 + SST25_CACHE_READ_AHEAD];
+    struct spi_message messages[2 + SST25_CACHE_READ_AHEAD];
+    int num = 1;
+
+    lines[0] = sst25_cache_victim(cache, 0);
+
+    int status = sst25_cache_write_back(cache, lines[0]);
+    if (status)
+        return status;
+
+    lines[0]->addr = base;
+    lines[0]->used = cache->stamp;
+    lines[0]->prefetched = 0;
+
+    for (int i = 1; i <= SST25_CACHE_READ_AHEAD; i++)
+    {
+        uint32_t addr = base + i * SST25_CACHE_LINE_SIZE;
+
+        if (sst25_cache_lookup(cache, addr))
+            break;
+
+        struct sst25_cache_line *line = sst25_cache_victim(cache, 1);
+        if (!line)
+            break;
+
+        line->addr = addr;
+        line->used = cache->stamp;
+        line->prefetched = 1;
+        lines[num++] = line;
+    }
+
+    uint8_t command[4] = {SST25_OP_READ, (base >> 16) & 0xFF, (base >> 8) & 0xFF, (base) & 0xFF};
+
+    messages[0].tx_buf = command;
+    messages[0].rx_buf = 0;
+    messages[0].len = 4;
+    messages[0].cs_change = 0;
+    messages[0].delay_usecs = 0;
+
+    for (int i = 0; i < num; i++)
+    {
+        messages[i + 1].tx_buf = 0;
+        messages[i + 1].rx_buf = lines[i]->data;
+        messages[i + 1].len = SST25_CACHE_LINE_SIZE;
+        messages[i + 1].cs_change = 0;
+        messages[i + 1].delay_usecs = 0;
+    }
+
+    status = spi_sync(&cache->flash->spi, messages, num + 1);
+
+    for (int i = 0; i < num; i++)
+    {
+        lines[i]->dirty_start = 0;
+        lines[i]->dirty_end = 0;
+        if (status)
+            lines[i]->addr = SST25_CACHE_INVALID;
+    }
+
+    if (status)
+        return status;
+
+    // Read-ahead lines are older than requested one.
+    for (int i = 1; i < num; i++)
+        lines[i]->used--;
+
+    cache->stats.read_ahead += num - 1;
+    *result = lines[0];
+    return 0;
+}
+
+/*!
+ * \arg fill - read line from flash on miss. If zero, line contents are undefined on miss
+ *             and must be overwritten by caller.
+ */
+static int sst25_cache_get(struct sst25_cache *cache, uint32_t base, int fill, struct sst25_cache_line **result)
+{
+    struct sst25_cache_line *line = sst25_cache_lookup(cache, base);
+
+    cache->stamp++;
+
+    if (line)
+    {
+        cache->stats.hits++;
+        if (line->prefetched)
+        {
+            cache->stats.read_ahead_hits++;
+            line->prefetched = 0;
+        }
+    }
+    else
+    {
+        cache->stats.misses++;
+
+        if (fill)
+        {
+            int status = sst25_cache_fill(cache, base, &line);
+            if (status)
+                return status;
+        }
+        else
+        {
+            line = sst25_cache_victim(cache, 0);
+
+            int status = sst25_cache_write_back(cache, line);
+            if (status)
+                return status;
+
+            line->addr = base;
+            line->prefetched = 0;
+        }
+    }
+
+    line->used = cache->stamp;
+    *result = line;
+    return 0;
+}
+
+int sst25_cache_init(struct sst25_cache *cache, struct sst25 *flash)
+{
+    cache->flash = flash;
+    cache->stamp = 0;
+
+    sst25_cache_invalidate(cache, 0, 0);
+    sst25_cache_reset_stats(cache);
+
+    return 0;
+}
+
+int sst25_cache_read(struct sst25_cache *cache, uint32_t addr, uint8_t *data, uint16_t size)
+{
+    while (size)
+    {
+        uint32_t base = addr & ~SST25_CACHE_LINE_MASK;
+        uint16_t offset = addr & SST25_CACHE_LINE_MASK;
+        uint16_t chunk = SST25_CACHE_LINE_SIZE - offset;
+        int status;
+
+        if (chunk > size)
+            chunk = size;
+
+        if ((chunk == SST25_CACHE_LINE_SIZE) && !sst25_cache_lookup(cache, base))
+        {
+            // Whole line requested and not cached, don't pollute cache.
+            cache->stats.misses++;
+            status = sst25_read_data(cache->flash, addr, data, chunk);
+            if (status)
+                return status;
+        }
+        else
+        {
+            struct sst25_cache_line *line;
+
+            status = sst25_cache_get(cache, base, 1, &line);
+            if (status)
+                return status;
+
+            memcpy(data, line->data + offset, chunk);
+        }
+
+        addr += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+
+    return 0;
+}
+
+int sst25_cache_write(struct sst25_cache *cache, uint32_t addr, const uint8_t *data, uint16_t size)
+{
+    cache->stats.writes++;
+
+    while (size)
+    {
+        uint32_t base = addr & ~SST25_CACHE_LINE_MASK;
+        uint16_t offset = addr & SST25_CACHE_LINE_MASK;
+        uint16_t chunk = SST25_CACHE_LINE_SIZE - offset;
+        struct sst25_cache_line *line;
+
+        if (chunk > size)
+            chunk = size;
+
+        int status = sst25_cache_get(cache, base, chunk != SST25_CACHE_LINE_SIZE, &line);
+        if (status)
+            return status;
+
+        memcpy(line->data + offset, data, chunk);
+
+        /*
+         * Whole line mirrors flash, so dirty range may be widened to word boundaries
+         * and over gaps between writes. Rewriting bytes with their current value is
+         * harmless and whole range is programmed with single AAI sequence.
+         */
+        uint16_t start = offset & ~1;
+        uint16_t end = (offset + chunk + 1) & ~1;
+
+        if (line->dirty_end)
+        {
+            if (start < line->dirty_start)
+                line->dirty_start = start;
+            if (end > line->dirty_end)
+                line->dirty_end = end;
+        }
+        else
+        {
+            line->dirty_start = start;
+            line->dirty_end = end;
+        }
+
+        addr += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+
+    return 0;
+}
+
+int sst25_cache_erase(struct sst25_cache *cache, uint16_t addr, int type)
+{
+    uint32_t start, size;
+
+    switch (type)
+    {
+    case SST25_ERASE_4K:
+        start = (uint32_t)(addr & 0xFFF) << 12;
+        size = 0x1000;
+        break;
+    case SST25_ERASE_32K:
+        start = (uint32_t)(addr & 0x1FF) << 15;
+        size = 0x8000;
+        break;
+    case SST25_ERASE_64K:
+        start = (uint32_t)(addr & 0xFF) << 16;
+        size = 0x10000;
+        break;
+    case SST25_ERASE_CHIP:
+        start = 0;
+        size = 0xFFFFFFFF;
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    int status = sst25_erase(cache->flash, addr, type);
+
+    for (int i = 0; i < SST25_CACHE_LINES; i++)
+    {
+        struct sst25_cache_line *line = &cache->lines[i];
+
+        if ((line->addr == SST25_CACHE_INVALID) || (line->addr < start) || (line->addr - start >= size))
+            continue;
+
+        line->dirty_start = 0;
+        line->dirty_end = 0;
+
+        if (status)
+            line->addr = SST25_CACHE_INVALID;
+        else
+            memset(line->data, 0xFF, SST25_CACHE_LINE_SIZE);
+    }
+
+    return status;
+}
+
+int sst25_cache_flush(struct sst25_cache *cache)
+{
+    for (int i = 0; i < SST25_CACHE_LINES; i++)
+    {
+        int status = sst25_cache_write_back(cache, &cache->lines[i]);
+        if (status)
+            return status;
+    }
+
+    return 0;
+}
+
+void sst25_cache_invalidate(struct sst25_cache *cache, uint32_t addr, uint32_t size)
+{
+    for (int i = 0; i < SST25_CACHE_LINES; i++)
+    {
+        struct sst25_cache_line *line = &cache->lines[i];
+
+        if (size && ((line->addr + SST25_CACHE_LINE_SIZE <= addr) || (line->addr >= addr + size)))
+            continue;
+
+        line->addr = SST25_CACHE_INVALID;
+        line->used = 0;
+        line->dirty_start = 0;
+        line->dirty_end = 0;
+        line->prefetched = 0;
+    }
+}
+
+void sst25_cache_reset_stats(struct sst25_cache *cache)
+{
+    memset(&cache->stats, 0, sizeof(cache->stats));
+}
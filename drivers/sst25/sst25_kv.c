@@ -0,0 +1,576 @@
+#include "bm/sst25_kv.h"
+#include "bm/sst25.h"
+#include "bm/crc.h"
+#include <stddef.h>
+#include <errno.h>
+
+#define SST25_KV_SECTOR_NONE 0xFFFF
+#define SST25_KV_COPY_CHUNK 32
+
+#define SST25_KV_HEADER_SIZE sizeof(struct sst25_kv_sector_header)
+#define SST25_KV_RECORD_HEADER_SIZE sizeof(struct sst25_kv_record_header)
+#define SST25_KV_VALUE_SIZE(len) ((len) & ~SST25_KV_TOMBSTONE)
+#define SST25_KV_RECORD_SIZE(len) (SST25_KV_RECORD_HEADER_SIZE + ((SST25_KV_VALUE_SIZE(len) + 1) & ~1))
+
+static uint32_t sst25_kv_sector_addr(struct sst25_kv *kv, uint16_t sector)
+{
+    return (uint32_t)(kv->first_sector + sector) * SST25_KV_SECTOR_SIZE;
+}
+
+static uint16_t sst25_kv_addr_sector(struct sst25_kv *kv, uint32_t addr)
+{
+    return addr / SST25_KV_SECTOR_SIZE - kv->first_sector;
+}
+
+/*!
+ * sst25_write_data() is used only with even sizes, odd tail is padded with 0xFF.
+ * \arg addr - even flash address.
+ */
+static int sst25_kv_program(struct sst25_kv *kv, uint32_t addr, const void *data, uint16_t size)
+{
+    const uint8_t *bytes = data;
+    int status;
+
+    if (size & ~1)
+    {
+        status = sst25_write_data(kv->flash, addr, (uint8_t *)bytes, size & ~1);
+        if (status)
+            return status;
+    }
+
+    if (size & 1)
+    {
+        uint8_t tail[2] = {bytes[size - 1], 0xFF};
+        return sst25_write_data(kv->flash, addr + size - 1, tail, 2);
+    }
+
+    return 0;
+}
+
+static uint16_t sst25_kv_slot(uint16_t key)
+{
+    return (key ^ (key >> 8)) & (SST25_KV_INDEX_SIZE - 1);
+}
+
+static struct sst25_kv_entry *sst25_kv_find(struct sst25_kv *kv, uint16_t key, int insert)
+{
+    uint16_t slot = sst25_kv_slot(key);
+
+    for (int i = 0; i < SST25_KV_INDEX_SIZE; i++)
+    {
+        struct sst25_kv_entry *entry = &kv->index[slot];
+
+        if (entry->key == key)
+            return entry;
+
+        if (entry->key == SST25_KV_KEY_NONE)
+        {
+            if (!insert || (kv->keys >= SST25_KV_INDEX_SIZE * 3 / 4))
+                return 0;
+
+            entry->key = key;
+            entry->len = 0;
+            entry->addr = SST25_KV_ADDR_NONE;
+            kv->keys++;
+            return entry;
+        }
+
+        slot = (slot + 1) & (SST25_KV_INDEX_SIZE - 1);
+    }
+
+    return 0;
+}
+
+//! Free index slot, following entries are shifted back, so their probe sequences stay unbroken.
+static void sst25_kv_remove(struct sst25_kv *kv, struct sst25_kv_entry *entry)
+{
+    uint16_t hole = entry - kv->index;
+    uint16_t slot = hole;
+
+    for (;;)
+    {
+        slot = (slot + 1) & (SST25_KV_INDEX_SIZE - 1);
+
+        struct sst25_kv_entry *next = &kv->index[slot];
+        if (next->key == SST25_KV_KEY_NONE)
+            break;
+
+        // Entry may fill hole, if hole is between its home slot and its slot.
+        uint16_t home = sst25_kv_slot(next->key);
+        if (((slot - home) & (SST25_KV_INDEX_SIZE - 1)) >= ((slot - hole) & (SST25_KV_INDEX_SIZE - 1)))
+        {
+            kv->index[hole] = *next;
+            hole = slot;
+        }
+    }
+
+    kv->index[hole].key = SST25_KV_KEY_NONE;
+    kv->index[hole].len = 0;
+    kv->index[hole].addr = SST25_KV_ADDR_NONE;
+    kv->keys--;
+}
+
+//! Point entry to new record and move liveness accordingly.
+static void sst25_kv_update(struct sst25_kv *kv, struct sst25_kv_entry *entry, uint32_t addr, uint16_t len)
+{
+    if (entry->addr != SST25_KV_ADDR_NONE)
+        kv->sectors[sst25_kv_addr_sector(kv, entry->addr)].live -= SST25_KV_RECORD_SIZE(entry->len);
+
+    entry->addr = addr;
+    entry->len = len;
+
+    if (addr != SST25_KV_ADDR_NONE)
+        kv->sectors[sst25_kv_addr_sector(kv, addr)].live += SST25_KV_RECORD_SIZE(len);
+}
+
+static int sst25_kv_erase(struct sst25_kv *kv, uint16_t sector)
+{
+    struct sst25_kv_sector *s = &kv->sectors[sector];
+
+    s->state = SST25_KV_SECTOR_DIRTY;
+
+    int status = sst25_erase(kv->flash, kv->first_sector + sector, SST25_ERASE_4K);
+    if (status)
+        return status;
+
+    kv->erases++;
+    s->erase_count++;
+
+    // Sequence number is left erased until sector becomes active.
+    struct sst25_kv_sector_header header = {SST25_KV_MAGIC, s->erase_count, SST25_KV_SEQ_NONE};
+    status = sst25_kv_program(kv, sst25_kv_sector_addr(kv, sector), &header, offsetof(struct sst25_kv_sector_header, seq));
+    if (status)
+        return status;
+
+    s->seq = SST25_KV_SEQ_NONE;
+    s->used = SST25_KV_HEADER_SIZE;
+    s->live = 0;
+    s->state = SST25_KV_SECTOR_FREE;
+    return 0;
+}
+
+static uint16_t sst25_kv_free_sectors(struct sst25_kv *kv)
+{
+    uint16_t count = 0;
+
+    for (uint16_t i = 0; i < kv->sector_count; i++)
+        if (kv->sectors[i].state == SST25_KV_SECTOR_FREE)
+            count++;
+
+    return count;
+}
+
+//! Make free sector with lowest erase count active.
+static int sst25_kv_activate(struct sst25_kv *kv)
+{
+    uint16_t best = SST25_KV_SECTOR_NONE;
+
+    for (uint16_t i = 0; i < kv->sector_count; i++)
+    {
+        if (kv->sectors[i].state != SST25_KV_SECTOR_FREE)
+            continue;
+        if ((best == SST25_KV_SECTOR_NONE) || (kv->sectors[i].erase_count < kv->sectors[best].erase_count))
+            best = i;
+    }
+
+    if (best == SST25_KV_SECTOR_NONE)
+        return -ENOSPC;
+
+    uint32_t seq = kv->next_seq;
+    int status = sst25_kv_program(kv, sst25_kv_sector_addr(kv, best) + offsetof(struct sst25_kv_sector_header, seq), &seq, sizeof(seq));
+    if (status)
+        return status;
+
+    kv->next_seq++;
+
+    if (kv->active != SST25_KV_SECTOR_NONE)
+        kv->sectors[kv->active].state = SST25_KV_SECTOR_CLOSED;
+
+    kv->sectors[best].seq = seq;
+    kv->sectors[best].state = SST25_KV_SECTOR_ACTIVE;
+    kv->active = best;
+    return 0;
+}
+
+/*!
+ * Make sure that active sector has room for record.
+ * \arg collect - run garbage collection if only reserve sector is free.
+ */
+static int sst25_kv_reserve(struct sst25_kv *kv, uint16_t size, int collect)
+{
+    for (;;)
+    {
+        if ((kv->active != SST25_KV_SECTOR_NONE) && (kv->sectors[kv->active].used + size <= SST25_KV_SECTOR_SIZE))
+            return 0;
+
+        // One free sector is always kept for garbage collection.
+        if (!collect || (sst25_kv_free_sectors(kv) > 1))
+            return sst25_kv_activate(kv);
+
+        int status = sst25_kv_collect(kv);
+        if (status)
+            return status;
+    }
+}
+
+static int sst25_kv_copy(struct sst25_kv *kv, struct sst25_kv_entry *entry)
+{
+    uint16_t size = SST25_KV_RECORD_SIZE(entry->len);
+    uint8_t buf[SST25_KV_COPY_CHUNK];
+
+    int status = sst25_kv_reserve(kv, size, 0);
+    if (status)
+        return status;
+
+    uint32_t addr = sst25_kv_sector_addr(kv, kv->active) + kv->sectors[kv->active].used;
+    kv->sectors[kv->active].used += size;
+
+    for (uint16_t offset = 0; offset < size; offset += SST25_KV_COPY_CHUNK)
+    {
+        uint16_t chunk = (size - offset > SST25_KV_COPY_CHUNK) ? SST25_KV_COPY_CHUNK : size - offset;
+
+        status = sst25_read_data(kv->flash, entry->addr + offset, buf, chunk);
+        if (status)
+            return status;
+
+        status = sst25_kv_program(kv, addr + offset, buf, chunk);
+        if (status)
+            return status;
+    }
+
+    sst25_kv_update(kv, entry, addr, entry->len);
+    return 0;
+}
+
+//! Rebuild index from records of sector.
+static int sst25_kv_scan(struct sst25_kv *kv, uint16_t sector)
+{
+    struct sst25_kv_sector *s = &kv->sectors[sector];
+    uint32_t base = sst25_kv_sector_addr(kv, sector);
+    uint16_t offset = SST25_KV_HEADER_SIZE;
+    uint8_t buf[SST25_KV_COPY_CHUNK];
+    int status;
+
+    while (offset + SST25_KV_RECORD_HEADER_SIZE <= SST25_KV_SECTOR_SIZE)
+    {
+        struct sst25_kv_record_header header;
+
+        status = sst25_read_data(kv->flash, base + offset, (uint8_t *)&header, sizeof(header));
+        if (status)
+            return status;
+
+        if (header.key == SST25_KV_KEY_NONE)
+            break;
+
+        uint16_t size = SST25_KV_RECORD_SIZE(header.len);
+        uint16_t len = SST25_KV_VALUE_SIZE(header.len);
+
+        if ((len > SST25_KV_MAX_VALUE) || (offset + size > SST25_KV_SECTOR_SIZE))
+            goto torn;
+
+        uint16_t crc = crc16_ccitt(CRC16_CCITT_INIT, &header, offsetof(struct sst25_kv_record_header, crc));
+        for (uint16_t i = 0; i < len; i += SST25_KV_COPY_CHUNK)
+        {
+            uint16_t chunk = (len - i > SST25_KV_COPY_CHUNK) ? SST25_KV_COPY_CHUNK : len - i;
+
+            status = sst25_read_data(kv->flash, base + offset + SST25_KV_RECORD_HEADER_SIZE + i, buf, chunk);
+            if (status)
+                return status;
+
+            crc = crc16_ccitt(crc, buf, chunk);
+        }
+
+        if (crc != header.crc)
+            goto torn;
+
+        struct sst25_kv_entry *entry = sst25_kv_find(kv, header.key, 1);
+        if (!entry)
+            return -ENOSPC;
+
+        sst25_kv_update(kv, entry, base + offset, header.len);
+        offset += size;
+    }
+
+    s->used = offset;
+    return 0;
+
+torn:
+    // Interrupted write, sector is not appended anymore and will be collected.
+    s->used = SST25_KV_SECTOR_SIZE;
+    return 0;
+}
+
+int sst25_kv_mount(struct sst25_kv *kv, struct sst25 *flash, uint16_t first_sector, uint16_t sector_count)
+{
+    if ((sector_count < 3) || (sector_count > SST25_KV_MAX_SECTORS))
+        return -EINVAL;
+
+    kv->flash = flash;
+    kv->first_sector = first_sector;
+    kv->sector_count = sector_count;
+    kv->active = SST25_KV_SECTOR_NONE;
+    kv->keys = 0;
+    kv->next_seq = 0;
+    kv->erases = 0;
+
+    for (int i = 0; i < SST25_KV_INDEX_SIZE; i++)
+    {
+        kv->index[i].key = SST25_KV_KEY_NONE;
+        kv->index[i].len = 0;
+        kv->index[i].addr = SST25_KV_ADDR_NONE;
+    }
+
+    uint16_t order[SST25_KV_MAX_SECTORS];
+    uint16_t used = 0;
+    uint32_t max_erase_count = 0;
+    int status;
+
+    for (uint16_t i = 0; i < sector_count; i++)
+    {
+        struct sst25_kv_sector *s = &kv->sectors[i];
+        struct sst25_kv_sector_header header;
+
+        status = sst25_read_data(flash, sst25_kv_sector_addr(kv, i), (uint8_t *)&header, sizeof(header));
+        if (status)
+            return status;
+
+        s->used = SST25_KV_HEADER_SIZE;
+        s->live = 0;
+        s->seq = header.seq;
+        s->erase_count = header.erase_count;
+
+        if (header.magic != SST25_KV_MAGIC)
+        {
+            s->state = SST25_KV_SECTOR_DIRTY;
+            s->erase_count = 0;
+            continue;
+        }
+
+        if (s->erase_count > max_erase_count)
+            max_erase_count = s->erase_count;
+
+        if (header.seq == SST25_KV_SEQ_NONE)
+        {
+            s->state = SST25_KV_SECTOR_FREE;
+            continue;
+        }
+
+        s->state = SST25_KV_SECTOR_CLOSED;
+        if (header.seq >= kv->next_seq)
+            kv->next_seq = header.seq + 1;
+
+        // Keep sectors sorted by log order, so later records override earlier ones.
+        uint16_t j = used++;
+        while (j && (kv->sectors[order[j - 1]].seq > header.seq))
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    for (uint16_t i = 0; i < used; i++)
+    {
+        status = sst25_kv_scan(kv, order[i]);
+        if (status)
+            return status;
+    }
+
+    if (used && (kv->sectors[order[used - 1]].used < SST25_KV_SECTOR_SIZE))
+    {
+        kv->active = order[used - 1];
+        kv->sectors[kv->active].state = SST25_KV_SECTOR_ACTIVE;
+    }
+
+    for (uint16_t i = 0; i < sector_count; i++)
+    {
+        if (kv->sectors[i].state != SST25_KV_SECTOR_DIRTY)
+            continue;
+
+        // Erase count was lost, assume the worst.
+        kv->sectors[i].erase_count = max_erase_count;
+        status = sst25_kv_erase(kv, i);
+        if (status)
+            return status;
+    }
+
+    return 0;
+}
+
+int sst25_kv_format(struct sst25_kv *kv, struct sst25 *flash, uint16_t first_sector, uint16_t sector_count)
+{
+    if ((sector_count < 3) || (sector_count > SST25_KV_MAX_SECTORS))
+        return -EINVAL;
+
+    kv->flash = flash;
+    kv->first_sector = first_sector;
+    kv->sector_count = sector_count;
+
+    for (uint16_t i = 0; i < sector_count; i++)
+    {
+        struct sst25_kv_sector_header header;
+
+        int status = sst25_read_data(flash, sst25_kv_sector_addr(kv, i), (uint8_t *)&header, sizeof(header));
+        if (status)
+            return status;
+
+        kv->sectors[i].erase_count = (header.magic == SST25_KV_MAGIC) ? header.erase_count : 0;
+
+        status = sst25_kv_erase(kv, i);
+        if (status)
+            return status;
+    }
+
+    return sst25_kv_mount(kv, flash, first_sector, sector_count);
+}
+
+int sst25_kv_get(struct sst25_kv *kv, uint16_t key, void *data, uint16_t size, uint16_t *len)
+{
+    struct sst25_kv_entry *entry = sst25_kv_find(kv, key, 0);
+
+    if (!entry || (entry->addr == SST25_KV_ADDR_NONE) || (entry->len & SST25_KV_TOMBSTONE))
+        return -ENOENT;
+
+    if (len)
+        *len = entry->len;
+
+    if (entry->len > size)
+        return -ENOBUFS;
+
+    return sst25_read_data(kv->flash, entry->addr + SST25_KV_RECORD_HEADER_SIZE, data, entry->len);
+}
+
+static int sst25_kv_append(struct sst25_kv *kv, uint16_t key, uint16_t len, const void *data)
+{
+    if (key == SST25_KV_KEY_NONE)
+        return -EINVAL;
+
+    int status;
+
+    // Tombstones leave index, when their sectors are collected.
+    for (uint16_t i = 0; !sst25_kv_find(kv, key, 0) && (kv->keys >= SST25_KV_INDEX_SIZE * 3 / 4); i++)
+    {
+        if (i == kv->sector_count)
+            return -ENOSPC;
+
+        status = sst25_kv_collect(kv);
+        if (status)
+            return status;
+    }
+
+    uint16_t size = SST25_KV_RECORD_SIZE(len);
+
+    // Index slot is claimed after record is written, as collection may free slots.
+    status = sst25_kv_reserve(kv, size, 1);
+    if (status)
+        return status;
+
+    struct sst25_kv_record_header header = {key, len, 0};
+    header.crc = crc16_ccitt(CRC16_CCITT_INIT, &header, offsetof(struct sst25_kv_record_header, crc));
+    header.crc = crc16_ccitt(header.crc, data, SST25_KV_VALUE_SIZE(len));
+
+    uint32_t addr = sst25_kv_sector_addr(kv, kv->active) + kv->sectors[kv->active].used;
+
+    // Space is consumed even if programming fails.
+    kv->sectors[kv->active].used += size;
+
+    status = sst25_kv_program(kv, addr, &header, sizeof(header));
+    if (status)
+        return status;
+
+    status = sst25_kv_program(kv, addr + SST25_KV_RECORD_HEADER_SIZE, data, SST25_KV_VALUE_SIZE(len));
+    if (status)
+        return status;
+
+    struct sst25_kv_entry *entry = sst25_kv_find(kv, key, 1);
+    if (!entry)
+        return -ENOSPC;
+
+    sst25_kv_update(kv, entry, addr, len);
+    return 0;
+}
+
+int sst25_kv_set(struct sst25_kv *kv, uint16_t key, const void *data, uint16_t len)
+{
+    if (len > SST25_KV_MAX_VALUE)
+        return -EINVAL;
+
+    return sst25_kv_append(kv, key, len, data);
+}
+
+int sst25_kv_delete(struct sst25_kv *kv, uint16_t key)
+{
+    struct sst25_kv_entry *entry = sst25_kv_find(kv, key, 0);
+
+    if (!entry || (entry->addr == SST25_KV_ADDR_NONE) || (entry->len & SST25_KV_TOMBSTONE))
+        return -ENOENT;
+
+    return sst25_kv_append(kv, key, SST25_KV_TOMBSTONE, 0);
+}
+
+int sst25_kv_collect(struct sst25_kv *kv)
+{
+    uint16_t victim = SST25_KV_SECTOR_NONE;
+    uint16_t coldest = SST25_KV_SECTOR_NONE;
+    uint32_t max_erase_count = 0;
+    uint32_t min_seq = SST25_KV_SEQ_NONE;
+
+    for (uint16_t i = 0; i < kv->sector_count; i++)
+    {
+        struct sst25_kv_sector *s = &kv->sectors[i];
+
+        if (s->erase_count > max_erase_count)
+            max_erase_count = s->erase_count;
+
+        if ((s->state == SST25_KV_SECTOR_CLOSED) || (s->state == SST25_KV_SECTOR_ACTIVE))
+            if (s->seq < min_seq)
+                min_seq = s->seq;
+
+        if (s->state != SST25_KV_SECTOR_CLOSED)
+            continue;
+
+        if ((victim == SST25_KV_SECTOR_NONE) || (s->live < kv->sectors[victim].live) ||
+                ((s->live == kv->sectors[victim].live) && (s->erase_count < kv->sectors[victim].erase_count)))
+            victim = i;
+
+        if ((coldest == SST25_KV_SECTOR_NONE) || (s->erase_count < kv->sectors[coldest].erase_count))
+            coldest = i;
+    }
+
+    if (victim == SST25_KV_SECTOR_NONE)
+        return -ENOSPC;
+
+    // Static wear leveling: move cold data out of rarely erased sector.
+    if (max_erase_count - kv->sectors[coldest].erase_count > SST25_KV_WEAR_LIMIT)
+        victim = coldest;
+    else if (kv->sectors[victim].live + SST25_KV_HEADER_SIZE >= SST25_KV_SECTOR_SIZE)
+        return -ENOSPC;
+
+    // Nothing older than oldest sector can be shadowed by its tombstones.
+    int oldest = kv->sectors[victim].seq == min_seq;
+
+    for (int i = 0; i < SST25_KV_INDEX_SIZE; i++)
+    {
+        struct sst25_kv_entry *entry = &kv->index[i];
+
+        if ((entry->key == SST25_KV_KEY_NONE) || (entry->addr == SST25_KV_ADDR_NONE) ||
+                (sst25_kv_addr_sector(kv, entry->addr) != victim))
+            continue;
+
+        if (oldest && (entry->len & SST25_KV_TOMBSTONE))
+        {
+            sst25_kv_update(kv, entry, SST25_KV_ADDR_NONE, 0);
+            sst25_kv_remove(kv, entry);
+
+            // Slot is refilled by shifted entry, which isn't checked yet.
+            i--;
+            continue;
+        }
+
+        int status = sst25_kv_copy(kv, entry);
+        if (status)
+            return status;
+    }
+
+    return sst25_kv_erase(kv, victim);
+}
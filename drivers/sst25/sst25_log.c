@@ -0,0 +1,452 @@
+#include "bm/sst25_log.h"
+#include "bm/sst25.h"
+#include "bm/crc.h"
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+
+#define SST25_LOG_HEADER_SIZE sizeof(struct sst25_log_segment_header)
+#define SST25_LOG_BLOCK_HEADER_SIZE sizeof(struct sst25_log_block_header)
+#define SST25_LOG_BLOCK_SPACE(len) (SST25_LOG_BLOCK_HEADER_SIZE + (((len) + 1) & ~1))
+#define SST25_LOG_BLOCK_END 0xFFFF
+
+static uint32_t sst25_log_segment_addr(struct sst25_log *log, uint16_t segment)
+{
+    return (uint32_t)(log->first_sector + segment) * SST25_LOG_SEGMENT_SIZE;
+}
+
+static uint8_t sst25_log_put_varint(uint8_t *buf, uint32_t value)
+{
+    uint8_t len = 0;
+
+    while (value >= 0x80)
+    {
+        buf[len++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    buf[len++] = value;
+
+    return len;
+}
+
+static int sst25_log_get_varint(const uint8_t *buf, uint16_t len, uint16_t *pos, uint32_t *value)
+{
+    *value = 0;
+
+    for (uint8_t shift = 0; shift < 35; shift += 7)
+    {
+        if (*pos >= len)
+            return -EBADMSG;
+
+        uint8_t byte = buf[(*pos)++];
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+
+        if (!(byte & 0x80))
+            return 0;
+    }
+
+    return -EBADMSG;
+}
+
+static uint8_t sst25_log_encode(uint8_t channels, uint8_t *buf, uint32_t dt, const int32_t *values, const int32_t *prev)
+{
+    uint8_t len = sst25_log_put_varint(buf, dt);
+
+    for (uint8_t i = 0; i < channels; i++)
+    {
+        int32_t delta = (int32_t)((uint32_t)values[i] - (uint32_t)prev[i]);
+        len += sst25_log_put_varint(buf + len, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+    }
+
+    return len;
+}
+
+static int sst25_log_decode(uint8_t channels, const uint8_t *buf, uint16_t len, uint16_t *pos, uint32_t *timestamp, int32_t *values)
+{
+    uint32_t value;
+
+    if (sst25_log_get_varint(buf, len, pos, &value))
+        return -EBADMSG;
+    *timestamp += value;
+
+    for (uint8_t i = 0; i < channels; i++)
+    {
+        if (sst25_log_get_varint(buf, len, pos, &value))
+            return -EBADMSG;
+        values[i] = (int32_t)((uint32_t)values[i] + ((value >> 1) ^ -(value & 1)));
+    }
+
+    return 0;
+}
+
+static uint16_t sst25_log_block_crc(const struct sst25_log_block_header *header, const uint8_t *payload)
+{
+    uint16_t crc = crc16_ccitt(CRC16_CCITT_INIT, &header->len, sizeof(header->len));
+    crc = crc16_ccitt(crc, &header->timestamp, sizeof(header->timestamp));
+    return crc16_ccitt(crc, payload, header->len);
+}
+
+/*!
+ * \returns 1 if segment header is valid, 0 if segment is erased or broken, negative error code otherwise.
+ */
+static int sst25_log_read_header(struct sst25_log *log, uint16_t segment, struct sst25_log_segment_header *header)
+{
+    int status = sst25_read_data(log->flash, sst25_log_segment_addr(log, segment), (uint8_t *)header, sizeof(*header));
+    if (status)
+        return status;
+
+    return (header->magic == SST25_LOG_MAGIC) &&
+           (header->crc == crc16_ccitt(CRC16_CCITT_INIT, header, offsetof(struct sst25_log_segment_header, crc)));
+}
+
+//! Erase next segment, overwriting the oldest one if log is full.
+static int sst25_log_open_segment(struct sst25_log *log, uint32_t timestamp)
+{
+    uint16_t next = log->empty ? 0 : (log->head + 1) % log->sector_count;
+    uint32_t seq = log->empty ? 0 : log->seq + 1;
+
+    if (!log->empty && (next == log->tail))
+        log->tail = (log->tail + 1) % log->sector_count;
+
+    int status = sst25_erase(log->flash, log->first_sector + next, SST25_ERASE_4K);
+    if (status)
+        return status;
+
+    log->erases++;
+
+    struct sst25_log_segment_header header =
+    {
+        .magic = SST25_LOG_MAGIC,
+        .seq = seq,
+        .timestamp = timestamp,
+        .channels = log->channels,
+        .reserved = 0xFF,
+        .crc = 0
+    };
+    header.crc = crc16_ccitt(CRC16_CCITT_INIT, &header, offsetof(struct sst25_log_segment_header, crc));
+
+    log->head = next;
+    log->seq = seq;
+    log->offset = SST25_LOG_HEADER_SIZE;
+    log->empty = 0;
+
+    return sst25_write_data(log->flash, sst25_log_segment_addr(log, next), (uint8_t *)&header, sizeof(header));
+}
+
+int sst25_log_mount(struct sst25_log *log, struct sst25 *flash, uint16_t first_sector, uint16_t sector_count, uint8_t channels)
+{
+    if ((sector_count < 2) || (channels > SST25_LOG_MAX_CHANNELS))
+        return -EINVAL;
+
+    log->flash = flash;
+    log->first_sector = first_sector;
+    log->sector_count = sector_count;
+    log->channels = channels;
+    log->empty = 0;
+    log->head = 0;
+    log->tail = 0;
+    log->offset = SST25_LOG_HEADER_SIZE;
+    log->seq = 0;
+    log->timestamp = 0;
+    log->block_len = 0;
+    log->erases = 0;
+
+    struct sst25_log_segment_header header;
+    uint32_t seq;
+
+    int status = sst25_log_read_header(log, 0, &header);
+    if (status < 0)
+        return status;
+
+    if (status)
+    {
+        /*
+         * Segments from 0 to head have consecutive numbers, segments after head are
+         * older or erased, so head is found by binary search.
+         */
+        uint16_t lo = 0, hi = sector_count;
+        seq = header.seq;
+
+        while (hi - lo > 1)
+        {
+            uint16_t mid = (lo + hi) / 2;
+
+            status = sst25_log_read_header(log, mid, &header);
+            if (status < 0)
+                return status;
+
+            if (status && (header.seq == seq + mid))
+                lo = mid;
+            else
+                hi = mid;
+        }
+
+        log->head = lo;
+    }
+    else
+    {
+        // Segment 0 is erased: either log is empty or wrap was interrupted.
+        log->head = sector_count - 1;
+    }
+
+    status = sst25_log_read_header(log, log->head, &header);
+    if (status < 0)
+        return status;
+
+    if (!status)
+    {
+        log->empty = 1;
+        return 0;
+    }
+
+    if (header.channels != channels)
+        return -EINVAL;
+
+    log->seq = header.seq;
+    log->timestamp = header.timestamp;
+
+    // Tail follows head, or segment after it if it was being erased.
+    for (uint16_t i = 1; i < 3; i++)
+    {
+        uint16_t segment = (log->head + i) % sector_count;
+
+        if (segment == log->head)
+            break;
+
+        status = sst25_log_read_header(log, segment, &header);
+        if (status < 0)
+            return status;
+
+        if (status && (header.seq == log->seq - (sector_count - i)))
+        {
+            log->tail = segment;
+            break;
+        }
+    }
+
+    // Find write offset in head segment.
+    uint32_t base = sst25_log_segment_addr(log, log->head);
+
+    while (log->offset + SST25_LOG_BLOCK_HEADER_SIZE <= SST25_LOG_SEGMENT_SIZE)
+    {
+        struct sst25_log_block_header block;
+
+        status = sst25_read_data(flash, base + log->offset, (uint8_t *)&block, sizeof(block));
+        if (status)
+            return status;
+
+        if (block.len == SST25_LOG_BLOCK_END)
+            return 0;
+
+        if ((block.len > SST25_LOG_BLOCK_SIZE) || (log->offset + SST25_LOG_BLOCK_SPACE(block.len) > SST25_LOG_SEGMENT_SIZE))
+            break;
+
+        status = sst25_read_data(flash, base + log->offset + SST25_LOG_BLOCK_HEADER_SIZE, log->block, block.len);
+        if (status)
+            return status;
+
+        if (block.crc != sst25_log_block_crc(&block, log->block))
+            break;
+
+        uint16_t pos = 0;
+        log->timestamp = block.timestamp;
+        memset(log->values, 0, sizeof(log->values));
+        while (pos < block.len)
+            if (sst25_log_decode(channels, log->block, block.len, &pos, &log->timestamp, log->values))
+                break;
+
+        log->offset += SST25_LOG_BLOCK_SPACE(block.len);
+    }
+
+    // Interrupted write, continue in next segment.
+    log->offset = SST25_LOG_SEGMENT_SIZE;
+    return 0;
+}
+
+int sst25_log_format(struct sst25_log *log, struct sst25 *flash, uint16_t first_sector, uint16_t sector_count, uint8_t channels)
+{
+    for (uint16_t i = 0; i < sector_count; i++)
+    {
+        int status = sst25_erase(flash, first_sector + i, SST25_ERASE_4K);
+        if (status)
+            return status;
+    }
+
+    return sst25_log_mount(log, flash, first_sector, sector_count, channels);
+}
+
+int sst25_log_flush(struct sst25_log *log)
+{
+    if (!log->block_len)
+        return 0;
+
+    uint16_t space = SST25_LOG_BLOCK_SPACE(log->block_len);
+    int status;
+
+    if (log->empty || (log->offset + space > SST25_LOG_SEGMENT_SIZE))
+    {
+        status = sst25_log_open_segment(log, log->block_timestamp);
+        if (status)
+            return status;
+    }
+
+    struct sst25_log_block_header header =
+    {
+        .len = log->block_len,
+        .crc = 0,
+        .timestamp = log->block_timestamp
+    };
+    header.crc = sst25_log_block_crc(&header, log->block);
+
+    uint32_t addr = sst25_log_segment_addr(log, log->head) + log->offset;
+
+    // Space and samples are consumed even if programming fails.
+    log->block[log->block_len] = 0xFF;
+    log->offset += space;
+    log->block_len = 0;
+
+    status = sst25_write_data(log->flash, addr, (uint8_t *)&header, sizeof(header));
+    if (status)
+        return status;
+
+    return sst25_write_data(log->flash, addr + SST25_LOG_BLOCK_HEADER_SIZE, log->block, space - SST25_LOG_BLOCK_HEADER_SIZE);
+}
+
+int sst25_log_append(struct sst25_log *log, uint32_t timestamp, const int32_t *values)
+{
+    uint8_t record[SST25_LOG_RECORD_MAX];
+    uint8_t len;
+
+    if (timestamp < log->timestamp)
+        return -EINVAL;
+
+    if (log->block_len)
+    {
+        len = sst25_log_encode(log->channels, record, timestamp - log->timestamp, values, log->values);
+        if (log->block_len + len <= SST25_LOG_BLOCK_SIZE)
+            goto append;
+
+        int status = sst25_log_flush(log);
+        if (status)
+            return status;
+    }
+
+    log->block_timestamp = timestamp;
+    memset(log->values, 0, sizeof(log->values));
+    len = sst25_log_encode(log->channels, record, 0, values, log->values);
+
+append:
+    memcpy(log->block + log->block_len, record, len);
+    log->block_len += len;
+    log->timestamp = timestamp;
+    memcpy(log->values, values, log->channels * sizeof(int32_t));
+
+    return 0;
+}
+
+int sst25_log_query(struct sst25_log *log, struct sst25_log_cursor *cursor, uint32_t from, uint32_t to)
+{
+    cursor->from = from;
+    cursor->to = to;
+    cursor->offset = SST25_LOG_HEADER_SIZE;
+    cursor->pos = 0;
+    cursor->len = 0;
+
+    if (log->empty)
+    {
+        cursor->segment = log->head;
+        cursor->seq = log->seq;
+        cursor->offset = SST25_LOG_SEGMENT_SIZE;
+        return 0;
+    }
+
+    // Last segment starting not later than range.
+    uint16_t count = (log->head + log->sector_count - log->tail) % log->sector_count + 1;
+    uint16_t lo = 0, hi = count;
+    struct sst25_log_segment_header header;
+
+    while (hi - lo > 1)
+    {
+        uint16_t mid = (lo + hi) / 2;
+
+        int status = sst25_log_read_header(log, (log->tail + mid) % log->sector_count, &header);
+        if (status < 0)
+            return status;
+        if (!status)
+            return -EIO;
+
+        if (header.timestamp <= from)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    cursor->segment = (log->tail + lo) % log->sector_count;
+    cursor->seq = log->seq - (count - 1 - lo);
+    return 0;
+}
+
+int sst25_log_next(struct sst25_log *log, struct sst25_log_cursor *cursor, uint32_t *timestamp, int32_t *values)
+{
+    for (;;)
+    {
+        while (cursor->pos < cursor->len)
+        {
+            if (sst25_log_decode(log->channels, cursor->block, cursor->len, &cursor->pos, &cursor->timestamp, cursor->values))
+                return -EBADMSG;
+
+            if (cursor->timestamp < cursor->from)
+                continue;
+            if (cursor->timestamp > cursor->to)
+                return -ENOENT;
+
+            *timestamp = cursor->timestamp;
+            memcpy(values, cursor->values, log->channels * sizeof(int32_t));
+            return 0;
+        }
+
+        if (log->seq - cursor->seq >= log->sector_count)
+            return -ESTALE;
+
+        struct sst25_log_block_header header = {SST25_LOG_BLOCK_END, 0, 0};
+        uint32_t base = sst25_log_segment_addr(log, cursor->segment);
+        int status;
+
+        if (cursor->offset + SST25_LOG_BLOCK_HEADER_SIZE <= SST25_LOG_SEGMENT_SIZE)
+        {
+            status = sst25_read_data(log->flash, base + cursor->offset, (uint8_t *)&header, sizeof(header));
+            if (status)
+                return status;
+        }
+
+        if ((header.len != SST25_LOG_BLOCK_END) && (header.len <= SST25_LOG_BLOCK_SIZE) &&
+                (cursor->offset + SST25_LOG_BLOCK_SPACE(header.len) <= SST25_LOG_SEGMENT_SIZE))
+        {
+            if (header.timestamp > cursor->to)
+                return -ENOENT;
+
+            status = sst25_read_data(log->flash, base + cursor->offset + SST25_LOG_BLOCK_HEADER_SIZE, cursor->block, header.len);
+            if (status)
+                return status;
+
+            cursor->offset += SST25_LOG_BLOCK_SPACE(header.len);
+
+            if (header.crc == sst25_log_block_crc(&header, cursor->block))
+            {
+                cursor->timestamp = header.timestamp;
+                memset(cursor->values, 0, sizeof(cursor->values));
+                cursor->pos = 0;
+                cursor->len = header.len;
+                continue;
+            }
+        }
+
+        // End of segment or interrupted write.
+        if (cursor->seq == log->seq)
+            return -ENOENT;
+
+        cursor->segment = (cursor->segment + 1) % log->sector_count;
+        cursor->seq++;
+        cursor->offset = SST25_LOG_HEADER_SIZE;
+    }
+}
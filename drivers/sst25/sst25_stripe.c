@@ -0,0 +1,155 @@
+#include "bm/sst25_stripe.h"
+#include "bm/sst25.h"
+#include <errno.h>
+
+/*!
+ * Device address of logical boundary.
+ * \returns address in device, that corresponds to first logical byte >= addr, which is stored on device.
+ */
+static uint32_t sst25_stripe_boundary(struct sst25_stripe *stripe, uint8_t device, uint32_t addr)
+{
+    uint32_t unit = addr / SST25_STRIPE_UNIT;
+    uint32_t row = unit / stripe->count;
+    uint8_t column = unit % stripe->count;
+
+    if (column == device)
+        return row * SST25_STRIPE_UNIT + addr % SST25_STRIPE_UNIT;
+    if (column > device)
+        return (row + 1) * SST25_STRIPE_UNIT;
+    return row * SST25_STRIPE_UNIT;
+}
+
+//! Logical address of device address.
+static uint32_t sst25_stripe_logical(struct sst25_stripe *stripe, uint8_t device, uint32_t addr)
+{
+    return ((addr / SST25_STRIPE_UNIT) * stripe->count + device) * SST25_STRIPE_UNIT + addr % SST25_STRIPE_UNIT;
+}
+
+int sst25_stripe_init(struct sst25_stripe *stripe, struct sst25 **devices, uint8_t count)
+{
+    if ((count < 1) || (count > SST25_STRIPE_MAX_DEVICES))
+        return -EINVAL;
+
+    for (uint8_t i = 0; i < count; i++)
+        stripe->devices[i] = devices[i];
+    stripe->count = count;
+
+    return 0;
+}
+
+int sst25_stripe_read(struct sst25_stripe *stripe, uint32_t addr, uint8_t *data, uint16_t size)
+{
+    while (size)
+    {
+        uint16_t offset = addr % SST25_STRIPE_UNIT;
+        uint16_t chunk = SST25_STRIPE_UNIT - offset;
+        uint32_t unit = addr / SST25_STRIPE_UNIT;
+
+        if (chunk > size)
+            chunk = size;
+
+        int status = sst25_read_data(stripe->devices[unit % stripe->count],
+                                     (unit / stripe->count) * SST25_STRIPE_UNIT + offset, data, chunk);
+        if (status)
+            return status;
+
+        addr += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+
+    return 0;
+}
+
+int sst25_stripe_write(struct sst25_stripe *stripe, uint32_t addr, uint8_t *data, uint16_t size)
+{
+    uint32_t start[SST25_STRIPE_MAX_DEVICES];
+    uint32_t end[SST25_STRIPE_MAX_DEVICES];
+    uint8_t active = 0;
+    int status;
+
+    // Each device gets one contiguous range, its source bytes are strided in data.
+    for (uint8_t i = 0; i < stripe->count; i++)
+    {
+        start[i] = sst25_stripe_boundary(stripe, i, addr);
+        end[i] = sst25_stripe_boundary(stripe, i, addr + size);
+
+        if ((start[i] < end[i]) && (start[i] & 1))
+        {
+            status = sst25_write_data(stripe->devices[i], start[i], data + sst25_stripe_logical(stripe, i, start[i]) - addr, 1);
+            if (status)
+                return status;
+            start[i]++;
+        }
+
+        if (end[i] - start[i] >= 2)
+        {
+            status = sst25_aai_start(stripe->devices[i], start[i], data + sst25_stripe_logical(stripe, i, start[i]) - addr);
+            if (status)
+                return status;
+            start[i] += 2;
+            active |= 1 << i;
+        }
+    }
+
+    // Round-robin over devices, so program time of one device is hidden behind transfers to others.
+    while (active)
+    {
+        for (uint8_t i = 0; i < stripe->count; i++)
+        {
+            if (!(active & (1 << i)))
+                continue;
+
+            status = sst25_wait_for_ready(stripe->devices[i], 1);
+            if (status)
+                return status;
+
+            if (end[i] - start[i] < 2)
+            {
+                status = sst25_aai_end(stripe->devices[i]);
+                if (status)
+                    return status;
+                active &= ~(1 << i);
+                continue;
+            }
+
+            status = sst25_aai_next(stripe->devices[i], data + sst25_stripe_logical(stripe, i, start[i]) - addr);
+            if (status)
+                return status;
+            start[i] += 2;
+        }
+    }
+
+    for (uint8_t i = 0; i < stripe->count; i++)
+    {
+        if (start[i] < end[i])
+        {
+            status = sst25_write_data(stripe->devices[i], start[i], data + sst25_stripe_logical(stripe, i, start[i]) - addr, 1);
+            if (status)
+                return status;
+        }
+    }
+
+    return 0;
+}
+
+int sst25_stripe_erase(struct sst25_stripe *stripe, uint16_t addr, int type)
+{
+    int status;
+
+    for (uint8_t i = 0; i < stripe->count; i++)
+    {
+        status = sst25_erase_start(stripe->devices[i], addr, type);
+        if (status)
+            return status;
+    }
+
+    for (uint8_t i = 0; i < stripe->count; i++)
+    {
+        status = sst25_wait_for_erase(stripe->devices[i], type);
+        if (status)
+            return status;
+    }
+
+    return 0;
+}
@@ -3,6 +3,30 @@
 #include <math.h>
 #include <errno.h>
 
+#define TSL2563_LUX_SCALE 14
+#define TSL2563_RATIO_SCALE 9
+
+struct tsl2563_lux_segment
+{
+    uint16_t ratio;                                /*!< Upper bound of CH1/CH0 in RATIO_SCALE */
+    uint16_t b;                                    /*!< CH0 coefficient in LUX_SCALE */
+    uint16_t m;                                    /*!< CH1 coefficient in LUX_SCALE */
+};
+
+//! Piecewise linear approximation of lux formula, T, FN and CL packages.
+static const struct tsl2563_lux_segment tsl2563_lux_segments[] =
+{
+    {0x0040, 0x01f2, 0x01be},
+    {0x0080, 0x0214, 0x02d1},
+    {0x00c0, 0x023f, 0x037b},
+    {0x0100, 0x0270, 0x03fe},
+    {0x0138, 0x016f, 0x01fc},
+    {0x019a, 0x00d2, 0x00fb},
+    {0x029a, 0x0018, 0x0012},
+};
+
+#define TSL2563_LUX_SEGMENTS (sizeof(tsl2563_lux_segments) / sizeof(tsl2563_lux_segments[0]))
+
 int tsl2563_init_struct(struct i2c_adapter *adapter, struct tsl2563 *device, uint8_t addr_pin)
 {
     switch (addr_pin)
@@ -49,22 +73,60 @@ int tsl2563_set_gain(struct tsl2563 *device, uint8_t gain)
     return i2c_write_byte_data(&device->client, TSL2563_REGISTER_TIMING, timing);
 }
 
+int tsl2563_set_timing(struct tsl2563 *device, uint8_t gain, uint8_t time)
+{
+    if ((gain > 1) || (time > 3))
+        return -EINVAL;
+
+    return i2c_write_byte_data(&device->client, TSL2563_REGISTER_TIMING, (gain << 4) | time);
+}
+
+int tsl2563_set_threshold(struct tsl2563 *device, uint16_t low, uint16_t high)
+{
+    uint8_t data[4] = {low & 0xff, low >> 8, high & 0xff, high >> 8};
+
+    return i2c_write_block_data(&device->client, TSL2563_REGISTER_THRESHLOWLOW | TSL2563_COMMAND_BLOCK, 4, data);
+}
+
+int tsl2563_set_interrupt(struct tsl2563 *device, uint8_t control, uint8_t persist)
+{
+    if ((control > 3) || (persist > 15))
+        return -EINVAL;
+
+    return i2c_write_byte_data(&device->client, TSL2563_REGISTER_INTERRUPT, (control << 4) | persist);
+}
+
+int tsl2563_clear_interrupt(struct tsl2563 *device)
+{
+    return i2c_write_byte(&device->client, TSL2563_REGISTER_CONTROL | TSL2563_COMMAND_CLEAR);
+}
+
 int tsl2563_read_channel(struct tsl2563 *device, uint8_t channel, uint16_t *value)
 {
     if (channel > 1)
         return -EINVAL;
 
     uint8_t base_addr = channel ? TSL2563_REGISTER_DATA1LOW : TSL2563_REGISTER_DATA0LOW;
+    uint8_t data[2];
 
-    int result = i2c_read_byte_data(&device->client, base_addr);
+    // Word protocol reads low and high byte in one transaction.
+    int result = i2c_read_block_data(&device->client, base_addr | TSL2563_COMMAND_WORD, 2, data);
     if (result < 0)
         return result;
-    *value = ((uint16_t)result) & 0xff;
+    *value = data[0] | (data[1] << 8);
 
-    result = i2c_read_byte_data(&device->client, base_addr + 1);
+    return 0;
+}
+
+int tsl2563_read_channels(struct tsl2563 *device, uint16_t *channel0, uint16_t *channel1)
+{
+    uint8_t data[4];
+
+    int result = i2c_read_block_data(&device->client, TSL2563_REGISTER_DATA0LOW | TSL2563_COMMAND_BLOCK, 4, data);
     if (result < 0)
         return result;
-    *value |= (((uint16_t)result) & 0xff) << 8;
+    *channel0 = data[0] | (data[1] << 8);
+    *channel1 = data[2] | (data[3] << 8);
 
     return 0;
 }
@@ -106,3 +168,54 @@ float tsl2563_calc_lux(uint16_t channel0, uint16_t channel1, uint8_t gain)
 
     return result;
 }
+
+uint32_t tsl2563_calc_lux_int(uint16_t channel0, uint16_t channel1, uint8_t gain, uint8_t time)
+{
+    const struct tsl2563_lux_segment *segment = tsl2563_lux_segments;
+    uint32_t scale, ch0, ch1, ratio = 0, b, m;
+    uint16_t max;
+
+    switch (time)
+    {
+    case TSL2563_INT_14MS:
+        scale = TSL2563_CH_SCALE_14MS;
+        max = TSL2563_MAX_14MS;
+        break;
+    case TSL2563_INT_101MS:
+        scale = TSL2563_CH_SCALE_101MS;
+        max = TSL2563_MAX_101MS;
+        break;
+    default:
+        scale = TSL2563_CH_SCALE_402MS;
+        max = TSL2563_MAX_402MS;
+        break;
+    }
+
+    if (gain == TSL2563_GAIN_1X)
+        scale <<= 4;
+
+    // Products fit in 32 bits, as channels are clamped to full scale of integration time.
+    if (channel0 > max)
+        channel0 = max;
+    if (channel1 > max)
+        channel1 = max;
+    ch0 = (channel0 * scale) >> TSL2563_CH_SCALE;
+    ch1 = (channel1 * scale) >> TSL2563_CH_SCALE;
+
+    if (ch0)
+        ratio = (((ch1 << (TSL2563_RATIO_SCALE + 1)) / ch0) + 1) >> 1;
+
+    while ((segment < tsl2563_lux_segments + TSL2563_LUX_SEGMENTS) && (ratio > segment->ratio))
+        segment++;
+
+    // Light is not measurable above last ratio.
+    if (segment == tsl2563_lux_segments + TSL2563_LUX_SEGMENTS)
+        return 0;
+
+    b = ch0 * segment->b;
+    m = ch1 * segment->m;
+    if (m >= b)
+        return 0;
+
+    return (b - m + (1 << (TSL2563_LUX_SCALE - 1))) >> TSL2563_LUX_SCALE;
+}
@@ -0,0 +1,183 @@
+#include "bm/tsl2563_auto.h"
+#include "bm/tsl2563.h"
+#include <bm/delay.h>
+#include <errno.h>
+
+struct tsl2563_range
+{
+    uint8_t gain;                                  /*!< TSL2563_GAIN_* */
+    uint8_t time;                                  /*!< TSL2563_INT_* */
+    uint16_t cycle;                                /*!< Integration cycle, ms, rounded up */
+    uint16_t max;                                  /*!< Full scale count */
+    uint32_t scale;                                /*!< Count scale to 16x 402 ms, as in tsl2563_calc_lux_int() */
+};
+
+static const struct tsl2563_range tsl2563_ranges[TSL2563_AUTO_RANGES] =
+{
+    {TSL2563_GAIN_1X, TSL2563_INT_14MS, 14, TSL2563_MAX_14MS, TSL2563_CH_SCALE_14MS << 4},
+    {TSL2563_GAIN_1X, TSL2563_INT_101MS, 101, TSL2563_MAX_101MS, TSL2563_CH_SCALE_101MS << 4},
+    {TSL2563_GAIN_16X, TSL2563_INT_14MS, 14, TSL2563_MAX_14MS, TSL2563_CH_SCALE_14MS},
+    {TSL2563_GAIN_1X, TSL2563_INT_402MS, 402, TSL2563_MAX_402MS, TSL2563_CH_SCALE_402MS << 4},
+    {TSL2563_GAIN_16X, TSL2563_INT_101MS, 101, TSL2563_MAX_101MS, TSL2563_CH_SCALE_101MS},
+    {TSL2563_GAIN_16X, TSL2563_INT_402MS, 402, TSL2563_MAX_402MS, TSL2563_CH_SCALE_402MS},
+};
+
+//! Channel 0 level, below which range may be stepped up.
+static uint16_t tsl2563_auto_up_level(uint8_t range)
+{
+    const struct tsl2563_range *current = &tsl2563_ranges[range];
+    const struct tsl2563_range *next;
+
+    if (range == TSL2563_AUTO_RANGES - 1)
+        return 0;
+
+    next = &tsl2563_ranges[range + 1];
+    return ((uint32_t)(next->max / 2) * next->scale) / current->scale;
+}
+
+//! Channel level, above which range is stepped down.
+static uint16_t tsl2563_auto_down_level(uint8_t range)
+{
+    return tsl2563_ranges[range].max - (tsl2563_ranges[range].max >> 4);
+}
+
+static int tsl2563_auto_set_range(struct tsl2563_auto *ctl, uint8_t range)
+{
+    int result = tsl2563_set_timing(ctl->device, tsl2563_ranges[range].gain, tsl2563_ranges[range].time);
+    if (result < 0)
+        return result;
+
+    // Cycle in progress may be integrated partly with previous range.
+    ctl->range = range;
+    ctl->discard = 1;
+    ctl->deadline = get_tick_count() + tsl2563_ranges[range].cycle + 1;
+
+    return 0;
+}
+
+static uint8_t tsl2563_auto_select(uint8_t range, uint16_t channel0, uint16_t channel1)
+{
+    uint16_t down = tsl2563_auto_down_level(range);
+    uint32_t counts;
+    uint8_t next;
+
+    if ((channel0 >= down) || (channel1 >= down))
+        return range ? range - 1 : range;
+
+    // Products fit in 32 bits, as counts are below full scale of range.
+    counts = channel0 * tsl2563_ranges[range].scale;
+    for (next = TSL2563_AUTO_RANGES - 1; next > range; next--)
+    {
+        if (counts / tsl2563_ranges[next].scale < tsl2563_ranges[next].max / 2)
+            return next;
+    }
+
+    return range;
+}
+
+static int tsl2563_auto_arm(struct tsl2563_auto *ctl)
+{
+    uint16_t margin = (ctl->channel0 >> ctl->window) + 1;
+    uint16_t low = ctl->channel0 > margin ? ctl->channel0 - margin : 0;
+    uint16_t high = (uint32_t)ctl->channel0 + margin < 0xffff ? ctl->channel0 + margin : 0xffff;
+    uint16_t up = tsl2563_auto_up_level(ctl->range);
+    uint16_t down = tsl2563_auto_down_level(ctl->range);
+    int result;
+
+    // Range is adjusted on interrupt, so window doesn't span range limits.
+    if (low < up)
+        low = up;
+    if (high > down)
+        high = down;
+
+    ctl->irq = 0;
+
+    if ((result = tsl2563_set_threshold(ctl->device, low, high)) < 0)
+        return result;
+
+    return tsl2563_clear_interrupt(ctl->device);
+}
+
+int tsl2563_auto_init(struct tsl2563_auto *ctl, struct tsl2563 *device, uint8_t range)
+{
+    if (range >= TSL2563_AUTO_RANGES)
+        return -EINVAL;
+
+    ctl->device = device;
+    ctl->window = 0;
+    ctl->irq = 0;
+    ctl->channel0 = 0;
+    ctl->channel1 = 0;
+    ctl->lux = 0;
+
+    return tsl2563_auto_set_range(ctl, range);
+}
+
+int tsl2563_auto_poll(struct tsl2563_auto *ctl)
+{
+    const struct tsl2563_range *range;
+    uint16_t channel0, channel1;
+    uint8_t next;
+    int result;
+
+    if (ctl->window && !ctl->irq)
+        return 0;
+
+    if (get_tick_count() < ctl->deadline)
+        return 0;
+
+    range = &tsl2563_ranges[ctl->range];
+    ctl->deadline = get_tick_count() + range->cycle;
+
+    if ((result = tsl2563_read_channels(ctl->device, &channel0, &channel1)) < 0)
+        return result;
+
+    if (ctl->discard)
+    {
+        ctl->discard--;
+        return 0;
+    }
+
+    next = tsl2563_auto_select(ctl->range, channel0, channel1);
+    if (next != ctl->range)
+        return tsl2563_auto_set_range(ctl, next);
+
+    ctl->channel0 = channel0;
+    ctl->channel1 = channel1;
+    ctl->lux = tsl2563_calc_lux_int(channel0, channel1, range->gain, range->time);
+
+    if (ctl->window && ((result = tsl2563_auto_arm(ctl)) < 0))
+        return result;
+
+    return 1;
+}
+
+int tsl2563_auto_set_window(struct tsl2563_auto *ctl, uint8_t window)
+{
+    int result;
+
+    if (window > 15)
+        return -EINVAL;
+
+    if (!window)
+    {
+        ctl->window = 0;
+        if ((result = tsl2563_set_interrupt(ctl->device, TSL2563_INTR_DISABLED, 0)) < 0)
+            return result;
+        return tsl2563_clear_interrupt(ctl->device);
+    }
+
+    if ((result = tsl2563_set_interrupt(ctl->device, TSL2563_INTR_LEVEL, TSL2563_AUTO_PERSIST)) < 0)
+        return result;
+
+    // Window is armed around next reading.
+    ctl->window = window;
+    ctl->irq = 1;
+
+    return 0;
+}
+
+void tsl2563_auto_irq(struct tsl2563_auto *ctl)
+{
+    ctl->irq = 1;
+}
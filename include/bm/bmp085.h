@@ -26,6 +26,8 @@
 #define BMP085_EE_MD_ADDRESS 0xBE
 #define BMP085_MEASURE_ADDRESS 0xF6
 
+#define BMP085_EE_SIZE 22
+
 #define BMP085_CONTROL_REGISTER 0xF4
 
 #define BMP085_TEMPERATURE_MEASURE 0x2E
@@ -46,6 +48,22 @@ struct bmp085_coefficients
     int16_t md;
 };
 
+//! Coefficient products, which don't depend on measurements.
+struct bmp085_prepared
+{
+    int32_t ac1_4;                                 /*!< AC1 * 4 */
+    int32_t mc_11;                                 /*!< MC << 11 */
+};
+
+//! Compensation terms, which depend on temperature only.
+struct bmp085_terms
+{
+    int32_t b3;
+    uint32_t b4;
+    uint32_t b7_scale;                             /*!< 50000 >> oss */
+    int16_t temperature;                           /*!< Compensated temperature, 0.1 C */
+};
+
 struct bmp085
 {
     struct i2c_client client;
@@ -64,8 +82,22 @@ int bmp085_read_measurement(struct bmp085 *bmp085, uint16_t *measurement);
 int bmp085_measure_pressure(struct bmp085 *bmp085, uint32_t *pressure, uint8_t oss);
 int bmp085_measure_temperature(struct bmp085 *bmp085, uint16_t *temperature);
 
+/*! Read calibration EEPROM in one transaction. */
 int bmp085_read_coefficients(struct bmp085 *bmp085);
 
+//! Precompute coefficient products once per coefficient set, for bmp085_calc_terms().
+void bmp085_prepare_coefficients(const struct bmp085_coefficients *c, struct bmp085_prepared *prepared);
+
+/*! Compute temperature and terms for bmp085_calc_pressure().
+ * Terms may be reused for pressure readings while temperature doesn't change.
+ * \param prepared products of the same coefficients from bmp085_prepare_coefficients().
+ */
+void bmp085_calc_terms(const struct bmp085_coefficients *c, const struct bmp085_prepared *prepared, uint16_t ut,
+                       uint8_t oss, struct bmp085_terms *terms);
+
+//! Compute pressure in Pa from raw pressure and terms of the same oversampling.
+uint32_t bmp085_calc_pressure(const struct bmp085_terms *terms, uint32_t up);
+
 void bmp085_calc(struct bmp085_coefficients * c, uint32_t up, uint16_t ut, uint32_t *pressure, int16_t *temperature, uint8_t oss);
 
 //! \} \}
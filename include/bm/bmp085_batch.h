@@ -0,0 +1,44 @@
+#ifndef BAREMETAL_BMP085_BATCH_H
+#define BAREMETAL_BMP085_BATCH_H
+
+/*!
+ * \defgroup drivers Drivers - Device drivers
+ * \{
+ * \defgroup bmp085_batch BMP085 batch - Compensation of logged raw samples
+ * \{
+ */
+
+#include <stdint.h>
+#include <bm/bmp085.h>
+
+//! Sea level pressure of standard atmosphere, Pa.
+#define BMP085_SEA_LEVEL_PRESSURE 101325
+
+/*! Compensate raw samples of one device, results are the same as of bmp085_calc().
+ * SSE2 or AVX2 is used when compiler targets it, scalar code reuses temperature terms
+ * while raw temperature doesn't change. AVX2 needs -mavx2 or matching -march, which
+ * BMP085_AVX2 CMake option adds for this file only. Vector code requires B4 above 1, which holds
+ * for any raw temperature of real device.
+ * \param c coefficients.
+ * \param up raw pressures.
+ * \param ut raw temperatures.
+ * \param pressure compensated pressures, Pa.
+ * \param temperature compensated temperatures, 0.1 C.
+ * \param count number of samples.
+ * \param oss pressure oversampling of samples.
+ */
+void bmp085_calc_batch(const struct bmp085_coefficients *c, const uint32_t *up, const uint16_t *ut,
+                       uint32_t *pressure, int16_t *temperature, uint32_t count, uint8_t oss);
+
+/*! Altitude by international barometric formula, interpolated from table.
+ * Error is below 0.1 m near sea level and below 0.7 m at 10 km.
+ * \param pressure pressure, Pa, 120000 at most.
+ * \param sea_level pressure at sea level, Pa, BMP085_SEA_LEVEL_PRESSURE by default.
+ * \returns altitude in decimeters, clamped to range from -1 km to 10 km of pressure
+ *          ratios 1.125 and 0.25.
+ */
+int32_t bmp085_altitude(uint32_t pressure, uint32_t sea_level);
+
+//! \} \}
+
+#endif
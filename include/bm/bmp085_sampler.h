@@ -0,0 +1,80 @@
+#ifndef BAREMETAL_BMP085_SAMPLER_H
+#define BAREMETAL_BMP085_SAMPLER_H
+
+/*!
+ * \defgroup drivers Drivers - Device drivers
+ * \{
+ * \defgroup bmp085_sampler BMP085 sampler - Non-blocking conversions
+ * \{
+ */
+
+#include <stdint.h>
+#include <bm/bmp085.h>
+
+#define BMP085_SAMPLER_IDLE 0
+#define BMP085_SAMPLER_TEMPERATURE 1               /*!< Temperature conversion in progress */
+#define BMP085_SAMPLER_PRESSURE 2                  /*!< Pressure conversion in progress */
+
+/*!
+ * Conversion engine. Conversion is started and poll finishes it, when EOC was reported
+ * or maximum conversion time has passed, and starts next one at once. Temperature is
+ * converted once per interval pressure readings, so each reading in between costs one
+ * pressure conversion.
+ */
+struct bmp085_sampler
+{
+    struct bmp085 *bmp085;
+    uint8_t oss;                                   /*!< Pressure oversampling, from 0 to 3 */
+    uint8_t interval;                              /*!< Pressure readings per temperature conversion, at least 1 */
+    uint8_t continuous;                            /*!< Next conversion starts after reading */
+
+    uint8_t state;                                 /*!< BMP085_SAMPLER_* */
+    uint8_t count;                                 /*!< Pressure readings since temperature conversion */
+    volatile uint8_t eoc;                          /*!< Set by bmp085_sampler_eoc() */
+    uint64_t deadline;                             /*!< Tick count, when conversion is complete for sure */
+
+    struct bmp085_prepared prepared;               /*!< Products of device coefficients */
+    uint16_t ut;                                   /*!< Last raw temperature */
+    struct bmp085_terms terms;                     /*!< Compensation terms of last temperature */
+    uint32_t up;                                   /*!< Last raw pressure */
+    uint32_t pressure;                             /*!< Last compensated pressure, Pa */
+    int16_t temperature;                           /*!< Last compensated temperature, 0.1 C */
+};
+
+//! Maximum conversion time in milliseconds, rounded up.
+uint8_t bmp085_conversion_time(uint8_t measure, uint8_t oss);
+
+/*! Init sampler. Coefficients must be read, sampler is initialized again if they change.
+ * \param sampler sampler.
+ * \param bmp085 device.
+ * \param oss pressure oversampling, from 0 to 3.
+ * \param interval pressure readings per temperature conversion, 1 to convert temperature
+ *        before each pressure.
+ * \returns 0 on success, -EINVAL if parameter is invalid.
+ */
+int bmp085_sampler_init(struct bmp085_sampler *sampler, struct bmp085 *bmp085, uint8_t oss, uint8_t interval);
+
+/*! Start sampling with temperature conversion.
+ * \param sampler sampler.
+ * \param continuous start next conversion after each reading, readings come at maximum
+ *        rate for oversampling then.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int bmp085_sampler_start(struct bmp085_sampler *sampler, uint8_t continuous);
+
+//! Stop sampling, conversion in progress is dropped.
+void bmp085_sampler_stop(struct bmp085_sampler *sampler);
+
+/*! Finish conversion if it is complete and start next one.
+ * May be called from timer or main loop.
+ * \returns 1 if new reading is stored in sampler, 0 if there is none yet, negative error
+ *          code otherwise.
+ */
+int bmp085_sampler_poll(struct bmp085_sampler *sampler);
+
+//! Report end of conversion, call from EOC pin interrupt.
+void bmp085_sampler_eoc(struct bmp085_sampler *sampler);
+
+//! \} \}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef BAREMETAL_CRC_H
+#define BAREMETAL_CRC_H
+
+/*! \defgroup crc CRC - Cyclic redundancy check functions
+ * \{
+ */
+
+#include <stdint.h>
+
+//! Initial value for crc16_ccitt().
+#define CRC16_CCITT_INIT 0xFFFF
+
+/*! Update CRC-16/CCITT (polynomial 0x1021, MSB first).
+ * \param crc current CRC value, CRC16_CCITT_INIT for new calculation.
+ * \param data data.
+ * \param size data size.
+ * \returns updated CRC value.
+ */
+uint16_t crc16_ccitt(uint16_t crc, const void *data, uint16_t size);
+
+//! Initial value for crc32().
+#define CRC32_INIT 0x00000000
+
+/*! Update CRC-32 (IEEE 802.3, polynomial 0x04C11DB7 reflected), as used by zlib.
+ * \param crc current CRC value, CRC32_INIT for new calculation.
+ * \param data data.
+ * \param size data size.
+ * \returns updated CRC value.
+ */
+uint32_t crc32(uint32_t crc, const void *data, uint32_t size);
+
+//! \}
+
+#endif
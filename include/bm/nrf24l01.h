@@ -77,11 +77,30 @@
 #define NRF24L01_ERX_P0 0x01
 
 // RF_SETUP
+#define NRF24L01_RF_DR_LOW 0x20
 #define NRF24L01_PLL_LOCK 0x10
 #define NRF24L01_RF_DR 0x8
 #define NRF24L01_RF_PWR 0x6
 #define NRF24L01_LNA_HCURR 0x01
 
+// OBSERVE_TX
+#define NRF24L01_PLOS_CNT 0xF0
+#define NRF24L01_ARC_CNT 0x0F
+
+// CD (RPD on nRF24L01+)
+#define NRF24L01_CD 0x01
+
+// Data rates, RF_DR_LOW (250 kbps) is supported by nRF24L01+ only.
+#define NRF24L01_DATA_RATE_250K 0
+#define NRF24L01_DATA_RATE_1M 1
+#define NRF24L01_DATA_RATE_2M 2
+
+// PA levels
+#define NRF24L01_POWER_M18DBM 0
+#define NRF24L01_POWER_M12DBM 1
+#define NRF24L01_POWER_M6DBM 2
+#define NRF24L01_POWER_0DBM 3
+
 // STATUS
 #define NRF24L01_RX_DR 0x40
 #define NRF24L01_TX_DS 0x20
@@ -101,11 +120,83 @@
 #define NRF24L01_EN_ACK_PAY 0x2
 #define NRF24L01_EN_DYN_ACK 0x1
 
+//! Time in milliseconds, in which payload must be sent or fail by MAX_RT, before radio is taken as stuck.
+#ifndef NRF24L01_TX_TIMEOUT
+#define NRF24L01_TX_TIMEOUT 100
+#endif
+
+//! RX ring size, power of two up to 128.
+#ifndef NRF24L01_RX_RING_SIZE
+#define NRF24L01_RX_RING_SIZE 8
+#endif
+
+#if (NRF24L01_RX_RING_SIZE & (NRF24L01_RX_RING_SIZE - 1)) || (NRF24L01_RX_RING_SIZE > 128)
+#error "NRF24L01_RX_RING_SIZE must be power of two up to 128"
+#endif
+
+//! Received payload.
+struct nrf24l01_frame
+{
+    uint8_t pipe;                                  /*!< Pipe on which payload has been received */
+    uint8_t size;                                  /*!< Payload size */
+    uint8_t data[32];                              /*!< Payload */
+};
+
+//! Ring of received payloads, filled from IRQ handler.
+struct nrf24l01_rx_ring
+{
+    struct nrf24l01_frame frames[NRF24L01_RX_RING_SIZE];
+    volatile uint8_t head;                         /*!< Written by IRQ handler only */
+    volatile uint8_t tail;                         /*!< Written by consumer only */
+    uint16_t dropped;                              /*!< Payloads dropped because ring was full */
+};
+
+/*! Complete configuration, applied by nrf24l01_apply_config().
+ * nrf24l01_init_config() fills it with reset values.
+ */
+struct nrf24l01_config
+{
+    uint8_t crc;                                   /*!< CRC length in bytes: 0, 1 or 2 */
+    uint8_t irq_mask;                              /*!< NRF24L01_MASK_* interrupts not reflected on IRQ pin */
+    uint8_t power_up;                              /*!< Power up device */
+    uint8_t rx;                                    /*!< PRX mode */
+    uint8_t auto_ack;                              /*!< Pipes with auto acknowledgement, bitmask */
+    uint8_t pipes;                                 /*!< Enabled RX pipes, bitmask */
+    uint8_t address_width;                         /*!< Address width, from 3 to 5 bytes */
+    uint8_t retransmit_delay;                      /*!< Auto retransmit delay, (delay + 1) * 250 us */
+    uint8_t retransmit_count;                      /*!< Auto retransmit count, from 0 to 15 */
+    uint8_t channel;                               /*!< RF channel, from 0 to 127 */
+    uint8_t rate;                                  /*!< NRF24L01_DATA_RATE_* */
+    uint8_t power;                                 /*!< NRF24L01_POWER_* */
+    uint8_t tx_address[5];
+    uint8_t rx_address[2][5];                      /*!< Pipe 0 and pipe 1 addresses */
+    uint8_t rx_address_lsb[4];                     /*!< Least significant address bytes of pipes 2-5 */
+    uint8_t payload_size[6];                       /*!< Static payload sizes */
+    uint8_t dynamic_size;                          /*!< Pipes with dynamic payload length, bitmask */
+    uint8_t features;                              /*!< NRF24L01_EN_* bits of FEATURE */
+};
+
+//! Register image, used as shadow of device registers.
+struct nrf24l01_registers
+{
+    uint8_t reg[NRF24L01_REG_FEATURE + 1];         /*!< Single byte registers, indexed by address */
+    uint8_t rx_addr_p0[5];
+    uint8_t rx_addr_p1[5];
+    uint8_t tx_addr[5];
+};
+
 struct nrf24l01
 {
     struct spi_client spi;
     uint16_t ce_gpio;
     uint16_t irq_gpio;
+
+    struct nrf24l01_rx_ring *rx_ring;              /*!< RX ring, IRQ mode is enabled if not 0 */
+    volatile uint16_t tx_done;                     /*!< TX_DS interrupts handled */
+    volatile uint16_t tx_failed;                   /*!< MAX_RT interrupts handled */
+
+    uint8_t status;                                /*!< STATUS clocked out by last command */
+    uint32_t saved_transactions;                   /*!< SPI transactions saved by using STATUS of other commands */
 };
 
 int nrf24l01_init_struct(struct spi_master* master, uint16_t cs_gpio, uint16_t ce_gpio, uint16_t irq_gpio, struct nrf24l01 *device);
@@ -124,7 +215,23 @@ int nrf24l01_write_address_register(struct nrf24l01 *device, uint8_t reg, uint8_
 int nrf24l01_setup_retransmit(struct nrf24l01 *device, uint8_t delay, uint8_t count);
 //! Setup RF channel.
 int nrf24l01_set_channel(struct nrf24l01 *device, uint8_t channel);
-//! Get status.
+//! Set data rate, one of NRF24L01_DATA_RATE_*.
+int nrf24l01_set_data_rate(struct nrf24l01 *device, uint8_t rate);
+//! Set PA level, one of NRF24L01_POWER_*.
+int nrf24l01_set_power(struct nrf24l01 *device, uint8_t level);
+/*! Get transmit statistics.
+ * \param device device.
+ * \param lost lost packets count, saturates at 15 and is reset by channel change. May be 0.
+ * \param retransmits retransmits of last packet. May be 0.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_get_observe_tx(struct nrf24l01 *device, uint8_t *lost, uint8_t *retransmits);
+/*! Check carrier (nRF24L01) or received power above -64 dBm (nRF24L01+) on current channel.
+ * Device must be in RX mode for at least 170 us.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_get_carrier(struct nrf24l01 *device, uint8_t *detected);
+//! Get status. STATUS clocked out by every command is also kept in device->status.
 int nrf24l01_get_status(struct nrf24l01 *device, uint8_t *status);
 //! Clear IRQ flags.
 int nrf24l01_clear_irq(struct nrf24l01 *device, uint8_t irq);
@@ -132,6 +239,8 @@ int nrf24l01_clear_irq(struct nrf24l01 *device, uint8_t irq);
 int nrf24l01_set_rx_address(struct nrf24l01 *device, uint8_t pipe, uint8_t *addr);
 //! Enable RX pipes.
 int nrf24l01_enable_pipes(struct nrf24l01 *device, uint8_t pipes);
+//! Disable RX pipes.
+int nrf24l01_disable_pipes(struct nrf24l01 *device, uint8_t pipes);
 //! Set TX address.
 int nrf24l01_set_tx_address(struct nrf24l01 *device, uint8_t addr[5]);
 //! Set RX payload size.
@@ -142,6 +251,14 @@ int nrf24l01_get_fifo_status(struct nrf24l01 *device, uint8_t *status);
 int nrf24l01_enable_dynamic_size(struct nrf24l01 *device);
 //! Enable dynamic payload length on pipes.
 int nrf24l01_enable_dynamic_pipe_size(struct nrf24l01 *device, uint8_t pipes);
+//! Enable payloads with ACK, requires dynamic payload length.
+int nrf24l01_enable_ack_payload(struct nrf24l01 *device);
+//! Disable payloads with ACK.
+int nrf24l01_disable_ack_payload(struct nrf24l01 *device);
+//! Enable W_TX_PAYLOAD_NO_ACK command.
+int nrf24l01_enable_dynamic_ack(struct nrf24l01 *device);
+//! Disable W_TX_PAYLOAD_NO_ACK command.
+int nrf24l01_disable_dynamic_ack(struct nrf24l01 *device);
 //! Enable dynamic payload length on device.
 int nrf24l01_disable_dynamic_size(struct nrf24l01 *device);
 //! Enable dynamic payload length on pipes.
@@ -151,6 +268,19 @@ int nrf24l01_disable_dynamic_pipe_size(struct nrf24l01 *device, uint8_t pipes);
 int nrf24l01_read_payload(struct nrf24l01 *device, uint8_t size, uint8_t *data, uint8_t *pipe);
 //! Write TX payload.
 int nrf24l01_write_payload(struct nrf24l01 *device, uint8_t size, uint8_t *data);
+//! Write TX payload, which isn't acknowledged by receiver. Requires dynamic ACK feature.
+int nrf24l01_write_payload_no_ack(struct nrf24l01 *device, uint8_t size, uint8_t *data);
+/*! Preload payload, which is sent with ACK to next payload received on pipe in PRX mode.
+ * Up to 3 ACK payloads share TX FIFO. With nrf24l01_transfer() on PTX side this gives
+ * request/response in single air transaction, response must be loaded before request
+ * arrives (e.g. latest telemetry or response to previous request).
+ * \param device device.
+ * \param pipe pipe, from 0 to 5.
+ * \param size payload size, up to 32.
+ * \param data payload.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_write_ack_payload(struct nrf24l01 *device, uint8_t pipe, uint8_t size, uint8_t *data);
 
 //! Toggle FEATURE register writable. See datasheet for more info.
 int nrf24l01_toggle_features(struct nrf24l01 *device);
@@ -170,13 +300,108 @@ int nrf24l01_enter_tx(struct nrf24l01 *device);
 //! Enter standby mode.
 int nrf24l01_enter_standby(struct nrf24l01 *device);
 
-//! Send data as PTX.
+/*! Send data as PTX, split to 32-byte payloads. IRQ mode must be disabled.
+ * \returns 0 on success, -ETIMEDOUT on MAX_RT or if radio doesn't respond in
+ *          NRF24L01_TX_TIMEOUT, -EBUSY if TX FIFO is full or IRQ mode is enabled,
+ *          negative error code otherwise.
+ */
 int nrf24l01_send(struct nrf24l01 *device, uint8_t *data, uint16_t size);
+/*! Send data as PTX keeping TX FIFO full.
+ * Data is split to 32-byte payloads, up to 3 payloads are queued while CE stays high
+ * and FIFO is refilled as soon as payloads are sent. Payload that reached MAX_RT is
+ * dropped and following payloads are sent anyway. IRQ mode must be disabled.
+ * \param device device.
+ * \param data data.
+ * \param size data size.
+ * \param results per-payload results, (size + 31) / 32 items: 0 if payload was
+ *        acknowledged, -ETIMEDOUT if it reached MAX_RT, -EIO if it wasn't sent or its
+ *        delivery is unknown, as stream was aborted. May be 0.
+ * \returns 0 if all payloads were sent, -ETIMEDOUT if some payloads reached MAX_RT,
+ *          -EIO if radio made no progress in NRF24L01_TX_TIMEOUT, -EBUSY in IRQ mode,
+ *          negative error code otherwise.
+ */
+int nrf24l01_send_stream(struct nrf24l01 *device, uint8_t *data, uint16_t size, int8_t *results);
+/*! Send single payload as PTX and get payload carried by ACK.
+ * ACK payloads and dynamic payload length must be enabled on both sides, including pipe 0 on PTX.
+ * IRQ mode must be disabled.
+ * \param device device.
+ * \param data payload.
+ * \param size payload size, up to 32.
+ * \param ack ACK payload, the size of this array must be at least 32 bytes.
+ * \param ack_size ACK payload size, 0 if ACK was empty.
+ * \returns 0 on success, -ETIMEDOUT on MAX_RT or if radio doesn't respond in
+ *          NRF24L01_TX_TIMEOUT, -EBUSY if TX FIFO is full or IRQ mode is enabled,
+ *          negative error code otherwise.
+ */
+int nrf24l01_transfer(struct nrf24l01 *device, uint8_t *data, uint8_t size, uint8_t *ack, uint8_t *ack_size);
+/*! Send single payload as PTX without ACK.
+ * Dynamic ACK feature must be enabled. Device must be in standby mode and is left in it.
+ * \param device device.
+ * \param data payload.
+ * \param size payload size, up to 32.
+ * \returns 0 on success, -ETIMEDOUT if payload isn't sent in NRF24L01_TX_TIMEOUT,
+ *          negative error code otherwise.
+ */
+int nrf24l01_send_no_ack(struct nrf24l01 *device, uint8_t *data, uint8_t size);
 //! Recieve data.
 int nrf24l01_receive_packet(struct nrf24l01 *device, uint8_t* pipe, uint8_t *data, uint8_t *size, uint16_t timeout);
 // Ugly routine
 int nrf24l01_receive(struct nrf24l01 *device, uint8_t* pipe, uint8_t *data, uint16_t size, uint16_t timeout);
 
+/*! Enable IRQ-driven mode.
+ * Interrupts are unmasked and IRQ pin is requested as input. Platform code must
+ * call nrf24l01_irq_handler() on IRQ pin falling edge.
+ * Handler talks to device over SPI, so IRQ pin interrupt must be masked around any
+ * other call on device, while IRQ mode is enabled. Functions, which send as PTX and
+ * wait for TX flags, return -EBUSY in IRQ mode, as handler clears flags.
+ * \param device device.
+ * \param ring ring that receives payloads.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_enable_irq(struct nrf24l01 *device, struct nrf24l01_rx_ring *ring);
+/*! Disable IRQ-driven mode and mask interrupts.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_disable_irq(struct nrf24l01 *device);
+/*! Handle IRQ.
+ * Reads STATUS once, moves all RX payloads to ring and counts TX_DS/MAX_RT events.
+ * TX FIFO is flushed on MAX_RT.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_irq_handler(struct nrf24l01 *device);
+/*! Get received payload without waiting, from RX ring in IRQ mode or from RX FIFO otherwise.
+ * \returns 0 on success, -EAGAIN if there is no payload, negative error code otherwise.
+ */
+int nrf24l01_read_frame(struct nrf24l01 *device, struct nrf24l01_frame *frame);
+/*! Get frame from RX ring.
+ * \returns 0 on success, -EAGAIN if ring is empty, -EINVAL if IRQ mode is disabled.
+ */
+int nrf24l01_dequeue(struct nrf24l01 *device, struct nrf24l01_frame *frame);
+
+//! Fill configuration with register reset values.
+void nrf24l01_init_config(struct nrf24l01_config *config);
+//! Fill register image with reset values, it is shadow of device after power on.
+void nrf24l01_reset_registers(struct nrf24l01_registers *regs);
+/*! Read configuration registers of device to image.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_read_registers(struct nrf24l01 *device, struct nrf24l01_registers *regs);
+/*! Apply configuration in one pass.
+ * Register image is built from configuration and only registers which differ from shadow
+ * are written, one transaction each; CONFIG is written last. Features are activated with
+ * nrf24l01_toggle_features() when FEATURE doesn't take new value (nRF24L01, non-plus).
+ * Registers keep their values in power down mode, so the same shadow makes wake-up
+ * a single CONFIG write.
+ * \param device device.
+ * \param config configuration.
+ * \param shadow known register values, e.g. from nrf24l01_reset_registers() or
+ *        nrf24l01_read_registers(). Updated with written values.
+ * \param verify read back written registers.
+ * \returns 0 on success, -EINVAL if configuration is invalid, -EIO if register didn't
+ *          take its value, negative error code otherwise.
+ */
+int nrf24l01_apply_config(struct nrf24l01 *device, const struct nrf24l01_config *config,
+                          struct nrf24l01_registers *shadow, uint8_t verify);
 
 //! \} \}
 
@@ -0,0 +1,101 @@
+#ifndef BAREMETAL_NRF24L01_BCAST_H
+#define BAREMETAL_NRF24L01_BCAST_H
+
+/*!
+ * \defgroup drivers Drivers - Device drivers
+ * \{
+ * \defgroup nrf24l01_bcast NRF24L01 broadcast - Unacknowledged broadcast with XOR parity
+ * \{
+ */
+
+#include <stdint.h>
+#include <bm/nrf24l01.h>
+
+/*!
+ * Data packets per parity packet, up to 16. One lost packet per group is recovered,
+ * airtime overhead is 1 / NRF24L01_BCAST_GROUP.
+ */
+#ifndef NRF24L01_BCAST_GROUP
+#define NRF24L01_BCAST_GROUP 4
+#endif
+
+#if (NRF24L01_BCAST_GROUP < 1) || (NRF24L01_BCAST_GROUP > 16)
+#error "NRF24L01_BCAST_GROUP must be from 1 to 16"
+#endif
+
+#define NRF24L01_BCAST_HEADER_SIZE 4
+#define NRF24L01_BCAST_PAYLOAD (32 - NRF24L01_BCAST_HEADER_SIZE)
+
+/*!
+ * Packet header. Packets are always 32 bytes, data is padded with zeros.
+ * Parity packet has index equal to count, its len and data are XOR of group packets.
+ */
+struct nrf24l01_bcast_header
+{
+    uint8_t group;                                 /*!< Group number, increments with each group */
+    uint8_t index;                                 /*!< Packet number in group */
+    uint8_t count;                                 /*!< Data packets in group, last group of data may be short */
+    uint8_t len;                                   /*!< Data size */
+};
+
+//! Broadcast channel, either transmitting or receiving.
+struct nrf24l01_bcast
+{
+    struct nrf24l01 *device;
+    uint8_t group;                                 /*!< Next sent group / received group number */
+    uint8_t listening;                             /*!< Receiver is in RX mode */
+
+    uint8_t active;                                /*!< Group is being received */
+    uint8_t done;                                  /*!< Group number holds last delivered group */
+    uint8_t final;                                 /*!< No more packets of group will come */
+    uint8_t count;                                 /*!< Data packets in group */
+    uint8_t pos;                                   /*!< Next data packet to deliver */
+    uint32_t mask;                                 /*!< Received packets, parity is bit count */
+    uint8_t len[NRF24L01_BCAST_GROUP + 1];
+    uint8_t data[NRF24L01_BCAST_GROUP + 1][NRF24L01_BCAST_PAYLOAD];
+
+    uint8_t pending;                               /*!< Packet of next group is kept in next */
+    uint8_t next[32];
+
+    uint32_t received;                             /*!< Data packets received */
+    uint32_t recovered;                            /*!< Data packets rebuilt from parity */
+    uint32_t lost;                                 /*!< Data packets lost */
+};
+
+/*! Init broadcast channel.
+ * Transmitter gets dynamic ACK feature enabled, which must be activated with
+ * nrf24l01_toggle_features() before on nRF24L01 (non-plus). Receivers use 32-byte
+ * payloads, either static or dynamic.
+ * \param bcast broadcast channel.
+ * \param device configured device.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_bcast_init(struct nrf24l01_bcast *bcast, struct nrf24l01 *device);
+
+/*! Broadcast data without ACK.
+ * Data is split to packets of NRF24L01_BCAST_PAYLOAD bytes, parity packet follows each
+ * group. TX FIFO is kept full while CE stays high. IRQ mode must be disabled.
+ * \param bcast broadcast channel.
+ * \param data data.
+ * \param size data size.
+ * \returns 0 on success, -ETIMEDOUT if radio doesn't send packet in NRF24L01_TX_TIMEOUT,
+ *          -EBUSY in IRQ mode, negative error code otherwise.
+ */
+int nrf24l01_bcast_send(struct nrf24l01_bcast *bcast, const uint8_t *data, uint16_t size);
+
+/*! Receive next data packet.
+ * Packets are delivered in order, lost packet is rebuilt if the rest of its group and
+ * parity were received, otherwise it is skipped and counted in lost.
+ * \param bcast broadcast channel.
+ * \param data output data, the size of this array must be at least NRF24L01_BCAST_PAYLOAD bytes.
+ * \param size data size.
+ * \param timeout receive timeout in milliseconds, 0 - wait forever. Unfinished group is
+ *        delivered on timeout.
+ * \returns 0 on success, -ETIMEDOUT on timeout, negative error code otherwise.
+ * \note Device stays in RX mode between calls, nrf24l01_enter_standby() stops receiving.
+ */
+int nrf24l01_bcast_receive(struct nrf24l01_bcast *bcast, uint8_t *data, uint8_t *size, uint16_t timeout);
+
+//! \} \}
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef BAREMETAL_NRF24L01_FRAG_H
+#define BAREMETAL_NRF24L01_FRAG_H
+
+/*!
+ * \defgroup drivers Drivers - Device drivers
+ * \{
+ * \defgroup nrf24l01_frag NRF24L01 fragmentation - Messages larger than one payload
+ * \{
+ */
+
+#include <stdint.h>
+#include <bm/nrf24l01.h>
+
+//! Maximum message size.
+#ifndef NRF24L01_FRAG_MAX_SIZE
+#define NRF24L01_FRAG_MAX_SIZE 2048
+#endif
+
+//! Number of reassembly buffers, shared by all pipes.
+#ifndef NRF24L01_FRAG_BUFFERS
+#define NRF24L01_FRAG_BUFFERS 4
+#endif
+
+//! Time in milliseconds after which incomplete message may be dropped to free its buffer.
+#ifndef NRF24L01_FRAG_TIMEOUT
+#define NRF24L01_FRAG_TIMEOUT 500
+#endif
+
+//! Number of send attempts for each fragment.
+#ifndef NRF24L01_FRAG_RETRIES
+#define NRF24L01_FRAG_RETRIES 4
+#endif
+
+//! Number of completed messages remembered to drop their late duplicates.
+#ifndef NRF24L01_FRAG_HISTORY
+#define NRF24L01_FRAG_HISTORY 8
+#endif
+
+/*!
+ * Time in milliseconds for which completed message is remembered. Sender, which restarts
+ * from message ID 0, isn't taken for duplicate after that.
+ */
+#ifndef NRF24L01_FRAG_HISTORY_TIMEOUT
+#define NRF24L01_FRAG_HISTORY_TIMEOUT NRF24L01_FRAG_TIMEOUT
+#endif
+
+#define NRF24L01_FRAG_HEADER_SIZE 4
+#define NRF24L01_FRAG_PAYLOAD (32 - NRF24L01_FRAG_HEADER_SIZE)
+#define NRF24L01_FRAG_MAX_FRAGMENTS ((NRF24L01_FRAG_MAX_SIZE + NRF24L01_FRAG_PAYLOAD - 1) / NRF24L01_FRAG_PAYLOAD)
+
+#if NRF24L01_FRAG_MAX_FRAGMENTS > 255
+#error "NRF24L01_FRAG_MAX_SIZE must fit in 255 fragments"
+#endif
+
+/*!
+ * Fragment header, followed by up to NRF24L01_FRAG_PAYLOAD bytes of message.
+ * All fragments but last one are full.
+ */
+struct nrf24l01_frag_header
+{
+    uint8_t id;                                    /*!< Message ID, increments with each message */
+    uint8_t index;                                 /*!< Fragment number */
+    uint8_t size[2];                               /*!< Message size, little-endian */
+};
+
+//! Completed message.
+struct nrf24l01_frag_history
+{
+    uint16_t key;                                  /*!< Pipe and ID, 0xFFFF if entry is empty */
+    uint64_t stamp;                                /*!< Tick count of completion */
+};
+
+//! Reassembly buffer.
+struct nrf24l01_frag_buffer
+{
+    uint8_t pipe;                                  /*!< Pipe on which message is received */
+    uint8_t id;                                    /*!< Message ID */
+    uint8_t count;                                 /*!< Number of fragments, 0 if buffer is free */
+    uint8_t received;                              /*!< Number of fragments received */
+    uint8_t complete;                              /*!< Message is complete and owned by user */
+    uint16_t size;                                 /*!< Message size */
+    uint64_t stamp;                                /*!< Tick count of last received fragment */
+    uint8_t map[(NRF24L01_FRAG_MAX_FRAGMENTS + 7) / 8]; /*!< Received fragments */
+    uint8_t data[NRF24L01_FRAG_MAX_SIZE];
+};
+
+//! Fragmentation layer.
+struct nrf24l01_frag
+{
+    struct nrf24l01 *device;
+    uint8_t next_id;                               /*!< ID of next sent message */
+    uint8_t history_pos;
+    struct nrf24l01_frag_history history[NRF24L01_FRAG_HISTORY];
+    struct nrf24l01_frag_buffer buffers[NRF24L01_FRAG_BUFFERS];
+
+    uint16_t duplicates;                           /*!< Duplicate fragments dropped */
+    uint16_t dropped;                              /*!< Fragments dropped because no buffer was free */
+    uint16_t expired;                              /*!< Incomplete messages dropped on timeout */
+    uint16_t malformed;                            /*!< Invalid fragments dropped */
+    uint16_t resent;                               /*!< Fragments sent again after MAX_RT */
+};
+
+/*! Init fragmentation layer.
+ * \param frag fragmentation layer.
+ * \param device configured device.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_frag_init(struct nrf24l01_frag *frag, struct nrf24l01 *device);
+
+/*! Send message as PTX.
+ * Fragments are sent with nrf24l01_send_stream(), fragments that reached MAX_RT are
+ * sent again up to NRF24L01_FRAG_RETRIES times.
+ * \param frag fragmentation layer.
+ * \param data message.
+ * \param size message size, from 1 to NRF24L01_FRAG_MAX_SIZE.
+ * \returns 0 on success, -ETIMEDOUT if some fragment wasn't delivered, -EIO if radio stalled,
+ *          negative error code otherwise.
+ */
+int nrf24l01_frag_send(struct nrf24l01_frag *frag, const uint8_t *data, uint16_t size);
+
+/*! Process received payload.
+ * Fragments may come in any order, duplicates are dropped for NRF24L01_FRAG_HISTORY_TIMEOUT
+ * after message is complete. Several messages may be reassembled at once, on one or
+ * several pipes.
+ * \param frag fragmentation layer.
+ * \param pipe pipe on which payload has been received.
+ * \param data payload.
+ * \param size payload size.
+ * \param message set to complete message, 0 otherwise. Message must be released with
+ *        nrf24l01_frag_release().
+ * \returns 0 on success, -EBADMSG if payload isn't valid fragment, -ENOBUFS if there
+ *          is no free buffer.
+ */
+int nrf24l01_frag_input(struct nrf24l01_frag *frag, uint8_t pipe, const uint8_t *data, uint8_t size,
+                        struct nrf24l01_frag_buffer **message);
+
+/*! Receive message. Device stays in RX mode until message is complete, payloads are
+ * taken from RX ring in IRQ mode.
+ * \param frag fragmentation layer.
+ * \param message complete message, must be released with nrf24l01_frag_release().
+ * \param timeout receive timeout in milliseconds, 0 - wait forever.
+ * \returns 0 on success, -ETIMEDOUT on timeout, negative error code otherwise.
+ */
+int nrf24l01_frag_receive(struct nrf24l01_frag *frag, struct nrf24l01_frag_buffer **message, uint16_t timeout);
+
+//! Return message buffer to pool.
+void nrf24l01_frag_release(struct nrf24l01_frag_buffer *message);
+
+//! \} \}
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef BAREMETAL_NRF24L01_HUB_H
+#define BAREMETAL_NRF24L01_HUB_H
+
+/*!
+ * \defgroup drivers Drivers - Device drivers
+ * \{
+ * \defgroup nrf24l01_hub NRF24L01 hub - Star network hub serving node per pipe
+ * \{
+ */
+
+#include <stdint.h>
+#include <bm/nrf24l01.h>
+
+//! Per-node queue size, power of two up to 128.
+#ifndef NRF24L01_HUB_QUEUE_SIZE
+#define NRF24L01_HUB_QUEUE_SIZE 4
+#endif
+
+/*!
+ * Time in milliseconds after which ACK payload of silent node is taken back from
+ * TX FIFO, if other nodes wait for it.
+ */
+#ifndef NRF24L01_HUB_ACK_TIMEOUT
+#define NRF24L01_HUB_ACK_TIMEOUT 100
+#endif
+
+#if (NRF24L01_HUB_QUEUE_SIZE & (NRF24L01_HUB_QUEUE_SIZE - 1)) || (NRF24L01_HUB_QUEUE_SIZE > 128)
+#error "NRF24L01_HUB_QUEUE_SIZE must be power of two up to 128"
+#endif
+
+#define NRF24L01_HUB_NODES 6
+
+//! Node statistics.
+struct nrf24l01_hub_stats
+{
+    uint16_t rx;                                   /*!< Payloads received */
+    uint16_t rx_dropped;                           /*!< Payloads dropped because RX queue was full */
+    uint16_t tx;                                   /*!< Payloads sent with ACK */
+    uint16_t tx_reloaded;                          /*!< ACK payloads taken back from TX FIFO */
+    uint64_t last_seen;                            /*!< Tick count of last received payload */
+};
+
+//! Node, served by one pipe.
+struct nrf24l01_hub_node
+{
+    uint8_t enabled;
+    uint8_t address[5];
+    uint8_t loaded;                                /*!< First TX queue payload is in TX FIFO */
+    uint8_t seen;                                  /*!< Payload was received since ACK payload was loaded */
+    uint64_t loaded_at;                            /*!< Tick count, when payload was loaded */
+
+    struct nrf24l01_frame rx[NRF24L01_HUB_QUEUE_SIZE];
+    volatile uint8_t rx_head;                      /*!< Written by nrf24l01_hub_poll() only */
+    volatile uint8_t rx_tail;                      /*!< Written by consumer only */
+
+    struct nrf24l01_frame tx[NRF24L01_HUB_QUEUE_SIZE];
+    volatile uint8_t tx_head;                      /*!< Written by producer only */
+    volatile uint8_t tx_tail;                      /*!< Written by nrf24l01_hub_poll() only */
+
+    struct nrf24l01_hub_stats stats;
+};
+
+//! Hub, device always stays PRX.
+struct nrf24l01_hub
+{
+    struct nrf24l01 *device;
+    uint8_t loaded;                                /*!< ACK payloads in TX FIFO, up to 3 */
+    uint8_t next;                                  /*!< Node checked first when loading ACK payloads */
+    struct nrf24l01_hub_node nodes[NRF24L01_HUB_NODES];
+};
+
+/*! Init hub and enter RX mode.
+ * Dynamic payload length and ACK payloads are enabled, all pipes are disabled until
+ * nodes are added. Features must be activated with nrf24l01_toggle_features() before
+ * on nRF24L01 (non-plus).
+ * \param hub hub.
+ * \param device powered up device with channel and data rate set.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_hub_init(struct nrf24l01_hub *hub, struct nrf24l01 *device);
+
+/*! Add node.
+ * \param hub hub.
+ * \param pipe pipe, from 0 to 5.
+ * \param address node address. Pipes 2-5 differ from pipe 1 by first (least significant)
+ *        byte only, so pipe 1 node must be added first.
+ * \returns 0 on success, -EINVAL if address can't be used on pipe, negative error code otherwise.
+ */
+int nrf24l01_hub_add_node(struct nrf24l01_hub *hub, uint8_t pipe, const uint8_t address[5]);
+
+/*! Remove node, its queues are dropped.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_hub_remove_node(struct nrf24l01_hub *hub, uint8_t pipe);
+
+/*! Move received payloads to node queues and load ACK payloads.
+ * Should be called on IRQ or periodically. Each node may have one ACK payload in
+ * TX FIFO, nodes are served round-robin when more than 3 nodes have outbound data.
+ * Payload leaves node TX queue when TX_DS confirms it was sent. If TX_DS can't be
+ * told apart between nodes and payload is taken back after NRF24L01_HUB_ACK_TIMEOUT,
+ * it may be sent twice, but it is never lost.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_hub_poll(struct nrf24l01_hub *hub);
+
+/*! Get payload from node RX queue.
+ * \returns 0 on success, -EAGAIN if queue is empty, -EINVAL if node isn't added.
+ */
+int nrf24l01_hub_receive(struct nrf24l01_hub *hub, uint8_t pipe, struct nrf24l01_frame *frame);
+
+/*! Queue payload for node, it is sent with ACK to next payload from node.
+ * Payload is loaded to TX FIFO by nrf24l01_hub_poll().
+ * \returns 0 on success, -ENOBUFS if queue is full, -EINVAL if node isn't added
+ *          or size is greater than 32.
+ */
+int nrf24l01_hub_send(struct nrf24l01_hub *hub, uint8_t pipe, const uint8_t *data, uint8_t size);
+
+//! \} \}
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef BAREMETAL_NRF24L01_LINK_H
+#define BAREMETAL_NRF24L01_LINK_H
+
+/*!
+ * \defgroup drivers Drivers - Device drivers
+ * \{
+ * \defgroup nrf24l01_link NRF24L01 link manager - Per-peer rate, power and retransmit tuning
+ * \{
+ */
+
+#include <stdint.h>
+#include <bm/nrf24l01.h>
+
+//! Maximum number of peers.
+#ifndef NRF24L01_LINK_PEERS
+#define NRF24L01_LINK_PEERS 4
+#endif
+
+//! Number of payloads sent to peer before its settings are reviewed.
+#ifndef NRF24L01_LINK_WINDOW
+#define NRF24L01_LINK_WINDOW 16
+#endif
+
+//! Auto retransmit count used on clean link, raised up to 15 on losses.
+#ifndef NRF24L01_LINK_MIN_RETRANSMITS
+#define NRF24L01_LINK_MIN_RETRANSMITS 3
+#endif
+
+#if (NRF24L01_LINK_WINDOW < 1) || (NRF24L01_LINK_WINDOW > 255)
+#error "NRF24L01_LINK_WINDOW must be from 1 to 255"
+#endif
+
+#if NRF24L01_LINK_MIN_RETRANSMITS > 15
+#error "NRF24L01_LINK_MIN_RETRANSMITS must be up to 15"
+#endif
+
+//! Peer statistics.
+struct nrf24l01_link_stats
+{
+    uint32_t sent;                                 /*!< Payloads sent */
+    uint32_t lost;                                 /*!< Payloads that reached MAX_RT */
+    uint32_t retransmits;                          /*!< Retransmits of all payloads */
+};
+
+//! Peer with its own radio settings.
+struct nrf24l01_link_peer
+{
+    uint8_t address[5];
+    uint8_t rate;                                  /*!< NRF24L01_DATA_RATE_* */
+    uint8_t power;                                 /*!< NRF24L01_POWER_* */
+    uint8_t retransmits;                           /*!< Auto retransmit count */
+
+    uint8_t window_sent;                           /*!< Payloads sent in current window */
+    uint8_t window_lost;                           /*!< Payloads lost in current window */
+    uint16_t window_retransmits;                   /*!< Retransmits in current window */
+    uint8_t window_peak;                           /*!< Most retransmits of one payload in current window */
+    uint16_t window_bytes;                         /*!< Bytes delivered in current window */
+    uint32_t window_airtime;                       /*!< Estimated airtime of current window in microseconds */
+    uint32_t goodput[3];                           /*!< Goodput per data rate in bytes per second, 0 if not measured */
+
+    struct nrf24l01_link_stats stats;
+};
+
+//! Link manager, device is PTX for all peers.
+struct nrf24l01_link
+{
+    struct nrf24l01 *device;
+    uint8_t channel;                               /*!< Current RF channel */
+    uint8_t ack_size;                              /*!< Largest expected ACK payload, sets retransmit delay */
+    uint8_t count;                                 /*!< Number of peers */
+    uint8_t current;                               /*!< Peer whose settings are applied, 0xFF if none */
+    struct nrf24l01_link_peer peers[NRF24L01_LINK_PEERS];
+};
+
+/*! Init link manager and set channel.
+ * \param link link manager.
+ * \param device powered up device.
+ * \param channel RF channel, from 0 to 127.
+ * \param ack_size largest ACK payload peers send back, 0 if ACK payloads are not used.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_link_init(struct nrf24l01_link *link, struct nrf24l01 *device, uint8_t channel, uint8_t ack_size);
+
+/*! Add peer. Peer starts at 1 Mbps and 0 dBm.
+ * \param link link manager.
+ * \param address peer address.
+ * \returns peer index on success, -ENOBUFS if there is no room for peer.
+ */
+int nrf24l01_link_add_peer(struct nrf24l01_link *link, const uint8_t address[5]);
+
+/*! Send single payload to peer and tune peer settings.
+ * Peer settings are applied when another peer was addressed before. Each
+ * NRF24L01_LINK_WINDOW payloads losses and retransmits are reviewed: losses raise
+ * PA level, then retransmit count, then lower data rate; frequent retransmits raise
+ * PA level or lower data rate if that had better goodput; otherwise higher data rate
+ * is probed, unless it had worse goodput recently. Goodput is estimated from airtime,
+ * so it doesn't depend on how often data is sent.
+ * \param link link manager.
+ * \param peer peer index.
+ * \param data payload.
+ * \param size payload size, up to 32.
+ * \param ack ACK payload, the size of this array must be at least 32 bytes.
+ * \param ack_size ACK payload size, 0 if ACK was empty.
+ * \returns 0 on success, -ETIMEDOUT on MAX_RT, negative error code otherwise.
+ */
+int nrf24l01_link_send(struct nrf24l01_link *link, uint8_t peer, uint8_t *data, uint8_t size,
+                       uint8_t *ack, uint8_t *ack_size);
+
+/*! Measure channel activity.
+ * Each channel is sampled for carrier (received power above -64 dBm on nRF24L01+).
+ * Device is left in standby mode on current channel.
+ * \param link link manager.
+ * \param first first channel.
+ * \param last last channel, up to 127.
+ * \param samples samples per channel.
+ * \param busy samples with carrier, last - first + 1 items.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_link_scan(struct nrf24l01_link *link, uint8_t first, uint8_t last, uint8_t samples, uint8_t *busy);
+
+/*! Move to the quietest channel in range.
+ * Current channel is kept unless another channel is quieter. Peers must follow the
+ * change, e.g. by agreeing on channel before it is called.
+ * \param link link manager.
+ * \param first first channel.
+ * \param last last channel, up to 127.
+ * \param samples samples per channel.
+ * \returns 0 on success, negative error code otherwise. New channel is in link->channel.
+ */
+int nrf24l01_link_select_channel(struct nrf24l01_link *link, uint8_t first, uint8_t last, uint8_t samples);
+
+//! \} \}
+
+#endif
@@ -0,0 +1,241 @@
+#ifndef BAREMETAL_NRF24L01_MESH_H
+#define BAREMETAL_NRF24L01_MESH_H
+
+/*!
+ * \defgroup drivers Drivers - Device drivers
+ * \{
+ * \defgroup nrf24l01_mesh NRF24L01 mesh - Multi-hop distance-vector routing
+ * \{
+ */
+
+#include <stdint.h>
+#include <bm/nrf24l01.h>
+
+//! Number of routes kept.
+#ifndef NRF24L01_MESH_ROUTES
+#define NRF24L01_MESH_ROUTES 16
+#endif
+
+//! Forwarding and receive queue size, power of two up to 128.
+#ifndef NRF24L01_MESH_QUEUE_SIZE
+#define NRF24L01_MESH_QUEUE_SIZE 8
+#endif
+
+//! Number of recent messages remembered to drop duplicates.
+#ifndef NRF24L01_MESH_HISTORY
+#define NRF24L01_MESH_HISTORY 16
+#endif
+
+//! Interval in milliseconds between route advertisements.
+#ifndef NRF24L01_MESH_ADVERT_INTERVAL
+#define NRF24L01_MESH_ADVERT_INTERVAL 1000
+#endif
+
+//! Time in milliseconds after which route, which wasn't advertised, is dropped.
+#ifndef NRF24L01_MESH_ROUTE_TIMEOUT
+#define NRF24L01_MESH_ROUTE_TIMEOUT (3 * NRF24L01_MESH_ADVERT_INTERVAL)
+#endif
+
+/*!
+ * Time in milliseconds for which message is remembered. Packets, which are older, are
+ * dropped, as they could be duplicates of forgotten messages. Node, which restarts
+ * from sequence number 0, isn't taken for duplicate after that.
+ */
+#ifndef NRF24L01_MESH_HISTORY_TIMEOUT
+#define NRF24L01_MESH_HISTORY_TIMEOUT (2 * NRF24L01_MESH_ADVERT_INTERVAL)
+#endif
+
+//! Number of attempts to pass message to next hop, each one with hardware retransmits.
+#ifndef NRF24L01_MESH_RETRIES
+#define NRF24L01_MESH_RETRIES 3
+#endif
+
+//! Maximum number of hops.
+#ifndef NRF24L01_MESH_TTL
+#define NRF24L01_MESH_TTL 8
+#endif
+
+#if (NRF24L01_MESH_QUEUE_SIZE & (NRF24L01_MESH_QUEUE_SIZE - 1)) || (NRF24L01_MESH_QUEUE_SIZE > 128)
+#error "NRF24L01_MESH_QUEUE_SIZE must be power of two up to 128"
+#endif
+
+#if NRF24L01_MESH_HISTORY_TIMEOUT >= 0xFFFF
+#error "NRF24L01_MESH_HISTORY_TIMEOUT must be below 65535, packet age is 16-bit"
+#endif
+
+#define NRF24L01_MESH_BROADCAST 0xFF
+#define NRF24L01_MESH_INFINITY 16
+
+#define NRF24L01_MESH_TYPE_DATA 1
+#define NRF24L01_MESH_TYPE_ROUTE 2
+
+#define NRF24L01_MESH_HEADER_SIZE 7
+#define NRF24L01_MESH_PAYLOAD (32 - NRF24L01_MESH_HEADER_SIZE)
+
+/*!
+ * Packet header. Data packet is followed by up to NRF24L01_MESH_PAYLOAD bytes of message,
+ * route packet by route entries.
+ */
+struct nrf24l01_mesh_header
+{
+    uint8_t type;                                  /*!< NRF24L01_MESH_TYPE_* */
+    uint8_t ttl;                                   /*!< Hops left */
+    uint8_t src;                                   /*!< Originating node */
+    uint8_t dst;                                   /*!< Destination node */
+    uint8_t seq;                                   /*!< Sequence number of originating node */
+    uint8_t age[2];                                /*!< Milliseconds spent in queues and on air, little-endian */
+};
+
+//! Advertised route, advertising node reaches dst through next hop.
+struct nrf24l01_mesh_route_entry
+{
+    uint8_t dst;
+    uint8_t metric;                                /*!< Hops, NRF24L01_MESH_INFINITY if route is broken */
+    uint8_t next;
+};
+
+//! Route table entry.
+struct nrf24l01_mesh_route
+{
+    uint8_t dst;                                   /*!< Destination, 0 if entry is free */
+    uint8_t next;                                  /*!< Neighbor, which forwards to destination */
+    uint8_t metric;                                /*!< Hops */
+    uint64_t stamp;                                /*!< Tick count of last advertisement */
+};
+
+//! Queued outgoing packet.
+struct nrf24l01_mesh_entry
+{
+    uint64_t stamp;                                /*!< Tick count, when packet was queued */
+    uint8_t tries;                                 /*!< Failed attempts */
+    uint8_t size;                                  /*!< Packet size */
+    uint8_t data[32];                              /*!< Header and message */
+};
+
+//! Recently seen message.
+struct nrf24l01_mesh_history
+{
+    uint16_t key;                                  /*!< Source and sequence, 0xFFFF if entry is empty */
+    uint64_t stamp;                                /*!< Tick count, when message was seen */
+};
+
+/*!
+ * Radio used by mesh node, nodes are addressed by ID. nrf24l01_mesh_init() uses device,
+ * other radios, e.g. simulated ones, are passed to nrf24l01_mesh_init_radio(). Routing
+ * doesn't depend on device, so many nodes may run on simulated radios in one host process.
+ */
+struct nrf24l01_mesh_radio
+{
+    /*! Get received packet, pipe of frame is 2 for broadcasts and 1 otherwise.
+     * \returns 0 on success, -EAGAIN if there is no packet, negative error code otherwise.
+     */
+    int (*receive)(void *context, struct nrf24l01_frame *frame);
+
+    /*! Leave RX mode and send packet to node, broadcast is sent without ACK.
+     * \returns 0 on success, -ETIMEDOUT if packet wasn't acknowledged, negative error code otherwise.
+     */
+    int (*send)(void *context, uint8_t dst, uint8_t *packet, uint8_t size);
+
+    //! Enter RX mode, packets to node and broadcasts are received.
+    int (*listen)(void *context);
+};
+
+//! Received message.
+struct nrf24l01_mesh_message
+{
+    uint8_t src;                                   /*!< Originating node */
+    uint8_t hops;                                  /*!< Hops taken */
+    uint16_t latency;                              /*!< End-to-end latency in milliseconds */
+    uint8_t size;
+    uint8_t data[NRF24L01_MESH_PAYLOAD];
+};
+
+//! Node statistics.
+struct nrf24l01_mesh_stats
+{
+    uint32_t delivered;                            /*!< Messages received by node */
+    uint32_t forwarded;                            /*!< Packets passed to next hop */
+    uint32_t duplicates;                           /*!< Duplicate packets dropped */
+    uint32_t dropped;                              /*!< Packets dropped because queue was full, TTL or age expired */
+    uint32_t lost;                                 /*!< Packets dropped after NRF24L01_MESH_RETRIES attempts */
+    uint32_t unreachable;                          /*!< Packets dropped because there was no route */
+    uint32_t latency_total;                        /*!< Sum of latency of delivered messages in milliseconds */
+    uint16_t latency_max;                          /*!< Worst latency of delivered message in milliseconds */
+};
+
+/*!
+ * Mesh node. Node address is 0x<base><id>, all nodes receive route advertisements on
+ * 0x<base>FF.
+ */
+struct nrf24l01_mesh
+{
+    const struct nrf24l01_mesh_radio *radio;
+    void *context;                                 /*!< Passed to radio operations */
+    struct nrf24l01 *device;                       /*!< Device, 0 if other radio is used */
+    uint8_t id;                                    /*!< Node ID, from 1 to 254 */
+    uint8_t base[4];                               /*!< Most significant address bytes, shared by all nodes */
+    uint8_t seq;                                   /*!< Sequence number of next originated message */
+    uint64_t next_advert;                          /*!< Tick count of next route advertisement */
+
+    struct nrf24l01_mesh_route routes[NRF24L01_MESH_ROUTES];
+
+    uint8_t history_pos;
+    struct nrf24l01_mesh_history history[NRF24L01_MESH_HISTORY];
+
+    struct nrf24l01_mesh_entry tx[NRF24L01_MESH_QUEUE_SIZE];
+    uint8_t tx_head;
+    uint8_t tx_tail;
+
+    struct nrf24l01_mesh_message rx[NRF24L01_MESH_QUEUE_SIZE];
+    uint8_t rx_head;
+    uint8_t rx_tail;
+
+    struct nrf24l01_mesh_stats stats;
+};
+
+/*! Init node and enter RX mode.
+ * Pipe 1 receives packets for node, pipe 2 route advertisements. Dynamic payload length
+ * and dynamic ACK are enabled, which must be activated with nrf24l01_toggle_features()
+ * before on nRF24L01 (non-plus). IRQ mode must be disabled.
+ * \param mesh mesh node.
+ * \param device powered up device with channel and data rate set.
+ * \param id node ID, from 1 to 254.
+ * \param base most significant address bytes, same for all nodes.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_mesh_init(struct nrf24l01_mesh *mesh, struct nrf24l01 *device, uint8_t id, const uint8_t base[4]);
+
+/*! Init node on other radio, which must be put in RX mode by caller.
+ * \param mesh mesh node.
+ * \param radio radio operations.
+ * \param context passed to radio operations.
+ * \param id node ID, from 1 to 254.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_mesh_init_radio(struct nrf24l01_mesh *mesh, const struct nrf24l01_mesh_radio *radio, void *context,
+                             uint8_t id);
+
+/*! Queue message. Message is sent by nrf24l01_mesh_poll().
+ * \param mesh mesh node.
+ * \param dst destination node.
+ * \param data message.
+ * \param size message size, up to NRF24L01_MESH_PAYLOAD.
+ * \returns 0 on success, -EHOSTUNREACH if there is no route, -ENOBUFS if queue is full,
+ *          -EINVAL if size is too large.
+ */
+int nrf24l01_mesh_send(struct nrf24l01_mesh *mesh, uint8_t dst, const uint8_t *data, uint8_t size);
+
+/*! Receive packets, advertise routes and send queued packets.
+ * Should be called periodically, device stays in RX mode between calls.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_mesh_poll(struct nrf24l01_mesh *mesh);
+
+/*! Get received message.
+ * \returns 0 on success, -EAGAIN if no message is waiting.
+ */
+int nrf24l01_mesh_receive(struct nrf24l01_mesh *mesh, struct nrf24l01_mesh_message *message);
+
+//! \} \}
+
+#endif
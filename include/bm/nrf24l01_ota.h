@@ -0,0 +1,187 @@
+#ifndef BAREMETAL_NRF24L01_OTA_H
+#define BAREMETAL_NRF24L01_OTA_H
+
+/*!
+ * \defgroup drivers Drivers - Device drivers
+ * \{
+ * \defgroup nrf24l01_ota NRF24L01 OTA - Firmware image transfer to SPI Serial Flash
+ * \{
+ */
+
+#include <stdint.h>
+#include <bm/nrf24l01.h>
+#include <bm/sst25.h>
+
+//! Flash programming unit, power of two from 64 to 512.
+#ifndef NRF24L01_OTA_BLOCK_SIZE
+#define NRF24L01_OTA_BLOCK_SIZE 256
+#endif
+
+//! Number of block buffers: one is programmed while the others receive.
+#ifndef NRF24L01_OTA_BUFFERS
+#define NRF24L01_OTA_BUFFERS 2
+#endif
+
+//! Number of sectors erased ahead of sector, which is being programmed.
+#ifndef NRF24L01_OTA_ERASE_AHEAD
+#define NRF24L01_OTA_ERASE_AHEAD 1
+#endif
+
+//! Number of attempts to get receiver status before sender gives up.
+#ifndef NRF24L01_OTA_RETRIES
+#define NRF24L01_OTA_RETRIES 16
+#endif
+
+//! Delay in milliseconds between attempts to get receiver status.
+#ifndef NRF24L01_OTA_POLL_DELAY
+#define NRF24L01_OTA_POLL_DELAY 2
+#endif
+
+//! Time in milliseconds, in which receiver must accept next block or verify image, before sender gives up.
+#ifndef NRF24L01_OTA_TIMEOUT
+#define NRF24L01_OTA_TIMEOUT 5000
+#endif
+
+#if (NRF24L01_OTA_BLOCK_SIZE & (NRF24L01_OTA_BLOCK_SIZE - 1)) || (NRF24L01_OTA_BLOCK_SIZE < 64) || \
+    (NRF24L01_OTA_BLOCK_SIZE > 512)
+#error "NRF24L01_OTA_BLOCK_SIZE must be power of two from 64 to 512"
+#endif
+
+#if NRF24L01_OTA_BUFFERS < 2
+#error "NRF24L01_OTA_BUFFERS must be at least 2"
+#endif
+
+#define NRF24L01_OTA_MAGIC 0x41544F42
+
+#define NRF24L01_OTA_TYPE_START 1
+#define NRF24L01_OTA_TYPE_DATA 2
+#define NRF24L01_OTA_TYPE_POLL 3
+#define NRF24L01_OTA_TYPE_STATUS 0x81
+
+#define NRF24L01_OTA_IDLE 0                        /*!< No image */
+#define NRF24L01_OTA_RECEIVING 1                   /*!< Image is being received */
+#define NRF24L01_OTA_DONE 2                        /*!< Image is complete and its CRC matches */
+#define NRF24L01_OTA_FAILED 3                      /*!< Image CRC mismatch or image doesn't fit */
+
+#define NRF24L01_OTA_DATA_HEADER_SIZE 4
+#define NRF24L01_OTA_CHUNK (32 - NRF24L01_OTA_DATA_HEADER_SIZE)
+#define NRF24L01_OTA_CHUNKS ((NRF24L01_OTA_BLOCK_SIZE + NRF24L01_OTA_CHUNK - 1) / NRF24L01_OTA_CHUNK)
+
+//! Image header at start of first sector, followed by bitmap of programmed blocks.
+struct nrf24l01_ota_header
+{
+    uint32_t magic;                                /*!< NRF24L01_OTA_MAGIC */
+    uint32_t size;                                 /*!< Image size */
+    uint32_t crc;                                  /*!< CRC-32 of image */
+    uint16_t header_crc;                           /*!< CRC-16/CCITT of previous fields */
+    uint16_t verified;                             /*!< 0 when image CRC was checked, 0xFFFF otherwise */
+};
+
+/*!
+ * Packets sent to receiver. START is {type, size[4], crc[4]}, POLL is {type, token},
+ * DATA is header followed by chunk of block, all chunks but last one of block are
+ * NRF24L01_OTA_CHUNK bytes.
+ */
+struct nrf24l01_ota_data_header
+{
+    uint8_t type;                                  /*!< NRF24L01_OTA_TYPE_DATA */
+    uint8_t block[2];                              /*!< Block number, little-endian */
+    uint8_t chunk;                                 /*!< Chunk number in block */
+};
+
+/*!
+ * Receiver status, ACK payload of packet following POLL. Blocks before next are
+ * received, blocks from next to next + window - 1 are accepted.
+ */
+struct nrf24l01_ota_status
+{
+    uint8_t type;                                  /*!< NRF24L01_OTA_TYPE_STATUS */
+    uint8_t token;                                 /*!< Token of POLL */
+    uint8_t state;                                 /*!< NRF24L01_OTA_* */
+    uint8_t window;
+    uint8_t next[2];                               /*!< First block not received yet, little-endian */
+    uint8_t map[2][4];                             /*!< Received chunks of blocks next and next + 1, little-endian */
+};
+
+//! Block buffer.
+struct nrf24l01_ota_buffer
+{
+    uint32_t map;                                  /*!< Received chunks */
+    uint8_t data[NRF24L01_OTA_BLOCK_SIZE];
+};
+
+//! Receiver statistics.
+struct nrf24l01_ota_stats
+{
+    uint32_t chunks;                               /*!< Chunks stored */
+    uint32_t duplicates;                           /*!< Chunks received again */
+    uint32_t rejected;                             /*!< Chunks outside of window or malformed */
+    uint32_t polls;
+};
+
+/*!
+ * Receiver. Image is stored from second sector of flash area, first one holds image
+ * header and bitmap of programmed blocks. Flash is programmed, erased ahead and
+ * verified while packets are being received, one operation per step, and transfer
+ * resumes after reset from first block, which wasn't programmed.
+ */
+struct nrf24l01_ota
+{
+    struct nrf24l01 *device;
+    struct sst25 *flash;
+    uint16_t first_sector;                         /*!< First 4K sector number */
+    uint16_t sector_count;                         /*!< Number of sectors including header sector */
+
+    uint8_t state;                                 /*!< NRF24L01_OTA_* */
+    uint32_t size;                                 /*!< Image size */
+    uint32_t crc;                                  /*!< Image CRC-32 */
+    uint16_t blocks;                               /*!< Number of image blocks */
+
+    uint16_t received;                             /*!< Blocks before are received */
+    uint16_t programmed;                           /*!< Blocks before are programmed */
+    uint16_t erased;                               /*!< Image sectors before are erased */
+
+    uint8_t busy;                                  /*!< Flash operation is in progress */
+    uint8_t erasing;                               /*!< Erase of sector erased is in progress */
+    uint8_t aai;                                   /*!< AAI sequence is in progress */
+    uint16_t program_pos;                          /*!< Bytes of block passed to AAI sequence */
+    uint32_t verify_pos;                           /*!< Bytes of programmed image checked */
+    uint32_t verify_crc;                           /*!< CRC-32 of bytes checked */
+
+    struct nrf24l01_ota_buffer buffers[NRF24L01_OTA_BUFFERS];
+    struct nrf24l01_ota_stats stats;
+};
+
+/*! Init receiver, resuming image found in flash area.
+ * Device must be in RX mode, with ACK payloads and dynamic payload size enabled.
+ * \param ota receiver.
+ * \param device configured device.
+ * \param flash flash device.
+ * \param first_sector first 4K sector number of flash area.
+ * \param sector_count number of sectors, at least 2.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_ota_init(struct nrf24l01_ota *ota, struct nrf24l01 *device, struct sst25 *flash,
+                      uint16_t first_sector, uint16_t sector_count);
+
+/*! Process received packets and advance flash operations.
+ * Returns when radio is idle and flash is busy or has nothing to do, so should be
+ * called in loop.
+ * \returns 1 if image is complete and verified, 0 otherwise, negative error code on
+ *          error.
+ */
+int nrf24l01_ota_poll(struct nrf24l01_ota *ota);
+
+/*! Send image as PTX, transfer resumes where receiver stopped.
+ * Device must be in standby mode, with ACK payloads and dynamic payload size enabled.
+ * \param device configured device.
+ * \param image image.
+ * \param size image size.
+ * \returns 0 on success, -EIO if receiver rejected image, -ETIMEDOUT if receiver
+ *          doesn't respond or make progress, negative error code otherwise.
+ */
+int nrf24l01_ota_send(struct nrf24l01 *device, const uint8_t *image, uint32_t size);
+
+//! \} \}
+
+#endif
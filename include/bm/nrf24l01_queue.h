@@ -0,0 +1,143 @@
+#ifndef BAREMETAL_NRF24L01_QUEUE_H
+#define BAREMETAL_NRF24L01_QUEUE_H
+
+/*!
+ * \defgroup drivers Drivers - Device drivers
+ * \{
+ * \defgroup nrf24l01_queue NRF24L01 queue - Store-and-forward queue on SPI Serial Flash
+ * \{
+ */
+
+#include <stdint.h>
+#include <bm/nrf24l01.h>
+#include <bm/sst25.h>
+
+//! Size of block payload. Frames are buffered in RAM until block is full or flushed.
+#ifndef NRF24L01_QUEUE_BLOCK_SIZE
+#define NRF24L01_QUEUE_BLOCK_SIZE 128
+#endif
+
+#define NRF24L01_QUEUE_SEGMENT_SIZE 0x1000
+#define NRF24L01_QUEUE_MAGIC 0x51464E42
+
+//! Frame is stored as size byte followed by up to 32 bytes of data.
+#define NRF24L01_QUEUE_RECORD_MAX 33
+
+#if (NRF24L01_QUEUE_BLOCK_SIZE < NRF24L01_QUEUE_RECORD_MAX) || (NRF24L01_QUEUE_BLOCK_SIZE > 0x1000 - 32)
+#error "NRF24L01_QUEUE_BLOCK_SIZE must hold at least one frame and fit in segment"
+#endif
+
+#define NRF24L01_QUEUE_PENDING 0xFFFF
+#define NRF24L01_QUEUE_DONE 0x0000
+
+/*!
+ * Segment (4K sector) header. Segment is marked done, when all its blocks were sent and
+ * queue moved to next segment.
+ */
+struct nrf24l01_queue_segment_header
+{
+    uint32_t magic;                                /*!< NRF24L01_QUEUE_MAGIC */
+    uint32_t seq;                                  /*!< Segment number, increments by one for each new segment */
+    uint16_t crc;                                  /*!< CRC-16/CCITT of previous fields */
+    uint16_t state;                                /*!< NRF24L01_QUEUE_PENDING or NRF24L01_QUEUE_DONE */
+};
+
+//! Block header. Followed by frames, each frame is size byte and data.
+struct nrf24l01_queue_block_header
+{
+    uint16_t len;                                  /*!< Payload size, 0xFFFF marks end of segment */
+    uint16_t crc;                                  /*!< CRC-16/CCITT of len and payload */
+    uint16_t state;                                /*!< NRF24L01_QUEUE_PENDING or NRF24L01_QUEUE_DONE */
+    uint16_t reserved;
+};
+
+//! Queue statistics.
+struct nrf24l01_queue_stats
+{
+    uint32_t queued;                               /*!< Frames queued, because link was down or queue wasn't empty */
+    uint32_t sent;                                 /*!< Queued frames sent */
+    uint32_t blocks;                               /*!< Blocks written to flash */
+    uint32_t erases;                               /*!< Segments erased */
+    uint32_t overruns;                             /*!< Segments with unsent frames overwritten */
+    uint32_t corrupted;                            /*!< Blocks skipped because of bad CRC */
+};
+
+/*!
+ * Outbound queue. Frames, which couldn't be sent, are appended to circular log of 4K
+ * segments on flash and sent in order when link is back. Queued frames are collected in
+ * RAM block first, so short outages cost no flash writes at all. Delivery is marked per
+ * block, so after reboot frames of partially sent block are sent again.
+ */
+struct nrf24l01_queue
+{
+    struct nrf24l01 *device;
+    struct sst25 *flash;
+    uint16_t first_sector;                         /*!< First 4K sector number */
+    uint16_t sector_count;                         /*!< Number of segments */
+    uint8_t empty;                                 /*!< No segment is written yet */
+
+    uint16_t head;                                 /*!< Segment that receives blocks */
+    uint16_t offset;                               /*!< Write offset in head segment */
+    uint32_t seq;                                  /*!< Head segment number */
+
+    uint16_t tail;                                 /*!< Segment with oldest unsent block */
+    uint16_t tail_offset;                          /*!< Offset of oldest unsent block in tail segment */
+
+    uint16_t read_pos;                             /*!< Position in read block */
+    uint16_t read_len;                             /*!< Read block payload size, 0 if block isn't loaded */
+    uint8_t read_block[NRF24L01_QUEUE_BLOCK_SIZE];
+
+    uint16_t block_pos;                            /*!< Frames before position were sent from RAM */
+    uint16_t block_len;
+    uint8_t block[NRF24L01_QUEUE_BLOCK_SIZE + 1];  /*!< Buffered frames, with room for padding byte */
+
+    struct nrf24l01_queue_stats stats;
+};
+
+/*! Mount queue. Head and tail are found by binary search over segment headers, only
+ * tail and head segments are scanned block by block.
+ * \param queue queue.
+ * \param device configured device, frames are sent with nrf24l01_send().
+ * \param flash flash device.
+ * \param first_sector first 4K sector number of queue area.
+ * \param sector_count number of segments, at least 2.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_queue_mount(struct nrf24l01_queue *queue, struct nrf24l01 *device, struct sst25 *flash,
+                         uint16_t first_sector, uint16_t sector_count);
+
+/*! Erase queue area and mount empty queue.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_queue_format(struct nrf24l01_queue *queue, struct nrf24l01 *device, struct sst25 *flash,
+                          uint16_t first_sector, uint16_t sector_count);
+
+/*! Send frame. Frame is sent at once, if queue is empty, and queued if it isn't or if it
+ * wasn't acknowledged. When queue is full, the oldest segment is overwritten.
+ * \param queue queue.
+ * \param data frame.
+ * \param size frame size, from 1 to 32.
+ * \returns 0 if frame was sent or queued, -EINVAL if size is invalid, negative error
+ *          code otherwise.
+ */
+int nrf24l01_queue_send(struct nrf24l01_queue *queue, uint8_t *data, uint8_t size);
+
+/*! Send queued frames in order until queue is empty or frame isn't acknowledged.
+ * \param queue queue.
+ * \param max maximum number of frames to send, 0 for no limit.
+ * \returns 0 if queue is empty, -EAGAIN if max frames were sent, -ETIMEDOUT if link
+ *          is still down, negative error code otherwise.
+ */
+int nrf24l01_queue_poll(struct nrf24l01_queue *queue, uint16_t max);
+
+/*! Write frames buffered in RAM to flash, e.g. before power down.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_queue_flush(struct nrf24l01_queue *queue);
+
+//! Check if there are no queued frames.
+int nrf24l01_queue_is_empty(struct nrf24l01_queue *queue);
+
+//! \} \}
+
+#endif
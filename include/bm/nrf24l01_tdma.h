@@ -0,0 +1,125 @@
+#ifndef BAREMETAL_NRF24L01_TDMA_H
+#define BAREMETAL_NRF24L01_TDMA_H
+
+/*!
+ * \defgroup drivers Drivers - Device drivers
+ * \{
+ * \defgroup nrf24l01_tdma NRF24L01 TDMA - Beacon synchronized time slots
+ * \{
+ */
+
+#include <stdint.h>
+#include <bm/nrf24l01.h>
+
+//! Time in milliseconds from power up to standby, at least 1.5 ms.
+#ifndef NRF24L01_TDMA_WAKEUP
+#define NRF24L01_TDMA_WAKEUP 2
+#endif
+
+/*!
+ * Guard time in milliseconds. Node listens this early for beacon and doesn't start
+ * transmission when less time is left in its slot.
+ */
+#ifndef NRF24L01_TDMA_GUARD
+#define NRF24L01_TDMA_GUARD 1
+#endif
+
+/*!
+ * Frames after which node listens for beacon again. Node loses sync if it misses
+ * beacons for twice as many frames.
+ */
+#ifndef NRF24L01_TDMA_RESYNC
+#define NRF24L01_TDMA_RESYNC 16
+#endif
+
+#define NRF24L01_TDMA_MARKER 0xB5
+
+/*!
+ * Beacon, sent without ACK by hub at start of each frame. Frame is beacon slot
+ * followed by node slots.
+ */
+struct nrf24l01_tdma_beacon
+{
+    uint8_t marker;                                /*!< NRF24L01_TDMA_MARKER */
+    uint8_t seq;                                   /*!< Sequence number, increments with each beacon */
+    uint8_t slots;                                 /*!< Node slots per frame */
+    uint8_t slot_time;                             /*!< Slot length in milliseconds */
+    uint8_t time[4];                               /*!< Hub tick count, little-endian */
+};
+
+//! TDMA hub or node.
+struct nrf24l01_tdma
+{
+    struct nrf24l01 *device;
+    uint8_t hub;                                   /*!< Device is hub */
+    uint8_t slot;                                  /*!< Node slot */
+    uint8_t slots;                                 /*!< Node slots per frame */
+    uint8_t slot_time;                             /*!< Slot length in milliseconds */
+    uint8_t seq;                                   /*!< Last beacon sequence number */
+    uint8_t synced;                                /*!< Node has received beacon recently */
+    uint8_t awake;                                 /*!< Node device is powered up */
+    uint64_t frame_start;                          /*!< Tick count of last beacon */
+    uint32_t hub_time;                             /*!< Hub tick count of last beacon */
+
+    uint32_t beacons;                              /*!< Beacons sent or received */
+    uint32_t missed;                               /*!< Beacons missed by node */
+};
+
+/*! Init hub and enter RX mode.
+ * Hub receives node payloads on pipe 0 and sends beacons to the same address.
+ * Dynamic ACK feature is enabled, which must be activated with nrf24l01_toggle_features()
+ * before on nRF24L01 (non-plus).
+ * \param tdma TDMA hub.
+ * \param device powered up device with channel and data rate set.
+ * \param address hub address.
+ * \param slots node slots per frame.
+ * \param slot_time slot length in milliseconds, must fit payloads with all retransmits.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_tdma_hub_init(struct nrf24l01_tdma *tdma, struct nrf24l01 *device, const uint8_t address[5],
+                           uint8_t slots, uint8_t slot_time);
+
+/*! Send beacon when frame starts and get received payload.
+ * Must be called at least once per millisecond to keep frames aligned.
+ * \param tdma TDMA hub.
+ * \param frame received payload.
+ * \returns 0 on success, -EAGAIN if no payload is waiting, negative error code otherwise.
+ */
+int nrf24l01_tdma_poll(struct nrf24l01_tdma *tdma, struct nrf24l01_frame *frame);
+
+/*! Init node. Node must be synchronized with nrf24l01_tdma_sync() before sending.
+ * \param tdma TDMA node.
+ * \param device device with channel, data rate and dynamic payload length on pipe 0 set.
+ * \param hub_address hub address.
+ * \param slot node slot, from 0.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_tdma_node_init(struct nrf24l01_tdma *tdma, struct nrf24l01 *device, const uint8_t hub_address[5],
+                            uint8_t slot);
+
+/*! Wait for beacon. Device is powered down on return.
+ * \param tdma TDMA node.
+ * \param timeout timeout in milliseconds, 0 - wait forever.
+ * \returns 0 on success, -ETIMEDOUT on timeout, negative error code otherwise.
+ */
+int nrf24l01_tdma_sync(struct nrf24l01_tdma *tdma, uint16_t timeout);
+
+/*! Send data to hub in node slots.
+ * Device is powered down until node slot, data is split to 32-byte payloads and sent
+ * in as many slots as needed. Beacon is received again each NRF24L01_TDMA_RESYNC
+ * frames. Device is powered down on return. IRQ mode must be disabled.
+ * \param tdma TDMA node.
+ * \param data data.
+ * \param size data size.
+ * \returns 0 if all payloads were sent, -ETIMEDOUT if some payloads reached MAX_RT,
+ *          -ENOLINK if node isn't synchronized, -EINVAL if node slot isn't in frame,
+ *          negative error code otherwise.
+ */
+int nrf24l01_tdma_send(struct nrf24l01_tdma *tdma, uint8_t *data, uint16_t size);
+
+//! Get hub tick count, valid while node is synchronized.
+uint32_t nrf24l01_tdma_time(struct nrf24l01_tdma *tdma);
+
+//! \} \}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef BAREMETAL_NRF24L01_TELEMETRY_H
+#define BAREMETAL_NRF24L01_TELEMETRY_H
+
+/*!
+ * \defgroup drivers Drivers - Device drivers
+ * \{
+ * \defgroup nrf24l01_telemetry NRF24L01 telemetry - Sensor samples packed into payloads
+ * \{
+ */
+
+#include <stdint.h>
+#include <bm/nrf24l01.h>
+
+#define NRF24L01_TELEMETRY_CHANNELS 16
+#define NRF24L01_TELEMETRY_HEADER_SIZE 6
+
+//! Smallest record is 8 bits: channel, time class and value class.
+#define NRF24L01_TELEMETRY_MAX_SAMPLES (32 - NRF24L01_TELEMETRY_HEADER_SIZE)
+
+/*!
+ * Channels of supported sensors, values are raw or integer readings. Channels from
+ * NRF24L01_TELEMETRY_USER to 15 are free for application.
+ */
+#define NRF24L01_TELEMETRY_BMP085_PRESSURE 0       /*!< Pa, from bmp085_calc() */
+#define NRF24L01_TELEMETRY_BMP085_TEMPERATURE 1    /*!< 0.1 C, from bmp085_calc() */
+#define NRF24L01_TELEMETRY_TSL2563_CH0 2           /*!< Raw ADC count of channel 0 */
+#define NRF24L01_TELEMETRY_TSL2563_CH1 3           /*!< Raw ADC count of channel 1 */
+#define NRF24L01_TELEMETRY_MCP9804_TEMPERATURE 4   /*!< 1/16 C */
+#define NRF24L01_TELEMETRY_SHT1X_TEMPERATURE 5     /*!< Raw SOt, see sht1x_calc_temp() */
+#define NRF24L01_TELEMETRY_SHT1X_HUMIDITY 6        /*!< Raw SOrh, see sht1x_calc_humidity() */
+#define NRF24L01_TELEMETRY_USER 7
+
+//! Sample.
+struct nrf24l01_telemetry_sample
+{
+    uint8_t channel;
+    uint32_t time;                                 /*!< Milliseconds */
+    int32_t value;
+};
+
+/*!
+ * Packer. Payload is header {seq, count, time[4]} followed by bit-packed records, MSB
+ * first. Record is 4-bit channel, 2-bit class and time delta from previous sample,
+ * 2-bit class and zigzag value delta from previous value of the channel in payload
+ * (0 for first one). Time classes are 0, 8, 16 and 32 bits, value classes are 0, 6,
+ * 16 and 32 bits.
+ */
+struct nrf24l01_telemetry
+{
+    struct nrf24l01 *device;
+    uint32_t deadline;                             /*!< Maximum age of first sample in payload, milliseconds */
+    uint8_t seq;                                   /*!< Sequence number of current payload */
+
+    uint8_t count;                                 /*!< Samples in payload */
+    uint16_t bits;                                 /*!< Bits used by records */
+    uint32_t time;                                 /*!< Time of last sample */
+    int32_t last[NRF24L01_TELEMETRY_CHANNELS];     /*!< Last value of each channel in payload */
+    uint8_t frame[32];
+
+    uint32_t samples;                              /*!< Samples added */
+    uint32_t frames;                               /*!< Payloads sent */
+    uint32_t failed;                               /*!< Payloads not acknowledged */
+};
+
+/*! Init packer.
+ * \param telemetry packer.
+ * \param device configured device, payloads are sent with nrf24l01_send().
+ * \param deadline maximum age of first sample in payload before it is sent, milliseconds.
+ */
+void nrf24l01_telemetry_init(struct nrf24l01_telemetry *telemetry, struct nrf24l01 *device, uint32_t deadline);
+
+/*! Add sample. Full payload is sent first.
+ * \param telemetry packer.
+ * \param channel channel, from 0 to 15.
+ * \param time sample time in milliseconds, not earlier than previous sample.
+ * \param value value.
+ * \returns 0 on success, -EINVAL if channel or time is invalid, negative error code
+ *          of nrf24l01_send() if full payload wasn't sent, sample isn't added then.
+ */
+int nrf24l01_telemetry_add(struct nrf24l01_telemetry *telemetry, uint8_t channel, uint32_t time, int32_t value);
+
+/*! Send payload if deadline of its first sample has passed.
+ * \param telemetry packer.
+ * \param now current time in milliseconds.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int nrf24l01_telemetry_poll(struct nrf24l01_telemetry *telemetry, uint32_t now);
+
+/*! Send payload now, nothing is sent if payload is empty.
+ * \returns 0 on success, negative error code otherwise. Payload is kept on error.
+ */
+int nrf24l01_telemetry_flush(struct nrf24l01_telemetry *telemetry);
+
+/*! Unpack received payload.
+ * \param data payload.
+ * \param size payload size.
+ * \param samples output samples, the size of this array must be at least
+ *        NRF24L01_TELEMETRY_MAX_SAMPLES items.
+ * \param count number of samples.
+ * \param seq payload sequence number, may be 0.
+ * \returns 0 on success, -EBADMSG if payload is malformed.
+ */
+int nrf24l01_telemetry_unpack(const uint8_t *data, uint8_t size, struct nrf24l01_telemetry_sample *samples,
+                              uint8_t *count, uint8_t *seq);
+
+//! \} \}
+
+#endif
@@ -49,6 +49,8 @@
 #define SST25_ERASE_64K 2
 #define SST25_ERASE_CHIP 3
 
+#define SST25_SECTOR_SIZE 0x1000
+
 struct sst25_jedec_id
 {
     uint8_t manufacturer;
@@ -72,7 +74,36 @@ int sst25_unprotect(struct sst25 *sst25);
 int sst25_read_data(struct sst25 *sst25, uint32_t addr, uint8_t *data, uint16_t size);
 int sst25_write_data(struct sst25 *sst25, uint32_t addr, uint8_t *data, uint16_t size);
 
+/*! Rewrite data without erase, when possible.
+ * Current contents are compared with new data. If only 1 bits have to be cleared,
+ * changed bytes are programmed and erase is skipped. Otherwise each affected sector
+ * is read to buffer, merged with new data, erased and programmed back.
+ * \param sst25 device.
+ * \param addr flash address.
+ * \param data new data.
+ * \param size data size.
+ * \param buffer SST25_SECTOR_SIZE bytes scratch buffer for erase fallback, may be 0.
+ * \returns 0 on success, -ENOBUFS if erase is required and buffer is 0, negative error code otherwise.
+ */
+int sst25_update_data(struct sst25 *sst25, uint32_t addr, uint8_t *data, uint16_t size, uint8_t *buffer);
+
 int sst25_erase(struct sst25 *sst25, uint16_t addr, int type);
+//! Send erase command without waiting for completion.
+int sst25_erase_start(struct sst25 *sst25, uint16_t addr, int type);
+//! Wait for completion of erase started by sst25_erase_start().
+int sst25_wait_for_erase(struct sst25 *sst25, int type);
+
+/*
+ * Low-level AAI word programming. Device must be ready (see sst25_wait_for_ready())
+ * before each next word and before sequence end. Used to overlap programming of
+ * several devices, sst25_write_data() is built on top of it.
+ */
+//! Start AAI sequence at even address with first word.
+int sst25_aai_start(struct sst25 *sst25, uint32_t addr, const uint8_t *word);
+//! Program next word of AAI sequence.
+int sst25_aai_next(struct sst25 *sst25, const uint8_t *word);
+//! Terminate AAI sequence.
+int sst25_aai_end(struct sst25 *sst25);
 
 int sst25_write_enable(struct sst25 *sst25);
 int sst25_write_disable(struct sst25 *sst25);
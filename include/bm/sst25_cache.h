@@ -0,0 +1,132 @@
+#ifndef BAREMETAL_SST25_CACHE_H
+#define BAREMETAL_SST25_CACHE_H
+
+/*!
+ * \defgroup drivers Drivers - Device drivers
+ * \{
+ * \defgroup sst25_cache SST25 cache - RAM page cache for SPI Serial Flash
+ * \{
+ */
+
+#include <stdint.h>
+#include <bm/sst25.h>
+
+//! Cache line size in bytes. Power of two from 256 to 4096.
+#ifndef SST25_CACHE_LINE_SIZE
+#define SST25_CACHE_LINE_SIZE 256
+#endif
+
+//! RAM budget for cached data in bytes. Must hold at least one line.
+#ifndef SST25_CACHE_SIZE
+#define SST25_CACHE_SIZE 1024
+#endif
+
+//! Number of lines following a missed line, that are fetched in the same read transaction.
+#ifndef SST25_CACHE_READ_AHEAD
+#define SST25_CACHE_READ_AHEAD 1
+#endif
+
+#if (SST25_CACHE_LINE_SIZE < 256) || (SST25_CACHE_LINE_SIZE > 4096) || (SST25_CACHE_LINE_SIZE & (SST25_CACHE_LINE_SIZE - 1))
+#error "SST25_CACHE_LINE_SIZE must be power of two from 256 to 4096"
+#endif
+
+#define SST25_CACHE_LINES (SST25_CACHE_SIZE / SST25_CACHE_LINE_SIZE)
+
+#if SST25_CACHE_LINES < 1
+#error "SST25_CACHE_SIZE must hold at least one line"
+#endif
+
+#if SST25_CACHE_READ_AHEAD >= SST25_CACHE_LINES
+#undef SST25_CACHE_READ_AHEAD
+#define SST25_CACHE_READ_AHEAD (SST25_CACHE_LINES - 1)
+#endif
+
+#define SST25_CACHE_INVALID 0xFFFFFFFF
+
+//! Cache line.
+struct sst25_cache_line
+{
+    uint32_t addr;                                 /*!< Flash address of first line byte, SST25_CACHE_INVALID if line is empty */
+    uint32_t used;                                 /*!< LRU stamp of last access */
+    uint16_t dirty_start;                          /*!< First dirty byte offset */
+    uint16_t dirty_end;                            /*!< Offset after last dirty byte, 0 if line is clean */
+    uint8_t prefetched;                            /*!< Line was fetched by read-ahead and not used yet */
+    uint8_t data[SST25_CACHE_LINE_SIZE];           /*!< Cached flash contents */
+};
+
+//! Cache statistics.
+struct sst25_cache_stats
+{
+    uint32_t hits;                                 /*!< Line lookups served from RAM */
+    uint32_t misses;                               /*!< Line lookups that required flash read */
+    uint32_t read_ahead;                           /*!< Lines fetched speculatively */
+    uint32_t read_ahead_hits;                      /*!< Speculatively fetched lines that were used later */
+    uint32_t writes;                               /*!< Cached write calls */
+    uint32_t write_backs;                          /*!< Program sequences issued to flash */
+};
+
+//! SST25 cache.
+struct sst25_cache
+{
+    struct sst25 *flash;
+    struct sst25_cache_line lines[SST25_CACHE_LINES];
+    uint32_t stamp;
+    struct sst25_cache_stats stats;
+};
+
+/*! Init cache.
+ * \param cache cache.
+ * \param flash flash device behind the cache.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int sst25_cache_init(struct sst25_cache *cache, struct sst25 *flash);
+
+/*! Read data through cache.
+ * \param cache cache.
+ * \param addr flash address.
+ * \param data output buffer.
+ * \param size data size.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int sst25_cache_read(struct sst25_cache *cache, uint32_t addr, uint8_t *data, uint16_t size);
+
+/*! Write data through cache.
+ * Data are written to flash on flush or when line is evicted. Adjacent writes are
+ * coalesced into single program sequence.
+ * \param cache cache.
+ * \param addr flash address.
+ * \param data data to write.
+ * \param size data size.
+ * \returns 0 on success, negative error code otherwise.
+ * \note Same as for sst25_write_data(), target area must be erased.
+ */
+int sst25_cache_write(struct sst25_cache *cache, uint32_t addr, const uint8_t *data, uint16_t size);
+
+/*! Erase flash and update cache.
+ * Cached lines inside erased area are kept as erased, pending writes to them are dropped.
+ * \param cache cache.
+ * \param addr block number, see sst25_erase().
+ * \param type erase type (SST25_ERASE_*).
+ * \returns 0 on success, negative error code otherwise.
+ */
+int sst25_cache_erase(struct sst25_cache *cache, uint16_t addr, int type);
+
+/*! Write all dirty lines to flash.
+ * \param cache cache.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int sst25_cache_flush(struct sst25_cache *cache);
+
+/*! Drop cached lines without writing them back.
+ * \param cache cache.
+ * \param addr first flash address.
+ * \param size area size, 0 - whole cache.
+ */
+void sst25_cache_invalidate(struct sst25_cache *cache, uint32_t addr, uint32_t size);
+
+//! Reset statistics counters.
+void sst25_cache_reset_stats(struct sst25_cache *cache);
+
+//! \} \}
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef BAREMETAL_SST25_KV_H
+#define BAREMETAL_SST25_KV_H
+
+/*!
+ * \defgroup drivers Drivers - Device drivers
+ * \{
+ * \defgroup sst25_kv SST25 KV - Log-structured key-value store on SPI Serial Flash
+ * \{
+ */
+
+#include <stdint.h>
+#include <bm/sst25.h>
+
+//! Maximum number of 4K sectors in store.
+#ifndef SST25_KV_MAX_SECTORS
+#define SST25_KV_MAX_SECTORS 16
+#endif
+
+//! Index size, power of two. Up to 3/4 of it can be used by keys.
+#ifndef SST25_KV_INDEX_SIZE
+#define SST25_KV_INDEX_SIZE 64
+#endif
+
+//! Maximum value size.
+#ifndef SST25_KV_MAX_VALUE
+#define SST25_KV_MAX_VALUE 1024
+#endif
+
+//! Erase count difference, after which sector with cold data is recycled.
+#ifndef SST25_KV_WEAR_LIMIT
+#define SST25_KV_WEAR_LIMIT 16
+#endif
+
+#if SST25_KV_INDEX_SIZE & (SST25_KV_INDEX_SIZE - 1)
+#error "SST25_KV_INDEX_SIZE must be power of two"
+#endif
+
+#define SST25_KV_SECTOR_SIZE 0x1000
+#define SST25_KV_MAGIC 0x564B4D42
+
+#define SST25_KV_KEY_NONE 0xFFFF
+#define SST25_KV_ADDR_NONE 0xFFFFFFFF
+#define SST25_KV_TOMBSTONE 0x8000
+#define SST25_KV_SEQ_NONE 0xFFFFFFFF
+
+#define SST25_KV_SECTOR_FREE 0
+#define SST25_KV_SECTOR_ACTIVE 1
+#define SST25_KV_SECTOR_CLOSED 2
+#define SST25_KV_SECTOR_DIRTY 3
+
+//! Sector header, written to sector start right after erase.
+struct sst25_kv_sector_header
+{
+    uint32_t magic;                                /*!< SST25_KV_MAGIC */
+    uint32_t erase_count;                          /*!< Sector erase count */
+    uint32_t seq;                                  /*!< Log order, programmed when sector becomes active */
+};
+
+//! Record header, followed by value padded to even size.
+struct sst25_kv_record_header
+{
+    uint16_t key;                                  /*!< Key, SST25_KV_KEY_NONE marks end of sector log */
+    uint16_t len;                                  /*!< Value size, SST25_KV_TOMBSTONE bit marks deleted key */
+    uint16_t crc;                                  /*!< CRC-16/CCITT of key, len and value */
+};
+
+//! Sector state.
+struct sst25_kv_sector
+{
+    uint32_t seq;                                  /*!< Log order */
+    uint32_t erase_count;                          /*!< Erase count */
+    uint16_t used;                                 /*!< Write offset */
+    uint16_t live;                                 /*!< Bytes of records that are referenced by index */
+    uint8_t state;                                 /*!< SST25_KV_SECTOR_* */
+};
+
+//! Index entry.
+struct sst25_kv_entry
+{
+    uint16_t key;                                  /*!< Key, SST25_KV_KEY_NONE if slot is empty */
+    uint16_t len;                                  /*!< Value size with SST25_KV_TOMBSTONE flag */
+    uint32_t addr;                                 /*!< Record address, SST25_KV_ADDR_NONE until record is written */
+};
+
+//! Key-value store.
+struct sst25_kv
+{
+    struct sst25 *flash;
+    uint16_t first_sector;                         /*!< First 4K sector number */
+    uint16_t sector_count;                         /*!< Number of sectors */
+    uint16_t active;                               /*!< Sector that receives appends */
+    uint16_t keys;                                 /*!< Used index slots */
+    uint32_t next_seq;
+    uint32_t erases;                               /*!< Erases done since mount */
+    struct sst25_kv_sector sectors[SST25_KV_MAX_SECTORS];
+    struct sst25_kv_entry index[SST25_KV_INDEX_SIZE];
+};
+
+/*! Mount store and rebuild index.
+ * Sectors with broken headers (e.g. interrupted erase) are erased.
+ * \param kv store.
+ * \param flash flash device.
+ * \param first_sector first 4K sector number of store area.
+ * \param sector_count number of sectors, from 3 to SST25_KV_MAX_SECTORS.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int sst25_kv_mount(struct sst25_kv *kv, struct sst25 *flash, uint16_t first_sector, uint16_t sector_count);
+
+/*! Erase store area and mount empty store.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int sst25_kv_format(struct sst25_kv *kv, struct sst25 *flash, uint16_t first_sector, uint16_t sector_count);
+
+/*! Get value.
+ * \param kv store.
+ * \param key key.
+ * \param data output buffer.
+ * \param size buffer size.
+ * \param len value size, may be 0.
+ * \returns 0 on success, -ENOENT if key doesn't exist, -ENOBUFS if buffer is too small,
+ *          negative error code otherwise.
+ */
+int sst25_kv_get(struct sst25_kv *kv, uint16_t key, void *data, uint16_t size, uint16_t *len);
+
+/*! Set value.
+ * \param kv store.
+ * \param key key, any value except SST25_KV_KEY_NONE.
+ * \param data value.
+ * \param len value size, up to SST25_KV_MAX_VALUE.
+ * \returns 0 on success, -ENOSPC if store is full, negative error code otherwise.
+ */
+int sst25_kv_set(struct sst25_kv *kv, uint16_t key, const void *data, uint16_t len);
+
+/*! Delete key.
+ * \returns 0 on success, -ENOENT if key doesn't exist, negative error code otherwise.
+ */
+int sst25_kv_delete(struct sst25_kv *kv, uint16_t key);
+
+/*! Collect sector with least live data.
+ * Called automatically when store runs out of free sectors.
+ * \returns 0 on success, -ENOSPC if there is nothing to collect, negative error code otherwise.
+ */
+int sst25_kv_collect(struct sst25_kv *kv);
+
+//! \} \}
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef BAREMETAL_SST25_LOG_H
+#define BAREMETAL_SST25_LOG_H
+
+/*!
+ * \defgroup drivers Drivers - Device drivers
+ * \{
+ * \defgroup sst25_log SST25 log - Circular time-series log on SPI Serial Flash
+ * \{
+ */
+
+#include <stdint.h>
+#include <bm/sst25.h>
+
+//! Maximum number of values in one sample.
+#ifndef SST25_LOG_MAX_CHANNELS
+#define SST25_LOG_MAX_CHANNELS 4
+#endif
+
+//! Maximum payload of block. Samples are buffered in RAM until block is full or flushed.
+#ifndef SST25_LOG_BLOCK_SIZE
+#define SST25_LOG_BLOCK_SIZE 120
+#endif
+
+#define SST25_LOG_SEGMENT_SIZE 0x1000
+#define SST25_LOG_MAGIC 0x474C4D42
+
+//! Maximum encoded sample size: delta timestamp and values as 32-bit varints.
+#define SST25_LOG_RECORD_MAX (5 * (1 + SST25_LOG_MAX_CHANNELS))
+
+#if SST25_LOG_BLOCK_SIZE < SST25_LOG_RECORD_MAX
+#error "SST25_LOG_BLOCK_SIZE must hold at least one sample"
+#endif
+
+//! Segment (4K sector) header.
+struct sst25_log_segment_header
+{
+    uint32_t magic;                                /*!< SST25_LOG_MAGIC */
+    uint32_t seq;                                  /*!< Segment number, increments by one for each new segment */
+    uint32_t timestamp;                            /*!< Timestamp of first sample in segment */
+    uint8_t channels;                              /*!< Values per sample */
+    uint8_t reserved;
+    uint16_t crc;                                  /*!< CRC-16/CCITT of previous fields */
+};
+
+/*!
+ * Block header. Followed by samples, each sample is varint timestamp delta from previous
+ * sample and zigzag varint deltas of each value. First sample is relative to block
+ * timestamp and zero values.
+ */
+struct sst25_log_block_header
+{
+    uint16_t len;                                  /*!< Payload size, 0xFFFF marks end of segment */
+    uint16_t crc;                                  /*!< CRC-16/CCITT of len, timestamp and payload */
+    uint32_t timestamp;                            /*!< Timestamp of first sample in block */
+};
+
+//! Sample log.
+struct sst25_log
+{
+    struct sst25 *flash;
+    uint16_t first_sector;                         /*!< First 4K sector number */
+    uint16_t sector_count;                         /*!< Number of segments */
+    uint8_t channels;                              /*!< Values per sample */
+    uint8_t empty;                                 /*!< No segment is written yet */
+
+    uint16_t head;                                 /*!< Segment that receives blocks */
+    uint16_t tail;                                 /*!< Oldest segment */
+    uint16_t offset;                               /*!< Write offset in head segment */
+    uint32_t seq;                                  /*!< Head segment number */
+
+    uint32_t timestamp;                            /*!< Last sample timestamp */
+    int32_t values[SST25_LOG_MAX_CHANNELS];        /*!< Last sample values in current block */
+    uint32_t block_timestamp;
+    uint16_t block_len;
+    uint8_t block[SST25_LOG_BLOCK_SIZE + 1];       /*!< Buffered samples, with room for padding byte */
+
+    uint32_t erases;                               /*!< Erases done since mount */
+};
+
+//! Range query position.
+struct sst25_log_cursor
+{
+    uint32_t from;
+    uint32_t to;
+    uint32_t seq;                                  /*!< Segment number, detects overwritten segments */
+    uint16_t segment;
+    uint16_t offset;                               /*!< Next block offset */
+    uint16_t pos;                                  /*!< Position in block */
+    uint16_t len;                                  /*!< Block payload size */
+    uint32_t timestamp;
+    int32_t values[SST25_LOG_MAX_CHANNELS];
+    uint8_t block[SST25_LOG_BLOCK_SIZE];
+};
+
+/*! Mount log. Head and tail are found by binary search over segment headers.
+ * \param log log.
+ * \param flash flash device.
+ * \param first_sector first 4K sector number of log area.
+ * \param sector_count number of segments, at least 2.
+ * \param channels values per sample, up to SST25_LOG_MAX_CHANNELS.
+ * \returns 0 on success, -EINVAL if log was formatted with another channel count,
+ *          negative error code otherwise.
+ */
+int sst25_log_mount(struct sst25_log *log, struct sst25 *flash, uint16_t first_sector, uint16_t sector_count, uint8_t channels);
+
+/*! Erase log area and mount empty log.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int sst25_log_format(struct sst25_log *log, struct sst25 *flash, uint16_t first_sector, uint16_t sector_count, uint8_t channels);
+
+/*! Append sample. Samples are written to flash by blocks.
+ * \param log log.
+ * \param timestamp sample timestamp, must not be less than previous one.
+ * \param values sample values, log->channels items.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int sst25_log_append(struct sst25_log *log, uint32_t timestamp, const int32_t *values);
+
+/*! Write buffered samples to flash.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int sst25_log_flush(struct sst25_log *log);
+
+/*! Start range query. Only flushed samples are visible.
+ * \param log log.
+ * \param cursor query position.
+ * \param from first timestamp.
+ * \param to last timestamp.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int sst25_log_query(struct sst25_log *log, struct sst25_log_cursor *cursor, uint32_t from, uint32_t to);
+
+/*! Get next sample of range query.
+ * \param log log.
+ * \param cursor query position.
+ * \param timestamp sample timestamp.
+ * \param values sample values, log->channels items.
+ * \returns 0 on success, -ENOENT after last sample, -ESTALE if segment was overwritten
+ *          during query, negative error code otherwise.
+ */
+int sst25_log_next(struct sst25_log *log, struct sst25_log_cursor *cursor, uint32_t *timestamp, int32_t *values);
+
+//! \} \}
+
+#endif
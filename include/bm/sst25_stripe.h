@@ -0,0 +1,77 @@
+#ifndef BAREMETAL_SST25_STRIPE_H
+#define BAREMETAL_SST25_STRIPE_H
+
+/*!
+ * \defgroup drivers Drivers - Device drivers
+ * \{
+ * \defgroup sst25_stripe SST25 stripe - Striping over several SPI Serial Flash devices
+ * \{
+ */
+
+#include <stdint.h>
+#include <bm/sst25.h>
+
+//! Maximum number of devices in stripe.
+#ifndef SST25_STRIPE_MAX_DEVICES
+#define SST25_STRIPE_MAX_DEVICES 3
+#endif
+
+//! Stripe unit size in bytes. Even value.
+#ifndef SST25_STRIPE_UNIT
+#define SST25_STRIPE_UNIT 256
+#endif
+
+#if SST25_STRIPE_UNIT & 1
+#error "SST25_STRIPE_UNIT must be even"
+#endif
+
+/*!
+ * Striped device. Logical address space is split into SST25_STRIPE_UNIT units, that are
+ * distributed round-robin over devices. Devices should be on separate SPI buses, so
+ * erase and program cycles of one device overlap with transfers to others.
+ */
+struct sst25_stripe
+{
+    struct sst25 *devices[SST25_STRIPE_MAX_DEVICES];
+    uint8_t count;
+};
+
+/*! Init stripe.
+ * \param stripe stripe.
+ * \param devices device array.
+ * \param count device count, from 1 to SST25_STRIPE_MAX_DEVICES.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int sst25_stripe_init(struct sst25_stripe *stripe, struct sst25 **devices, uint8_t count);
+
+/*! Read data.
+ * \param stripe stripe.
+ * \param addr logical address.
+ * \param data output buffer.
+ * \param size data size.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int sst25_stripe_read(struct sst25_stripe *stripe, uint32_t addr, uint8_t *data, uint16_t size);
+
+/*! Write data. AAI sequences of all devices are interleaved word by word.
+ * \param stripe stripe.
+ * \param addr logical address.
+ * \param data data.
+ * \param size data size.
+ * \returns 0 on success, negative error code otherwise.
+ * \note Target area must be erased.
+ */
+int sst25_stripe_write(struct sst25_stripe *stripe, uint32_t addr, uint8_t *data, uint16_t size);
+
+/*! Erase same block on all devices at once.
+ * Logical block size is device block size multiplied by device count.
+ * \param stripe stripe.
+ * \param addr block number, see sst25_erase().
+ * \param type erase type (SST25_ERASE_*).
+ * \returns 0 on success, negative error code otherwise.
+ */
+int sst25_stripe_erase(struct sst25_stripe *stripe, uint16_t addr, int type);
+
+//! \} \}
+
+#endif
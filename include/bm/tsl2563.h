@@ -24,9 +24,29 @@
 #define TSL2563_INT_402MS 0x2
 #define TSL2563_INT_MANUAL 0x3
 
+//! Full scale counts of integration times.
+#define TSL2563_MAX_14MS 5047
+#define TSL2563_MAX_101MS 37177
+#define TSL2563_MAX_402MS 65535
+
+//! Channel scale of integration times to 402 ms, 322 / 11 and 322 / 81 in CH_SCALE bits.
+#define TSL2563_CH_SCALE 10
+#define TSL2563_CH_SCALE_14MS 0x7517
+#define TSL2563_CH_SCALE_101MS 0x0fe7
+#define TSL2563_CH_SCALE_402MS (1 << TSL2563_CH_SCALE)
+
 #define TSL2563_GAIN_1X 0
 #define TSL2563_GAIN_16X 1
 
+#define TSL2563_INTR_DISABLED 0
+#define TSL2563_INTR_LEVEL 1
+#define TSL2563_INTR_SMBALERT 2
+#define TSL2563_INTR_TEST 3
+
+#define TSL2563_COMMAND_CLEAR 0x40
+#define TSL2563_COMMAND_WORD 0x20
+#define TSL2563_COMMAND_BLOCK 0x10
+
 #define TSL2563_REGISTER_CONTROL 0x80
 #define TSL2563_REGISTER_TIMING 0x81
 #define TSL2563_REGISTER_THRESHLOWLOW 0x82
@@ -51,10 +71,53 @@ int tsl2563_power_on(struct tsl2563 *device);
 int tsl2563_power_off(struct tsl2563 *device);
 
 int tsl2563_set_integration_time(struct tsl2563 *device, uint8_t time);
+int tsl2563_set_gain(struct tsl2563 *device, uint8_t gain);
+
+//! Set gain and integration time in one write.
+int tsl2563_set_timing(struct tsl2563 *device, uint8_t gain, uint8_t time);
+
+/*! Set interrupt thresholds, interrupt is generated when channel 0 is out of them.
+ * \param device device.
+ * \param low low threshold.
+ * \param high high threshold.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int tsl2563_set_threshold(struct tsl2563 *device, uint16_t low, uint16_t high);
+
+/*! Set interrupt mode.
+ * \param device device.
+ * \param control TSL2563_INTR_*.
+ * \param persist 0 to interrupt after every integration cycle, N to interrupt after N
+ *        consecutive cycles out of thresholds, up to 15.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int tsl2563_set_interrupt(struct tsl2563 *device, uint8_t control, uint8_t persist);
+
+//! Clear pending interrupt.
+int tsl2563_clear_interrupt(struct tsl2563 *device);
 int tsl2563_read_channel(struct tsl2563 *device, uint8_t channel, uint16_t *value);
 
+/*! Read both channels in one block transaction, so they come from the same integration cycle.
+ * \param device device.
+ * \param channel0 visible and infrared channel value.
+ * \param channel1 infrared channel value.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int tsl2563_read_channels(struct tsl2563 *device, uint16_t *channel0, uint16_t *channel1);
+
 float tsl2563_calc_lux(uint16_t channel0, uint16_t channel1, uint8_t gain);
 
+/*! Calculate lux in fixed point, as vendor's integer algorithm does.
+ * Channels are scaled to 402 ms integration and 16x gain, manual integration is taken
+ * as 402 ms.
+ * \param channel0 visible and infrared channel value.
+ * \param channel1 infrared channel value.
+ * \param gain TSL2563_GAIN_*.
+ * \param time TSL2563_INT_*.
+ * \returns illuminance in lux.
+ */
+uint32_t tsl2563_calc_lux_int(uint16_t channel0, uint16_t channel1, uint8_t gain, uint8_t time);
+
 //! \} \}
 
 #endif
@@ -0,0 +1,78 @@
+#ifndef BAREMETAL_TSL2563_AUTO_H
+#define BAREMETAL_TSL2563_AUTO_H
+
+/*!
+ * \defgroup drivers Drivers - Device drivers
+ * \{
+ * \defgroup tsl2563_auto TSL2563 auto-range - Gain and integration time control
+ * \{
+ */
+
+#include <stdint.h>
+#include <bm/tsl2563.h>
+
+//! Consecutive integration cycles out of window before interrupt, from 1 to 15.
+#ifndef TSL2563_AUTO_PERSIST
+#define TSL2563_AUTO_PERSIST 2
+#endif
+
+#if (TSL2563_AUTO_PERSIST < 1) || (TSL2563_AUTO_PERSIST > 15)
+#error "TSL2563_AUTO_PERSIST must be from 1 to 15"
+#endif
+
+/*!
+ * Ranges from least to most sensitive: 1x 14 ms, 1x 101 ms, 16x 14 ms, 1x 402 ms,
+ * 16x 101 ms, 16x 402 ms.
+ */
+#define TSL2563_AUTO_RANGES 6
+
+/*!
+ * Auto-range controller. Range is stepped down when a channel is close to saturation
+ * and up to the most sensitive range, in which channel 0 would stay below half of
+ * full scale. Reading after range change is discarded.
+ *
+ * In window mode interrupt is generated when channel 0 leaves window around last
+ * reading, and nothing is read from device until then.
+ */
+struct tsl2563_auto
+{
+    struct tsl2563 *device;
+    uint8_t range;                                 /*!< Current range, from 0 to TSL2563_AUTO_RANGES - 1 */
+    uint8_t discard;                               /*!< Readings to discard */
+    uint8_t window;                                /*!< Window is reading +/- reading >> window, 0 if disabled */
+    volatile uint8_t irq;                          /*!< Set by tsl2563_auto_irq() */
+    uint64_t deadline;                             /*!< Tick count, when integration cycle is complete */
+
+    uint16_t channel0;                             /*!< Last channel 0 value */
+    uint16_t channel1;                             /*!< Last channel 1 value */
+    uint32_t lux;                                  /*!< Last illuminance */
+};
+
+/*! Init controller and set range. Device must be powered on.
+ * \param ctl controller.
+ * \param device device.
+ * \param range initial range.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int tsl2563_auto_init(struct tsl2563_auto *ctl, struct tsl2563 *device, uint8_t range);
+
+/*! Read device, when integration cycle is complete, and adjust range.
+ * In window mode device is read only after interrupt.
+ * \returns 1 if new reading is stored in controller, 0 if there is none yet, negative
+ *          error code otherwise.
+ */
+int tsl2563_auto_poll(struct tsl2563_auto *ctl);
+
+/*! Enable or disable window mode. Device interrupt is used as level interrupt.
+ * \param ctl controller.
+ * \param window window size as shift of reading, from 1 to 15, 0 to disable window mode.
+ * \returns 0 on success, negative error code otherwise.
+ */
+int tsl2563_auto_set_window(struct tsl2563_auto *ctl, uint8_t window);
+
+//! Report interrupt, call from INT pin falling edge interrupt.
+void tsl2563_auto_irq(struct tsl2563_auto *ctl);
+
+//! \} \}
+
+#endif